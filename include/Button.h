@@ -0,0 +1,64 @@
+// Button.h
+
+#ifndef _BUTTON_h
+#define _BUTTON_h
+
+#include "Arduino.h"
+
+#define BUTTON_MAX 4              // 最大按键数
+#define BUTTON_DEBOUNCE 50000     // 电平稳定多久算有效 us
+#define BUTTON_CLICK_GAP 300000   // 超过该时间没有新动作则结束连击 us
+#define BUTTON_LONG_PRESS 2000000 // 长按 us
+
+enum ButtonMode
+{
+    BUTTON_MODE_PUSH,  // 轻触按键: 按下计数, 支持长按
+    BUTTON_MODE_TOGGLE // 自锁/翘板开关: 每次电平变化计数
+};
+
+enum ButtonEvent
+{
+    BUTTON_EVENT_CHANGE, // 消抖后的电平变化, count 1 = 按下 0 = 松开
+    BUTTON_EVENT_CLICK,  // 连击结束, count 为次数
+    BUTTON_EVENT_LONG    // 长按, 之后不再产生 CLICK
+};
+
+typedef void (*ButtonCallback)(uint8_t arg, uint8_t event, uint8_t count);
+
+typedef struct
+{
+    uint8_t pin;
+    uint8_t mode;                // ButtonMode
+    uint8_t arg;                 // 回调参数, 一般为通道
+    bool poll;                   // GPIO16 不支持中断, 每次 loop 读取
+    bool raw;                    // 轮询时上次读到的电平
+    bool pressed;                // 消抖后的状态
+    bool longFired;              // 本次按下已触发长按
+    uint8_t count;               // 连击计数
+    volatile bool dirty;         // 有边沿待确认
+    volatile uint32_t edgeTime;  // 最近一次边沿 us
+    volatile uint32_t firstEdge; // 本轮第一次边沿 us
+    uint32_t changeTime;         // 最近一次确认变化 us
+    ButtonCallback callback;
+} ButtonState;
+
+// 按键中断只记录边沿时间, 消抖和手势识别在 loop 中完成, 空闲时不读取 GPIO
+class Button
+{
+private:
+    static ButtonState buttons[BUTTON_MAX];
+    static uint8_t count;
+    static void isr(void *arg);
+    static void emit(ButtonState *b, uint8_t event, uint8_t value);
+
+public:
+    static uint32_t edgeCount;  // 中断次数
+    static uint32_t eventCount; // 产生的事件
+    static uint32_t latency;    // 最近一次第一次边沿到确认变化 us
+
+    static void init();
+    static bool add(uint8_t pin, uint8_t mode, ButtonCallback callback, uint8_t arg = 0);
+    static void loop();
+};
+
+#endif
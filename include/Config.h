@@ -26,17 +26,57 @@
 #define MAX_STUDY_RECEIVER_NUM 10 // 遥控最大学习数
 
 #define OTA_URL "http://10.0.0.50/esp/%module%.bin"
+// RTC 用户内存(4字节/块): 0~31 OTA 时 eboot 使用
+#define RTC_WIFI_OFFSET 32  // WiFi 快速连接缓存 32~38
+#define RTC_CRASH_OFFSET 40 // 崩溃记录
+
+#define OTA_RETRY 5          // OTA 断线续传重试次数
+#define OTA_READ_TIMEOUT 5000 // OTA 无数据超时 ms
 
 #define WEB_LOG_SIZE 4000 // Max number of characters in weblog
+#define WEB_LOG_LINES 64  // weblog 最多保存的行数
+#ifndef SERIAL_LOG_SIZE
+#define SERIAL_LOG_SIZE 1024 // 串口日志发送缓冲
+#endif
+#define SYSLOG_SIZE 1400         // syslog 单个 UDP 包最大长度
+#define SYSLOG_FLUSH_TIME 500    // syslog 最长缓存时间 ms
+#define SYSLOG_DNS_TTL 600000    // syslog 服务器重新解析间隔 ms
+#define SYSLOG_DNS_RETRY 30000   // syslog 服务器解析失败重试间隔 ms
+#define BIN_LOG_SIZE 512        // 二进制日志发送缓冲
+#define BIN_LOG_RECORD_MAX 128  // 单条二进制日志最大长度
+#define BIN_LOG_STR_MAX 32      // 二进制日志中字符串参数最大长度
+#define BIN_LOG_TRUNCATED 0x80  // 级别字节最高位: 记录放不下, 之后的参数没有写入
+#define BIN_LOG_FLUSH_TIME 1000 // 二进制日志最长缓存时间 ms
+
+#define HTTP_STATUS_CACHE_TIME 500 // get_status 状态缓存时间 ms
+#define HTTP_STATUS_CACHE_SIZE 512 // get_status 状态缓存大小
+
+#define SCHEDULE_MAX 16  // 定时任务最大数量
+#define SCHEDULE_GRACE 2 // 时钟跳变后补执行的最长分钟数
 
 #define WifiManager_ConfigPortalTimeOut 120
 #define MinimumWifiSignalQuality 8
+#define WIFI_SCAN_MAX 32           // WiFi扫描结果最大保存数
+#define WIFI_SCAN_CACHE_TIME 30000 // WiFi扫描结果缓存时间 ms
+#define WIFI_FAST_TIMEOUT 5000     // 指定 BSSID/信道 连接超时, 超时后全信道扫描 ms
+#define WIFI_RSSI_INTERVAL 2000    // RSSI 采样间隔 ms
+#define WIFI_ROAM_RSSI -75         // 平均信号低于此值时扫描同名 AP
+#define WIFI_ROAM_HYSTERESIS 5     // 漫游后平均信号回升到 阈值+此值 即可再次漫游
+#define WIFI_ROAM_DELTA 10         // 新 AP 至少强多少 dB 才切换
+#define WIFI_ROAM_INTERVAL 300000  // 两次漫游扫描最短间隔 ms
+#define WIFI_RSSI_HISTORY 60       // 保存最近多少分钟的信号统计
+#define WIFI_LINK_EVENTS 16        // 保存最近多少次断线记录
+#define WIFI_LINK_SUMMARY 10       // 心跳中汇总最近多少分钟
 
 typedef struct _DebugConfigMessage
 {
     uint8_t type;
     char server[40];
     uint16_t port;
+    uint8_t serial_level; // 各输出的日志级别 0 = 默认
+    uint8_t serial1_level;
+    uint8_t web_level;
+    uint8_t syslog_level;
 } DebugConfigMessage;
 
 typedef struct _HttpConfigMessage
@@ -59,6 +99,7 @@ typedef struct _MqttConfigMessage
     char discovery_prefix[30];
 } MqttConfigMessage;
 
+typedef PB_BYTES_ARRAY_T(28) WifiConfigMessage_cache_t;
 typedef struct _WifiConfigMessage
 {
     char ssid[20];
@@ -67,8 +108,17 @@ typedef struct _WifiConfigMessage
     char ip[15];
     char sn[15];
     char gw[15];
+    WifiConfigMessage_cache_t cache; // WifiCache 的 flash 备份
 } WifiConfigMessage;
 
+typedef struct _ScheduleConfigMessage
+{
+    pb_size_t entry_count;
+    uint32_t entry[SCHEDULE_MAX]; // 每条定时任务打包为一个uint32 见 Schedule.h
+    int32_t latitude;             // 纬度 1e-5 度
+    int32_t longitude;            // 经度 1e-5 度
+} ScheduleConfigMessage;
+
 typedef PB_BYTES_ARRAY_T(500) GlobalConfigMessage_module_cfg_t;
 typedef struct _GlobalConfigMessage
 {
@@ -80,15 +130,19 @@ typedef struct _GlobalConfigMessage
     uint16_t module_crc;
     GlobalConfigMessage_module_cfg_t module_cfg;
     char uid[20];
+    ScheduleConfigMessage schedule;
+    char lan_key[33]; // 局域网控制 HMAC 密钥, 空 = 关闭
 } GlobalConfigMessage;
 
-extern const pb_field_t GlobalConfigMessage_fields[9];
-extern const pb_field_t WifiConfigMessage_fields[7];
+extern const pb_field_t GlobalConfigMessage_fields[11];
+extern const pb_field_t WifiConfigMessage_fields[8];
 extern const pb_field_t HttpConfigMessage_fields[5];
 extern const pb_field_t MqttConfigMessage_fields[9];
-extern const pb_field_t DebugConfigMessage_fields[4];
+extern const pb_field_t DebugConfigMessage_fields[8];
+extern const pb_field_t ScheduleConfigMessage_fields[4];
 
-#define GlobalConfigMessage_size 1081
+#define ScheduleConfigMessage_size 92
+#define GlobalConfigMessage_size 1265
 
 extern Module *module;
 
@@ -104,8 +158,12 @@ private:
     static uint16_t nowCrc;
 
 public:
+    static uint32_t saveCount;       // saveConfig 调用次数
+    static uint32_t flashWriteCount; // 实际写入 flash 次数
+
     static uint16_t crc16(uint8_t *ptr, uint16_t len);
 
+    static void init();
     static void readConfig();
     static void resetConfig();
     static boolean saveConfig();
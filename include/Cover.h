@@ -6,7 +6,7 @@
 
 #include "Arduino.h"
 #include <SoftwareSerial.h>
-#include <ESP8266WebServer.h>
+#include "HttpServer.h"
 #include "Module.h"
 
 #define MODULE_CFG_VERSION 1501 //1501 - 2000
@@ -54,26 +54,22 @@ private:
     uint8_t softwareSerialBuff[20];       // 定义缓冲buff
     uint8_t softwareSerialPos = 0;        // 收到的字节实际长度
     unsigned long softwareSerialTime = 0; // 记录读取最后一个字节的时间点
+    uint32_t frameError = 0;              // CRC 校验失败或超时丢弃的帧数
     boolean autoStroke = false;           // 是否自动设置行程
-
-    // 按键
-    int buttonDebounceTime = 50;
-    int buttonLongPressTime = 2000; // 2000 = 2s
-    boolean buttonTiming = false;
-    unsigned long buttonTimingStart = 0;
-    int buttonAction = 0; // 0 = 没有要执行的动作, 1 = 执行短按动作, 2 = 执行长按动作
+    uint8_t batchCmd[10];                 // 批量操作最后一条指令
+    uint8_t batchLen = 0;
 
     uint8_t getInt(String str, uint8_t min, uint8_t max);
-    void httpPosition(ESP8266WebServer *server);
-    void httpDo(ESP8266WebServer *server);
-    void httpSetting(ESP8266WebServer *server);
-    void httpReset(ESP8266WebServer *server);
+    void httpPosition(HttpServer *server);
+    void httpDo(HttpServer *server);
+    void httpSetting(HttpServer *server);
+    void httpReset(HttpServer *server);
     void doPosition(uint8_t position, uint8_t command);
     void doSoftwareSerialTick(uint8_t *buf, int len);
 
     void readSoftwareSerialTick();
     void getPositionTask();
-    void checkButton();
+    static void buttonCallback(uint8_t arg, uint8_t event, uint8_t count);
 
 public:
     void init();
@@ -92,9 +88,14 @@ public:
     void mqttConnected();
     void mqttDiscovery(boolean isEnable = true);
 
-    void httpAdd(ESP8266WebServer *server);
-    void httpHtml(ESP8266WebServer *server);
-    String httpGetStatus(ESP8266WebServer *server);
+    void httpAdd(HttpServer *server);
+    void httpHtml(HttpServer *server);
+    String httpGetStatus(HttpServer *server);
+
+    boolean batchCommand(String key, String value);
+    void batchCommit();
+
+    void scheduleDo(uint8_t target, uint8_t value);
 };
 #endif
 
@@ -0,0 +1,44 @@
+// Crash.h
+
+#ifndef _CRASH_h
+#define _CRASH_h
+
+#include "Arduino.h"
+#include "Config.h"
+
+#define CRASH_MAGIC 0x43525348 // "CRSH"
+#define CRASH_STACK 16         // 保存的栈字数
+#define CRASH_LOG_SIZE 160     // 保存的最后几行日志
+
+// 保存在 RTC 内存中，软重启后仍然存在
+typedef struct
+{
+    uint32_t magic;
+    uint32_t reason;
+    uint32_t exccause;
+    uint32_t epc1;
+    uint32_t epc2;
+    uint32_t epc3;
+    uint32_t excvaddr;
+    uint32_t depc;
+    uint32_t perSecond;
+    uint32_t heap;
+    uint32_t stack[CRASH_STACK];
+    char log[CRASH_LOG_SIZE];
+} CrashRecord;
+
+class Crash
+{
+private:
+    static CrashRecord record;
+    static bool hasRecord;
+    static bool isReport;
+
+public:
+    static void init();
+    static void save(uint32_t reason, uint32_t exccause, uint32_t epc1, uint32_t epc2, uint32_t epc3, uint32_t excvaddr, uint32_t depc, uint32_t stack, uint32_t stack_end);
+    static String toJson();
+    static void mqttConnected();
+};
+
+#endif
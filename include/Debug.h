@@ -5,6 +5,7 @@
 
 #include "Arduino.h"
 #include <ESP8266WiFi.h>
+#include <type_traits>
 #include "Config.h"
 
 enum LoggingLevels
@@ -17,20 +18,200 @@ enum LoggingLevels
     LOG_LEVEL_ALL
 };
 
+// 编译期日志级别，高于此级别的日志调用直接被编译器去掉
+#ifndef LOG_LEVEL_COMPILE
+#define LOG_LEVEL_COMPILE LOG_LEVEL_DEBUG_MORE
+#endif
+#define LOG_LEVEL_DEFAULT LOG_LEVEL_INFO // 配置为 0 时使用的级别
+
+// 串口日志发送缓冲，loop 中按硬件 FIFO 空闲量写出，满了整行丢弃不阻塞
+class SerialRing
+{
+private:
+    HardwareSerial *port;
+    char buf[SERIAL_LOG_SIZE];
+    uint16_t head = 0;
+    uint16_t tail = 0;
+    void put(const char *data, size_t len);
+
+public:
+    uint32_t drop = 0; // 丢弃的行数
+
+    SerialRing(HardwareSerial *_port) : port(_port) {}
+    bool write(const char *data, size_t len);
+    bool writeLine(const char *data1, const char *data2);
+    void loop();
+    void flush();
+};
+
+typedef struct
+{
+    uint8_t idx;  // 日志序号 0 = 空
+    uint16_t pos; // 在 webLog 中的位置
+    uint16_t len; // 长度
+} WebLogLine;
+
 class DebugClass // : public Print
 {
 protected:
-    size_t strchrspn(const char *str1, int character);
+    // webLog 为环形缓冲，每行连续存放，放不下时从头开始
+    WebLogLine webLogLines[WEB_LOG_LINES];
+    uint8_t webLogOldest = 0; // 最旧一行的序号
+    uint8_t webLogCount = 0;
+    uint16_t webLogHead = 0;  // 下一行写入位置
+    uint16_t webLogTail = 0;  // 最旧一行的位置
+    void webLogEvict();
+    void webLogAdd(const char *mxtime);
+    void AddLogFormat(uint8_t loglevel, PGM_P formatP, ...);
+
+    // 二进制日志: 每条为 [长度][级别][格式串flash地址 4字节][参数...]，格式串由上位机根据固件还原
+    // 参数放不下时该参数及之后的参数都不写，级别字节置 BIN_LOG_TRUNCATED
+    uint8_t binLog[BIN_LOG_SIZE];
+    uint16_t binLogLen = 0;
+    uint16_t binLogStart = 0;
+    uint32_t binLogTime = 0;
+    // syslogBuf 中每条 RFC 5424 消息都带 RFC 6587 octet-counting 长度前缀, 服务器未解析时先缓存
+    // 默认每条消息去掉前缀单独一个 UDP 包 (RFC 5426)
+    // debug.type & 32 时整个缓冲合并成一个包, 很多 UDP 接收端不支持, 需手动开启
+    char syslogBuf[SYSLOG_SIZE];
+    uint16_t syslogLen = 0;
+    uint32_t syslogTime = 0;
+    uint32_t ipTime = 0;
+    bool ipResolve = true; // 需要立即解析
+    bool getServer(bool resolve = true);
+    void syslogFlush(bool resolve = true);
+
+    void binLogBegin(uint8_t loglevel, PGM_P formatP);
+    void binLogPut(const void *data, uint8_t len);
+    void binLogEnd();
+    void binLogFlush(bool resolve = true);
+    void binLogArg(const char *str);
+    void binLogArg(char *str)
+    {
+        binLogArg((const char *)str);
+    }
+    // 参数按类型写入: 浮点 8 字节 double, 64 位整数 8 字节, 其它 4 字节, 与 logdecode.py 按格式串读取的长度一致
+    template <typename T>
+    void binLogArg(T value)
+    {
+        binLogNumber(value, std::integral_constant<int, std::is_floating_point<T>::value ? 2 : (std::is_integral<T>::value && sizeof(T) > 4 ? 1 : 0)>());
+    }
+    void binLogNumber(double value, std::integral_constant<int, 2>)
+    {
+        binLogPut(&value, 8);
+    }
+    template <typename T>
+    void binLogNumber(T value, std::integral_constant<int, 1>)
+    {
+        uint64_t v = (uint64_t)value;
+        binLogPut(&v, 8);
+    }
+    template <typename T>
+    void binLogNumber(T value, std::integral_constant<int, 0>)
+    {
+        static_assert(!std::is_scalar<T>::value || sizeof(T) <= 4, "binLog argument larger than 4 bytes");
+        uint32_t v = (uint32_t)value;
+        binLogPut(&v, 4);
+    }
+    void binLogArgs()
+    {
+    }
+    template <typename T, typename... Args>
+    void binLogArgs(T first, Args... rest)
+    {
+        binLogArg(first);
+        binLogArgs(rest...);
+    }
 
 public:
     uint8_t webLogIndex = 1;
-    char webLog[WEB_LOG_SIZE] = {'\0'};
+    char webLog[WEB_LOG_SIZE];
     void GetLog(uint8_t idx, char **entry_pp, uint16_t *len_p);
 
     IPAddress ip;
-    void Syslog();
+    void serverChanged()
+    {
+        ip = IPAddress();
+        ipResolve = true;
+    }
+    void Syslog(uint8_t loglevel);
     void AddLog(uint8_t loglevel);
-    void AddLog(uint8_t loglevel, PGM_P formatP, ...);
+    void loop();
+    void flush();
+
+    SerialRing serialTx{&Serial};
+    SerialRing serial1Tx{&Serial1};
+
+    uint32_t textCount = 0;  // 文本日志条数
+    uint32_t textCycles = 0; // 文本日志累计耗时 CPU 周期
+    uint32_t textBytes = 0;  // 文本日志累计字节
+    uint32_t binCount = 0;
+    uint32_t binCycles = 0;
+    uint32_t binBytes = 0;
+    uint32_t binDrop = 0; // 未能发送的二进制日志字节
+
+    static uint8_t sinkLevel(uint8_t level)
+    {
+        return level ? level : LOG_LEVEL_DEFAULT;
+    }
+
+    // 所有已开启输出中最高的日志级别
+    static uint8_t maxLevel()
+    {
+        uint8_t type = globalConfig.debug.type;
+        uint8_t level = LOG_LEVEL_NONE;
+        if ((1 & type) && sinkLevel(globalConfig.debug.serial_level) > level)
+        {
+            level = sinkLevel(globalConfig.debug.serial_level);
+        }
+        if ((2 & type) && sinkLevel(globalConfig.debug.syslog_level) > level)
+        {
+            level = sinkLevel(globalConfig.debug.syslog_level);
+        }
+        if ((4 & type) && sinkLevel(globalConfig.debug.web_level) > level)
+        {
+            level = sinkLevel(globalConfig.debug.web_level);
+        }
+        if ((8 & type) && sinkLevel(globalConfig.debug.serial1_level) > level)
+        {
+            level = sinkLevel(globalConfig.debug.serial1_level);
+        }
+        return level;
+    }
+
+    static bool binLevel(uint8_t loglevel)
+    {
+        return (16 & globalConfig.debug.type) && loglevel <= sinkLevel(globalConfig.debug.syslog_level);
+    }
+
+    static bool checkLevel(uint8_t loglevel)
+    {
+        return loglevel <= LOG_LEVEL_COMPILE && (loglevel <= maxLevel() || binLevel(loglevel));
+    }
+
+    // 过滤掉的日志在格式化之前返回
+    template <typename... Args>
+    void AddLog(uint8_t loglevel, PGM_P formatP, Args... args)
+    {
+        if (loglevel > LOG_LEVEL_COMPILE)
+        {
+            return;
+        }
+        if (binLevel(loglevel))
+        {
+            uint32_t start = ESP.getCycleCount();
+            binLogBegin(loglevel, formatP);
+            binLogArgs(args...);
+            binLogEnd();
+            binCycles += ESP.getCycleCount() - start;
+        }
+        if (loglevel <= maxLevel())
+        {
+            uint32_t start = ESP.getCycleCount();
+            AddLogFormat(loglevel, formatP, args...);
+            textCycles += ESP.getCycleCount() - start;
+        }
+    }
 };
 
 extern DebugClass Debug;
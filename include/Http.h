@@ -5,13 +5,17 @@
 
 #include "Arduino.h"
 
-#include <ESP8266WebServer.h>
+#include "HttpServer.h"
 #include <DNSServer.h>
+#include "Config.h"
 
 class Http
 {
 private:
     static boolean isBegin;
+    static uint8_t operationFlag; // 0 重启 1 重置 2 OTA 3 等待指示灯后重启
+    static uint32_t operationTime;
+    static boolean updateDone; // 上传的固件已完整写入
     static void handleRoot();
     static void handleMqtt();
     static void handledhcp();
@@ -24,14 +28,35 @@ private:
     static void handleModuleSetting();
     static void handleOTA();
     static void handleGetStatus();
+    static void handleBatch();
+    static void handleMetrics();
+    static void handleCrash();
+    static void handleStall();
+    static void handleSchedule();
+    static void handleWifiLink();
+    static void handleUpload();
+    static void handleUpdate();
+    static boolean isAuthorized();
     static boolean checkAuth();
 
+    static char statusCache[HTTP_STATUS_CACHE_SIZE];
+    static uint16_t statusCacheLen;
+    static uint32_t statusCacheTime;
+    static String getStatus();
+
 public:
+    static uint32_t statusCacheHit;   // get_status 命中缓存次数
+    static uint32_t statusCacheMiss;  // get_status 重新生成次数
+    static uint32_t statusRenderTime; // 生成状态JSON累计耗时 us
+    static uint32_t handleTimeMax;    // 单次 handleClient 最长耗时 us, /metrics?reset=1 清零
+
     static String _updaterError;
-    static ESP8266WebServer *server;
+    static HttpServer *server;
     static void begin();
     static void stop();
     static void loop();
+    static void restart(boolean isReset = false);
+    static uint8_t batchDo(String ops);
     static boolean captivePortal();
 };
 
@@ -0,0 +1,208 @@
+// HttpServer.h
+
+#ifndef _HTTPSERVER_h
+#define _HTTPSERVER_h
+
+#include "Arduino.h"
+#include <ESP8266WiFi.h>
+#include <functional>
+
+#define HTTP_MAX_CLIENTS 4       // 同时处理的连接数, 满了以后新连接直接断开
+#define HTTP_LINE_SIZE 512       // 请求行和单个请求头最大长度
+#define HTTP_BODY_MAX 4096       // urlencoded 请求体最大长度
+#define HTTP_PARSE_BUDGET 1460   // 每次 handleClient 每个连接最多处理的接收字节
+#define HTTP_TX_MAX 6144         // 所有连接待发送数据上限, 超过时处理函数等待对方确认
+#define HTTP_TX_WAIT 300         // 等待对方确认最长时间 ms, 超过断开该连接
+#define HTTP_CLIENT_TIMEOUT 5000 // 收齐请求头/请求体无进展/发送无进展 超时 ms
+#define HTTP_UPLOAD_BUFLEN 1460  // 上传回调每次最多的数据
+
+#define CONTENT_LENGTH_UNKNOWN ((size_t)-1)
+#define CONTENT_LENGTH_NOT_SET ((size_t)-2)
+
+// 与 ESP8266WebServer 相同的取值, 模块代码不用改
+enum HTTPMethod
+{
+    HTTP_ANY,
+    HTTP_GET,
+    HTTP_HEAD,
+    HTTP_POST,
+    HTTP_PUT,
+    HTTP_PATCH,
+    HTTP_DELETE,
+    HTTP_OPTIONS
+};
+
+enum HTTPUploadStatus
+{
+    UPLOAD_FILE_START,
+    UPLOAD_FILE_WRITE,
+    UPLOAD_FILE_END,
+    UPLOAD_FILE_ABORTED
+};
+
+enum HttpClientState
+{
+    HTTP_STATE_FREE,
+    HTTP_STATE_REQUEST, // 请求行
+    HTTP_STATE_HEADER,
+    HTTP_STATE_BODY,    // urlencoded 或丢弃的请求体
+    HTTP_STATE_UPLOAD,  // multipart/form-data 请求体, 边收边回调
+    HTTP_STATE_READY,   // 请求完整, 等待分发
+    HTTP_STATE_SENDING  // 处理函数已返回, 等待发送完成后关闭
+};
+
+enum HttpMultipartState
+{
+    HTTP_MP_BOUNDARY, // 第一个分隔符之前
+    HTTP_MP_HEADER,
+    HTTP_MP_DATA,
+    HTTP_MP_NEXT, // 分隔符之后: "--" 结束, 空行为下一段
+    HTTP_MP_END
+};
+
+typedef struct
+{
+    HTTPUploadStatus status;
+    String filename;
+    String name;
+    String type;
+    size_t totalSize;   // 已收到的文件大小
+    size_t currentSize; // buf 中的数据长度
+    uint8_t buf[HTTP_UPLOAD_BUFLEN];
+} HTTPUpload;
+
+typedef std::function<void(void)> THandlerFunction;
+
+typedef struct HttpRoute
+{
+    String uri;
+    HTTPMethod method;
+    THandlerFunction fn;
+    THandlerFunction uploadFn;
+    HttpRoute *next;
+} HttpRoute;
+
+struct tcp_pcb;
+struct pbuf;
+
+typedef struct
+{
+    tcp_pcb *pcb;       // NULL = 已被 lwIP 释放 (对方复位或出错)
+    pbuf *rx;           // 已收到未处理的数据, 处理后才确认窗口, 处理不过来时对方自然停发
+    uint16_t rxOffset;  // rx 第一个 pbuf 中已处理的字节
+    uint8_t state;      // HttpClientState
+    uint8_t method;     // HTTPMethod
+    uint8_t mpState;    // HttpMultipartState
+    uint8_t mpMatch;    // 已匹配的分隔符字节数
+    bool form;          // 请求体为 urlencoded, 需要保存
+    bool remoteClosed;  // 对方已关闭发送
+    bool mpFile;        // 当前段为文件且已回调 UPLOAD_FILE_START
+    uint32_t time;      // 超时计时起点 ms
+    size_t contentLength;
+    size_t bodyLen;     // 已收到的请求体长度
+    char *buf;          // 当前行或请求体
+    size_t bufLen;
+    size_t bufSize;
+    char *tx;           // 待交给 lwIP 的响应
+    size_t txLen;
+    size_t txPos;
+    size_t txSize;
+    String uri;
+    String query;       // URL 参数和请求体参数, 访问时才解析
+    String host;
+    String auth;
+    String delimiter;   // multipart 分隔符 "\r\n--boundary"
+    String mpName;      // 当前段字段名
+    HttpRoute *route;
+} HttpClient;
+
+/**
+ * 基于 lwIP raw TCP 回调的 HTTP 服务器, 接口与 ESP8266WebServer 用到的部分相同
+ * lwIP 回调里只挂接收数据和续发响应, 解析和处理函数都在 handleClient 里执行:
+ * 每次每个连接最多处理 HTTP_PARSE_BUDGET 字节, 最多分发一个请求, 响应写入发送缓冲后立即返回,
+ * 慢客户端只占用自己的连接; 只有大页面超过 HTTP_TX_MAX 时处理函数才等待, 最长 HTTP_TX_WAIT
+ */
+class HttpServer
+{
+private:
+    tcp_pcb *listenPcb = NULL;
+    HttpClient clients[HTTP_MAX_CLIENTS];
+    uint8_t nextClient = 0; // 轮流分发
+    HttpRoute *routes = NULL;
+    THandlerFunction notFoundFn;
+
+    HttpClient *current = NULL; // 正在处理的请求
+    HTTPUpload *uploadData = NULL;
+    HttpClient *uploadClient = NULL; // 同一时间只允许一个上传
+    String lastUri;
+    String responseHeaders;
+    size_t contentLength = CONTENT_LENGTH_NOT_SET;
+    bool responded;
+    size_t txTotal = 0; // 所有连接待发送的字节
+
+    static int8_t onAccept(void *arg, tcp_pcb *pcb, int8_t err);
+    static int8_t onRecv(void *arg, tcp_pcb *pcb, pbuf *p, int8_t err);
+    static int8_t onSent(void *arg, tcp_pcb *pcb, uint16_t len);
+    static void onError(void *arg, int8_t err);
+
+    void receive(HttpClient *c);
+    size_t parse(HttpClient *c, const char *data, size_t len);
+    size_t parseUpload(HttpClient *c, const char *data, size_t len);
+    void parseLine(HttpClient *c);
+    void parseHeader(HttpClient *c, const char *line);
+    void headerDone(HttpClient *c);
+    void partLine(HttpClient *c, const char *line);
+    void partDone(HttpClient *c);
+    void uploadCallback(HttpClient *c, HTTPUploadStatus status);
+    void consume(HttpClient *c, size_t len);
+    void dispatch(HttpClient *c);
+    void reject(HttpClient *c, int code);
+    HttpRoute *findRoute(HttpClient *c);
+
+    bool append(char *&data, size_t &len, size_t &size, const char *src, size_t n, bool progmem);
+    void write(const char *data, size_t len, bool progmem = false);
+    void flush(HttpClient *c);
+    void close(HttpClient *c);
+    void disconnect(HttpClient *c);
+    void abort(HttpClient *c);
+    void release(HttpClient *c);
+
+    bool nextArg(const char *&p, String *key, String *value);
+
+public:
+    uint32_t clientCount = 0; // 当前连接数
+    uint32_t rejectCount = 0; // 连接满/超时/请求错误 被断开的连接数
+
+    HttpServer();
+    void begin(uint16_t port);
+    void stop();
+    void handleClient();
+
+    void on(const String &uri, THandlerFunction fn);
+    void on(const String &uri, HTTPMethod method, THandlerFunction fn);
+    void on(const String &uri, HTTPMethod method, THandlerFunction fn, THandlerFunction uploadFn);
+    void onNotFound(THandlerFunction fn);
+
+    String uri();
+    HTTPMethod method();
+    String arg(const String &name);
+    String arg(int i);
+    String argName(int i);
+    int args();
+    bool hasArg(const String &name);
+    String hostHeader();
+    IPAddress localIP();
+    HTTPUpload &upload();
+    bool authenticate(const char *user, const char *pass);
+    void requestAuthentication();
+
+    void setContentLength(size_t len);
+    void sendHeader(const String &name, const String &value, bool first = false);
+    void send(int code, const char *contentType, const String &content);
+    void send(int code, const String &contentType, const String &content);
+    void send_P(int code, PGM_P contentType, PGM_P content, size_t len);
+    void sendContent(const String &content);
+    void sendContent_P(PGM_P content, size_t len);
+};
+
+#endif
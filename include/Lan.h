@@ -0,0 +1,66 @@
+// Lan.h
+
+#ifndef _LAN_h
+#define _LAN_h
+
+#include "Arduino.h"
+#include <WiFiUdp.h>
+
+#define LAN_PORT 4210                       // 组播端口
+#define LAN_GROUP IPAddress(239, 255, 42, 10) // 组播地址
+#define LAN_PACKET_SIZE 512                 // 单个数据包最大长度
+#define LAN_PEERS 8                         // 每个会话记录序号的控制端数量
+#define LAN_MAC_LEN 8                       // HMAC-SHA256 截取字节数
+#define LAN_ANNOUNCE_INTERVAL 60            // 广播设备信息间隔 s
+
+// 数据包: ESP1|类型|源UID|目标UID或*|会话:序号|内容|HMAC
+// 类型: A 设备信息 S 状态 C 命令 R 命令回复 D 发现请求 N 会话不符
+// HMAC 为 HMAC-SHA256(密钥, 最后一个 | 之前的全部内容, 含 |) 前 LAN_MAC_LEN 字节的十六进制
+// 会话为设备随机生成的 8 位十六进制数, 设备发出的每个包都带当前会话
+// 命令必须单播并带目标设备的当前会话, 会话不符或序号不大于已执行的序号时设备回复 N,
+// 内容为本会话该控制端最后执行的序号, 控制端据此更新会话和序号后重发 (控制端重启后无需保存序号)
+// 防重放: 同一会话内每个控制端的序号必须严格递增, 不依赖时钟, 不回绕
+// 会话在设备重启或同一会话的控制端超过 LAN_PEERS 个时更换, 更换后旧会话的命令全部拒绝,
+// 因此已执行的命令不能被重放; 被截获且未送达的命令在会话更换前仍可能被投递一次
+
+typedef struct
+{
+    uint32_t hash; // 源 UID 哈希, 0 = 空
+    uint32_t seq;  // 本会话最后一次执行的命令序号
+} LanPeer;
+
+class Lan
+{
+private:
+    static WiFiUDP udp;
+    static bool started;
+    static uint32_t localIp;
+    static uint32_t session; // 当前会话
+    static uint32_t seq;
+    static uint8_t operationFlag; // 0 广播设备信息 1 广播状态
+    static LanPeer peers[LAN_PEERS];
+    static uint8_t peerCount;
+    static char packet[LAN_PACKET_SIZE];
+
+    static void sign(const char *data, size_t len, char *hex);
+    static void send(char type, const char *dst, uint32_t seq, String payload, bool isReply);
+    static void newSession();
+    static bool checkSeq(const char *src, uint32_t seq, uint32_t *last);
+    static void handle(int len);
+    static String getStatus();
+
+public:
+    static uint32_t rxCount;    // 收到的有效数据包
+    static uint32_t cmdCount;   // 执行的命令
+    static uint32_t authFail;   // 签名错误
+    static uint32_t dupCount;   // 重复或会话不符的命令
+    static uint32_t cmdTime;    // 最近一次命令执行耗时 us
+
+    static void init();
+    static void stop();
+    static void loop();
+    static void perSecondDo();
+    static void stateChanged();
+};
+
+#endif
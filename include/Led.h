@@ -6,20 +6,53 @@
 #include "Arduino.h"
 #include <Ticker.h>
 
+#define LED_STEPS 4                   // 每个样式最多步数
+#define LED_ON_MS(ms) (0x8000 | (ms)) // 亮 ms
+#define LED_OFF_MS(ms) (ms)           // 灭 ms
+
+// 指示灯样式: 按步骤依次亮灭, 由定时器播放
+typedef struct
+{
+    uint8_t priority;          // 0 为状态指示, 数值大的打断数值小的
+    uint8_t repeat;            // 重复次数, 0 = 一直循环
+    uint8_t count;             // 步数
+    uint16_t steps[LED_STEPS]; // bit15 亮, 低15位为持续时间 ms
+} LedPattern;
+
+extern const LedPattern LED_WIFI;      // 未连接 WiFi
+extern const LedPattern LED_MQTT;      // 未连接 MQTT
+extern const LedPattern LED_ONLINE;    // 正常
+extern const LedPattern LED_MODULE;    // 模块占用 (常亮)
+extern const LedPattern LED_CONNECTED; // MQTT 连接成功
+extern const LedPattern LED_NOTICE;    // 射频学习/删除、OTA
+extern const LedPattern LED_LOGIN;     // 小爱登录
+extern const LedPattern LED_RESTART;   // 重启前
+
 class Led
 {
 protected:
     static uint8_t io;
     static uint8_t light;
     static Ticker *ledTicker;
-    static Ticker *ledTicker2;
     static uint8_t ledType;
 
+    static LedPattern base;    // 状态指示样式
+    static LedPattern current; // 正在播放的样式
+    static uint8_t stepIndex;
+    static uint8_t repeatLeft;
+    static bool playing; // 正在播放一次性样式
+
+    static void setBase(const LedPattern *pattern);
+    static void start(const LedPattern &pattern);
+    static void step();
+    static void next();
+
 public:
     static void init(uint8_t _io, uint8_t _light);
     static void loop();
     static void led(int ms = 200);
-    static void blinkLED(int duration, int n);
+    static void play(const LedPattern *pattern);
+    static bool isPlaying();
 };
 
 #endif
@@ -0,0 +1,45 @@
+// Metrics.h
+
+#ifndef _METRICS_h
+#define _METRICS_h
+
+#include "Arduino.h"
+#include "HttpServer.h"
+
+#define METRICS_MAX 56         // 最大指标数, 编译时由 scripts/metrics-count.py 检查
+#define METRICS_LINE_SIZE 128 // 单行最大长度
+
+enum MetricsType
+{
+    METRICS_COUNTER,
+    METRICS_GAUGE
+};
+
+typedef struct
+{
+    PGM_P name;            // 指标名 PROGMEM
+    uint8_t type;          // MetricsType
+    const uint32_t *value; // 直接读取的变量
+    uint32_t (*getter)();  // 或者通过函数获取
+} MetricsEntry;
+
+class Metrics
+{
+private:
+    static MetricsEntry entries[METRICS_MAX];
+    static uint8_t count;
+    static size_t format(char *buf, uint8_t i, uint32_t value);
+
+public:
+    static uint32_t loopTime;    // 最近一次 loop 耗时 us
+    static uint32_t loopTimeMax; // 最大 loop 耗时 us, /metrics?reset=1 清零
+    static uint32_t webLogDrop;  // web 日志被挤出的条数
+
+    static void init();
+    static boolean add(PGM_P name, uint8_t type, const uint32_t *value);
+    static boolean add(PGM_P name, uint8_t type, uint32_t (*getter)());
+    static void loopDone(uint32_t start);
+    static void handle(HttpServer *server);
+};
+
+#endif
@@ -4,7 +4,7 @@
 #define _MODULE_h
 
 #include "Arduino.h"
-#include <ESP8266WebServer.h>
+#include "HttpServer.h"
 
 class Module
 {
@@ -21,9 +21,14 @@ public:
     virtual void resetConfig();
     virtual void saveConfig();
 
-    virtual void httpAdd(ESP8266WebServer *server);
-    virtual void httpHtml(ESP8266WebServer *server);
-    virtual String httpGetStatus(ESP8266WebServer *server);
+    virtual void httpAdd(HttpServer *server);
+    virtual void httpHtml(HttpServer *server);
+    virtual String httpGetStatus(HttpServer *server);
+
+    virtual boolean batchCommand(String key, String value);
+    virtual void batchCommit();
+
+    virtual void scheduleDo(uint8_t target, uint8_t value);
 
     virtual void mqttCallback(String topicStr, String str);
     virtual void mqttConnected();
@@ -12,14 +12,18 @@
 class Mqtt
 {
 protected:
-    String getTopic(uint8_t prefix, String subtopic);
+    String getTopic(uint8_t prefix, String subtopic, const char *hostname = NULL);
     String topicCmnd;
     String topicStat;
     String topicTele;
     uint8_t operationFlag = 0;
+    boolean publishResult(boolean result);
 
 public:
+    Mqtt();
     PubSubClient mqttClient;
+    uint32_t connectCount = 0;     // 连接成功次数
+    uint32_t publishFailCount = 0; // 发布失败次数
     void (*_connectedCallback)(void) = NULL;
 
     uint32_t lastReconnectAttempt = 0;         // 最后尝试重连时间
@@ -33,6 +37,7 @@ public:
 
     void setTopic();
     String getCmndTopic(String topic);
+    String getCmndTopic(String topic, const char *hostname); // 其他设备的命令主题
     String getStatTopic(String topic);
     String getTeleTopic(String topic);
 
@@ -5,6 +5,11 @@
 
 #include "Arduino.h"
 
+#define NTP_TIMEZONE 8        // 时区
+#define NTP_STEP_US 1000000   // 偏差超过1秒直接跳变, 否则平滑追赶
+#define NTP_SLEW_PPM 500      // 平滑追赶最大速率
+#define NTP_FREQ_MAX_PPB 500000 // 频率修正上限 ±500ppm
+
 #define LEAP_YEAR(Y) (((1970 + Y) > 0) && !((1970 + Y) % 4) && (((1970 + Y) % 100) || !((1970 + Y) % 400)))
 
 typedef struct
@@ -27,14 +32,28 @@ protected:
     static uint32_t utcTime;
     static uint8_t operationFlag;
     static void breakTime(uint32_t time_input, TIME_T &tm);
+    static void tick(TIME_T &tm);
     static void getNtp();
 
+    // 以micros64为基准的校准时钟: utc = baseUtc + elapsed * (1 + freq) + slew
+    static uint64_t baseMicros; // 上次采样时的本地微秒
+    static uint64_t baseUtc;    // 上次采样时的校准时间 (微秒, 已含时区)
+    static int32_t freqPpb;     // 本地晶振频率修正 (十亿分之一)
+    static int32_t slewUs;      // 待平滑追赶的偏差
+    static int32_t lastOffset;  // 最近一次采样偏差
+    static uint8_t sampleCount;
+    static void sample(uint64_t ntpUs);
+    static void timeSet();
+
 public:
     static String msToHumanString(uint32_t const msecs);
     static String timeSince(uint32_t const start);
 
     static String GetBuildDateAndTime();
     static void perSecondDo();
+    static uint64_t nowUs();
+    static uint64_t nowMs() { return nowUs() / 1000; }
+    static uint16_t millisecond();
     static TIME_T rtcTime;
     static void init();
     static void loop();
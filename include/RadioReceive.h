@@ -19,6 +19,8 @@ protected:
 
 public:
     uint8_t studyCH = 0;
+    uint32_t receiveCount = 0; // 收到的遥控码数
+    uint32_t matchCount = 0;   // 匹配到通道的遥控码数
     void init(Relay *_relay, uint8_t io);
     void study(uint8_t ch);
     void del(uint8_t ch);
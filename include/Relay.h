@@ -6,12 +6,15 @@
 
 #include "Arduino.h"
 #include <Ticker.h>
-#include <ESP8266WebServer.h>
+#include "HttpServer.h"
 #include "Module.h"
+#include "RelayBinding.h"
 
 #define MODULE_CFG_VERSION 1001 //1001 - 1500
 #define MAX_GPIO_PIN 17         // Number of supported GPIO
 #define MIN_FLASH_PINS 4        // Number of flash chip pins unusable for configuration (GPIO6, 7, 8 and 11)
+#define LED_BREATH_INTERVAL 20  // 呼吸灯刷新间隔 ms
+#define LED_BREATH_MIN 50       // 呼吸灯最暗 PWM
 
 const char HASS_DISCOVER_RELAY[] PROGMEM =
     "{\"name\":\"%s_%d\","
@@ -23,6 +26,8 @@ const char HASS_DISCOVER_RELAY[] PROGMEM =
     "\"pl_avail\":\"online\","
     "\"pl_not_avail\":\"offline\"}";
 
+typedef PB_BYTES_ARRAY_T(32) RelayConfigMessage_binding_t; // BINDING_MAX 条 BINDING_ENTRY_SIZE 字节
+
 typedef struct _RelayConfigMessage {
     uint8_t led_type;
     uint16_t led_start;
@@ -40,13 +45,13 @@ typedef struct _RelayConfigMessage {
     uint16_t downlight_interval;
     uint8_t power_mode;
     uint8_t module_type;
+    RelayConfigMessage_binding_t binding;
 } RelayConfigMessage;
 
-extern const pb_field_t RelayConfigMessage_fields[17];
-#define RelayConfigMessage_size 361
+extern const pb_field_t RelayConfigMessage_fields[18];
+#define RelayConfigMessage_size 396
 
 class RadioReceive;
-class RelayButton;
 class Relay : public Module
 {
 private:
@@ -54,9 +59,9 @@ private:
 
     // PWM
     Ticker *ledTicker;
-    int ledLevel = 0;
+    uint32_t ledPhase = 0; // 呼吸相位, 一个周期 65536
+    int ledLevel = -1;     // 上次写入的 PWM, -1 为需要重新写入
     int ledLight = 2023;
-    boolean ledUp = true;
     boolean canLed = true;
     void led(uint8_t ch, bool isOn);
     void ledPWM(uint8_t ch, bool isOn);
@@ -64,18 +69,35 @@ private:
     boolean checkCanLed(boolean re = false);
 
     String powerTopic;
-    RelayButton *btns;
+    unsigned long buttonTime[4] = {0, 0, 0, 0}; // 按键上次切换继电器的时间
+    static void buttonCallback(uint8_t ch, uint8_t event, uint8_t count);
+
+    boolean isBatch = false;
+    uint8_t batchPublish = 0; // 批量操作中待发布的通道
 
-    void httpDo(ESP8266WebServer *server);
-    void httpRadioReceive(ESP8266WebServer *server);
-    void httpSetting(ESP8266WebServer *server);
-    void httpDownlightSetting(ESP8266WebServer *server);
+    void httpDo(HttpServer *server);
+    void httpRadioReceive(HttpServer *server);
+    void httpSetting(HttpServer *server);
+    void httpDownlightSetting(HttpServer *server);
 
     void loadModule(uint8_t module);
 
+    // 按键绑定
+    EspNowRadio *espNow = NULL;
+    RelayBinding *binding = NULL;
+    void bindingInit();
+    void bindingLoop();
+    String bindingFormat();
+    bool bindingParse(String str);
+    static void bindingSign(const uint8_t *data, uint8_t len, uint8_t *mac);
+    static void bindingSwitch(uint8_t ch, bool isOn);
+    static void bindingFallback(const uint8_t *mac, uint8_t ch, bool isOn);
+
 public:
     RelayConfigMessage config;
     RadioReceive *radioReceive;
+    uint32_t ledTime = 0;   // 呼吸灯累计耗时 us
+    uint32_t ledWrites = 0; // 呼吸灯 PWM 写入次数
     boolean lastState[4] = {false, false, false, false};
     uint8_t channels = 0;
 
@@ -95,11 +117,17 @@ public:
     void mqttConnected();
     void mqttDiscovery(boolean isEnable = true);
 
-    void httpAdd(ESP8266WebServer *server);
-    void httpHtml(ESP8266WebServer *server);
-    String httpGetStatus(ESP8266WebServer *server);
+    void httpAdd(HttpServer *server);
+    void httpHtml(HttpServer *server);
+    String httpGetStatus(HttpServer *server);
+
+    boolean batchCommand(String key, String value);
+    void batchCommit();
+
+    void scheduleDo(uint8_t target, uint8_t value);
 
     void switchRelay(uint8_t ch, bool isOn, bool isSave = true);
+    void bindingPress(uint8_t ch);
 };
 
 typedef struct MYTMPLT
@@ -0,0 +1,137 @@
+// RelayBinding.h
+#ifdef USE_RELAY
+
+#ifndef _RELAYBINDING_h
+#define _RELAYBINDING_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define BINDING_MAX 4             // 绑定数量
+#define BINDING_ENTRY_SIZE 8      // 配置中每条绑定: 本地通道 远程通道 MAC[6]
+#define BINDING_PENDING 4         // 同时等待确认的命令
+#define BINDING_PEERS 4           // 记录序号的发送端数量
+#define BINDING_ACK_TIMEOUT 30000 // 等待确认 us
+#define BINDING_RETRY 3           // 超时重发次数, 全部失败后转 MQTT
+#define BINDING_MAC_LEN 8         // HMAC-SHA256 截取字节数
+#define BINDING_FRAME_SIZE 18     // 帧: 'B' 类型 会话(4) 序号(2) 通道 状态 HMAC(8), 多字节均为小端
+#define BINDING_RX_QUEUE 4        // 接收队列
+
+// 防伪造: HMAC 为 HMAC-SHA256(局域网密钥, 帧的前 10 字节) 前 BINDING_MAC_LEN 字节, 由 signCallback 计算
+// 防重放: 接收端开机随机生成会话, 命令必须带接收端当前会话, 同一会话内每个发送端的 16 位序号按序号算术严格递增
+// 会话不符或序号较旧时回复 NAK: 会话为接收端当前会话, 序号为该发送端最后执行的序号, 通道和状态两字节为被拒绝的序号
+// 发送端据此更新会话和序号后重发, 因此任何一端重启后第一次按键多一次往返
+// 与最后执行的序号相同时视为重发, 只确认不执行; 记录的发送端超过 BINDING_PEERS 个时更换会话
+enum BindingFrameType
+{
+    BINDING_CMD = 1,
+    BINDING_ACK = 2,
+    BINDING_NAK = 3
+};
+
+typedef struct
+{
+    uint8_t local;  // 本机按键通道
+    uint8_t remote; // 远程继电器通道
+    uint8_t mac[6]; // 远程设备 MAC
+} BindingEntry;
+
+typedef struct
+{
+    uint8_t mac[6];
+    uint8_t frame[BINDING_FRAME_SIZE];
+    uint8_t tries;   // 已发送次数, 0 = 空闲
+    uint32_t start;  // 按键时间
+    uint32_t sentAt; // 最近一次发送时间
+} BindingPending;
+
+typedef struct
+{
+    uint8_t mac[6];
+    uint16_t seq; // 本会话最后一次执行的序号
+} BindingPeer;
+
+typedef struct
+{
+    uint8_t mac[6];
+    uint32_t session; // 对方当前会话, 0 = 未知
+    uint16_t seq;     // 发给对方的最后一个序号
+} BindingRemote;
+
+// 无线收发接口, 设备上为 ESP-NOW, 主机测试时可替换为模拟实现
+class BindingRadio
+{
+public:
+    virtual bool send(const uint8_t *mac, const uint8_t *data, uint8_t len) = 0;
+};
+
+// 绑定/确认/重发逻辑, 不依赖 Arduino, 时间由调用方传入 (us)
+class RelayBinding
+{
+private:
+    BindingRadio *radio;
+    BindingEntry entries[BINDING_MAX];
+    uint8_t count = 0;
+    BindingRemote remotes[BINDING_MAX];
+    uint8_t remoteCount = 0;
+    BindingPending pending[BINDING_PENDING];
+    BindingPeer peers[BINDING_PEERS];
+    uint8_t peerCount = 0;
+    uint32_t session; // 本机作为接收端的当前会话
+
+    bool isKnown(const uint8_t *mac);
+    BindingRemote *findRemote(const uint8_t *mac);
+    int checkSeq(const uint8_t *mac, uint32_t rxSession, uint16_t seq, uint16_t *last);
+    void newSession();
+    void sign(uint8_t *frame);
+    bool verify(const uint8_t *frame);
+    void sendFrame(const uint8_t *mac, uint8_t type, uint32_t frameSession, uint16_t frameSeq, uint8_t b0, uint8_t b1);
+    void queue(const uint8_t *mac, uint8_t ch, bool isOn, uint32_t now);
+
+public:
+    uint32_t sentCount = 0;     // 发出的命令
+    uint32_t ackCount = 0;      // 收到的确认
+    uint32_t retryCount = 0;    // 重发次数
+    uint32_t fallbackCount = 0; // 转 MQTT 次数
+    uint32_t rxCount = 0;       // 执行的远程命令
+    uint32_t rejectCount = 0;   // 校验失败或重放的帧
+    uint32_t resyncCount = 0;   // 收到 NAK 后更新会话重发
+    uint32_t latency = 0;       // 最近一次按键到收到确认 us
+
+    void (*switchCallback)(uint8_t ch, bool isOn) = NULL;                      // 执行远程命令
+    void (*fallbackCallback)(const uint8_t *mac, uint8_t ch, bool isOn) = NULL; // 无确认时转发
+    void (*signCallback)(const uint8_t *data, uint8_t len, uint8_t *mac) = NULL; // 计算 HMAC, 未设置时不收发
+
+    RelayBinding(BindingRadio *_radio, uint32_t _session);
+    uint8_t load(const uint8_t *bytes, size_t size);
+    uint8_t getCount() { return count; }
+    const BindingEntry *getEntry(uint8_t i) { return &entries[i]; }
+
+    uint8_t press(uint8_t ch, bool isOn, uint32_t now);
+    void receive(const uint8_t *mac, const uint8_t *data, uint8_t len, uint32_t now);
+    void loop(uint32_t now);
+};
+
+#ifdef ARDUINO
+// ESP-NOW 回调运行在系统任务中, 只入队, 由 Relay::loop 处理
+class EspNowRadio : public BindingRadio
+{
+private:
+    static uint8_t rxMac[BINDING_RX_QUEUE][6];
+    static uint8_t rxData[BINDING_RX_QUEUE][BINDING_FRAME_SIZE];
+    static volatile uint8_t rxHead;
+    static volatile uint8_t rxTail;
+    static void receiveCallback(uint8_t *mac, uint8_t *data, uint8_t len);
+
+public:
+    uint8_t state = 0; // 0 未初始化 1 正常 2 初始化失败
+
+    bool begin();
+    bool send(const uint8_t *mac, const uint8_t *data, uint8_t len);
+    bool read(uint8_t *mac, uint8_t *data);
+};
+#endif
+
+#endif
+
+#endif
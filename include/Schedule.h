@@ -0,0 +1,59 @@
+// Schedule.h
+
+#ifndef _SCHEDULE_h
+#define _SCHEDULE_h
+
+#include "Arduino.h"
+#include "Config.h"
+
+// 定时任务打包格式 (uint32):
+// bit 0~10  时间: 每天 = 当天分钟数 0~1439, 每小时 = 分钟 0~59, 日出日落 = 偏移分钟 + 720
+// bit 11~17 星期掩码 bit0 = 周日, 0 = 禁用
+// bit 18~19 类型 SCHEDULE_KIND_x
+// bit 20~23 目标 (继电器通道 / 按键)
+// bit 24~31 值 (0 关 1 开 2 切换, 窗帘为位置 0~100)
+#define SCHEDULE_TIME(e) ((e)&0x7FF)
+#define SCHEDULE_DAYS(e) (((e) >> 11) & 0x7F)
+#define SCHEDULE_KIND(e) (((e) >> 18) & 0x03)
+#define SCHEDULE_TARGET(e) (((e) >> 20) & 0x0F)
+#define SCHEDULE_VALUE(e) (((e) >> 24) & 0xFF)
+#define SCHEDULE_PACK(time, days, kind, target, value) ((uint32_t)(time)&0x7FF | ((uint32_t)(days)&0x7F) << 11 | ((uint32_t)(kind)&0x03) << 18 | ((uint32_t)(target)&0x0F) << 20 | (uint32_t)(value) << 24)
+
+#define SCHEDULE_NONE 0xFFFFFFFF
+
+enum ScheduleKind
+{
+    SCHEDULE_KIND_DAILY,
+    SCHEDULE_KIND_HOURLY,
+    SCHEDULE_KIND_SUNRISE,
+    SCHEDULE_KIND_SUNSET
+};
+
+class Schedule
+{
+private:
+    static uint32_t next[SCHEDULE_MAX]; // 每条任务下次执行的分钟 (本地时间)
+    static uint32_t nextFire;           // 所有任务中最早的一次
+    static uint32_t lastMinute;         // 上次检查的分钟
+    static uint8_t operationFlag;
+
+    static int16_t sunTime(uint32_t day, bool isRise);
+    static uint32_t nextTime(uint32_t entry, uint32_t after);
+    static void fire(uint32_t minute);
+    static String format(uint32_t entry);
+    static bool parse(String str, uint32_t *entry);
+
+public:
+    static uint32_t fireCount; // 已执行次数
+    static uint32_t lagTime;   // 最近一次执行相对计划时间的延迟 ms
+    static uint32_t execTime;  // 最近一次模块执行耗时 us
+
+    static void init();
+    static void reload();
+    static void perSecondDo();
+    static void loop();
+    static String toJson();
+    static bool set(String entries);
+};
+
+#endif
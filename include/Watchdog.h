@@ -0,0 +1,59 @@
+// Watchdog.h
+
+#ifndef _WATCHDOG_h
+#define _WATCHDOG_h
+
+#include "Arduino.h"
+
+#define WATCHDOG_BUDGET 100      // 默认单个阶段最长耗时 ms
+#define WATCHDOG_BUDGET_MAX 5000 // /stall 可设置的上限 ms, 再长硬件看门狗早已复位
+#define WATCHDOG_LOG_NUM 6       // 保存的卡顿记录数
+
+enum WatchdogStage
+{
+    WATCHDOG_STAGE_NONE,
+    WATCHDOG_STAGE_LED,
+    WATCHDOG_STAGE_DEBUG,
+    WATCHDOG_STAGE_MQTT,
+    WATCHDOG_STAGE_MODULE,
+    WATCHDOG_STAGE_WIFI,
+    WATCHDOG_STAGE_HTTP,
+    WATCHDOG_STAGE_NTP
+};
+
+typedef struct
+{
+    uint8_t stage;
+    uint32_t time;      // 耗时 ms
+    uint32_t addr;      // 最后一次 mark 的返回地址
+    uint32_t perSecond; // 发生时间
+    char tag[24];       // 附加信息，如 HTTP 的 uri
+} WatchdogStall;
+
+class Watchdog
+{
+private:
+    static uint8_t stage;
+    static uint32_t startTime;
+    static uint32_t addr;
+    static WatchdogStall stalls[WATCHDOG_LOG_NUM];
+    static uint8_t stallIndex;
+    static uint32_t reportCount;
+    static uint8_t operationFlag;
+
+public:
+    static uint32_t budget;
+    static uint32_t stallCount;
+
+    static void init();
+    static void begin(uint8_t _stage);
+    static void mark();
+    static bool end();
+    static void setTag(const char *tag);
+
+    static String toJson();
+    static void perSecondDo();
+    static void loop();
+};
+
+#endif
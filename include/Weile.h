@@ -5,7 +5,7 @@
 #define _WEILE_h
 
 #include "Arduino.h"
-#include <ESP8266WebServer.h>
+#include "HttpServer.h"
 #include "Module.h"
 
 #define MODULE_CFG_VERSION 2501 //2501 - 3000
@@ -40,19 +40,12 @@ class Weile : public Module
 private:
     WeileConfigMessage config;
 
-    // 按键
-    int buttonDebounceTime = 50;
-    int buttonLongPressTime = 2000; // 2000 = 2s
-    boolean buttonTiming = false;
-    unsigned long buttonTimingStart = 0;
-    int buttonAction = 0; // 0 = 没有要执行的动作, 1 = 执行短按动作, 2 = 执行长按动作
+    void httpPosition(HttpServer *server);
+    void httpDo(HttpServer *server);
+    void httpSetting(HttpServer *server);
+    void httpReset(HttpServer *server);
 
-    void httpPosition(ESP8266WebServer *server);
-    void httpDo(ESP8266WebServer *server);
-    void httpSetting(ESP8266WebServer *server);
-    void httpReset(ESP8266WebServer *server);
-
-    void checkButton();
+    static void buttonCallback(uint8_t arg, uint8_t event, uint8_t count);
 
     String powerTopic;
     boolean weiLeStatus = false;
@@ -83,9 +76,14 @@ public:
     void mqttConnected();
     void mqttDiscovery(boolean isEnable = true);
 
-    void httpAdd(ESP8266WebServer *server);
-    void httpHtml(ESP8266WebServer *server);
-    String httpGetStatus(ESP8266WebServer *server);
+    void httpAdd(HttpServer *server);
+    void httpHtml(HttpServer *server);
+    String httpGetStatus(HttpServer *server);
+
+    boolean batchCommand(String key, String value);
+    void batchCommit();
+
+    void scheduleDo(uint8_t target, uint8_t value);
 };
 #endif
 
@@ -6,6 +6,47 @@
 #include "Arduino.h"
 #include <WiFiClient.h>
 #include <DNSServer.h>
+#include "Config.h"
+
+typedef struct
+{
+    uint32_t hash;   // SSID 哈希
+    int8_t rssi;
+    uint8_t enc;
+    uint8_t channel;
+    char ssid[33];   // SDK 结果在下一次扫描时会被清空, 这里保存副本
+} WifiScanResult;
+
+typedef struct
+{
+    uint32_t crc;     // 以下内容及 SSID 的 crc32
+    uint8_t bssid[6]; // 上次连接成功的 AP
+    uint8_t channel;
+    uint8_t reserved;
+    uint32_t ip; // DHCP 分配的地址, 0 = 静态IP
+    uint32_t gw;
+    uint32_t sn;
+    uint32_t dns;
+} WifiCache;
+
+typedef struct
+{
+    int8_t min;
+    int8_t avg;
+    int8_t max;
+    uint8_t count; // 采样数, 0 = 这一分钟没有连接
+} WifiRssiMinute;
+
+typedef struct
+{
+    uint32_t time;   // 断线时的运行秒数
+    uint32_t outage; // 断线到重新获取IP ms
+    uint16_t assoc;  // 断线到重新关联 ms
+    uint16_t dhcp;   // 关联到获取IP ms
+    uint8_t reason;  // SDK 断线原因 WiFiDisconnectReason, 0 = 启动
+    uint8_t retry;   // 期间收到的断线事件数
+    int8_t rssi;     // 断线前信号
+} WifiLinkEvent;
 
 class Wifi
 {
@@ -17,11 +58,72 @@ private:
 
     static DNSServer *dnsServer;
 
+    static bool scanRunning;
+    static uint32_t ssidHash(const char *ssid);
+    static void scanLoop();
+
+    static WifiCache cache;
+    static uint8_t cacheFrom;              // 0 无缓存 1 RTC 2 flash
+    static bool cacheIp;                   // 当前使用缓存的 DHCP 地址
+    static unsigned long fastConnectStart; // 快速连接开始时间 0 = 未进行
+    static uint32_t cacheCrc(const WifiCache &c);
+    static uint8_t cacheLoad();
+    static void cacheSave(const WiFiEventStationModeGotIP &event);
+    static void cacheClear();
+    static void fastConnectLoop();
+
+    static bool directed;              // 最近一次 WiFi.begin 指定了 BSSID
+    static unsigned long lostTime;     // 断线开始时间
+    static int16_t rssiAvg;            // RSSI 移动平均 x16, 0 = 无数据
+    static unsigned long rssiTime;     // 上次采样时间
+    static unsigned long roamTime;     // 上次漫游扫描时间
+    static bool roamArmed;             // 迟滞: 漫游后信号回升或超过间隔才允许再次漫游
+    static bool roamScan;              // 当前扫描为漫游扫描
+    static bool roamPending;           // 已切换, 等待连接后记录新信号
+    static void roamLoop();
+    static void roamScanDone(int8_t n);
+
+    static WifiRssiMinute rssiHistory[WIFI_RSSI_HISTORY];
+    static uint8_t rssiHead;      // 下一条写入位置
+    static uint8_t rssiLen;
+    static uint32_t rssiMinute;   // 当前统计的分钟
+    static int8_t rssiMin;
+    static int8_t rssiMax;
+    static int32_t rssiSum;
+    static uint8_t rssiCount;
+    static WifiLinkEvent linkEvents[WIFI_LINK_EVENTS];
+    static uint8_t linkHead;
+    static uint8_t linkLen;
+    static WifiLinkEvent linkNow; // 进行中的断线
+    static bool linkDown;
+    static unsigned long downStart;
+    static unsigned long assocTime;
+    static int8_t lastRssi;
+    static void linkSample(int8_t rssi);
+    static void linkLoop();
+    static void linkUp();
+
+    static uint32_t crc32(uint32_t crc, const uint8_t *data, size_t len);
+    static int8_t otaManifest(String url, uint32_t *size, uint32_t *crc);
+    static bool otaDownload(String url, uint32_t size, uint32_t crc);
+
 public:
     static unsigned long configPortalStart;
     static void OTA(String url);
     static bool isDHCP;
     static WiFiEventHandler STAGotIP;
+    static WiFiEventHandler STAConnected;
+    static WiFiEventHandler STADisconnected;
+    static uint32_t connectTime;   // 上电到获取IP耗时 ms
+    static uint32_t fastFailCount; // 快速连接失败次数
+    static uint32_t roamCount;     // 漫游次数
+    static uint32_t roamScanCount; // 漫游扫描次数
+    static int8_t roamBefore;      // 最近一次漫游前后的信号 dBm
+    static int8_t roamAfter;
+    static uint32_t disconnectCount; // 断线次数
+    static uint32_t outageTime;      // 累计断线时长 ms
+    static String linkJson();
+    static String linkSummary();
     static WiFiClient wifiClient;
     static void connectWifi();
     static void setupWifi();
@@ -31,6 +133,11 @@ public:
     static uint8_t waitForConnectResult();
     static void tryConnect(String ssid, String pass);
 
+    static WifiScanResult scanResult[WIFI_SCAN_MAX];
+    static uint8_t scanCount;
+    static unsigned long scanTime; // 最后一次扫描完成时间 0 = 没有结果
+    static void scanStart();
+
     static void loop();
 };
 
@@ -5,7 +5,7 @@
 #define _XIAOAI_h
 
 #include "Arduino.h"
-#include <ESP8266WebServer.h>
+#include "HttpServer.h"
 #include "Module.h"
 
 #define MODULE_CFG_VERSION 3001 //3001 - 3500
@@ -27,13 +27,6 @@ class XiaoAi : public Module
 private:
     XiaoAiConfigMessage config;
 
-    // 按键
-    int buttonDebounceTime = 50;
-    int buttonLongPressTime = 2000; // 2000 = 2s
-    boolean buttonTiming = false;
-    unsigned long buttonTimingStart = 0;
-    int buttonAction = 0; // 0 = 没有要执行的动作, 1 = 执行短按动作, 2 = 执行长按动作
-
     uint8_t operationFlag = 0;
     boolean isLogin = false;
 
@@ -42,10 +35,10 @@ private:
     char *lastContext[1024]; // 最后内容
 
     void serialEvent();
-    void checkButton();
+    static void buttonCallback(uint8_t arg, uint8_t event, uint8_t count);
 
-    void httpSetting(ESP8266WebServer *server);
-    void httpCmd(ESP8266WebServer *server);
+    void httpSetting(HttpServer *server);
+    void httpCmd(HttpServer *server);
 
 public:
     void init();
@@ -64,9 +57,14 @@ public:
     void mqttConnected();
     void mqttDiscovery(boolean isEnable = true);
 
-    void httpAdd(ESP8266WebServer *server);
-    void httpHtml(ESP8266WebServer *server);
-    String httpGetStatus(ESP8266WebServer *server);
+    void httpAdd(HttpServer *server);
+    void httpHtml(HttpServer *server);
+    String httpGetStatus(HttpServer *server);
+
+    boolean batchCommand(String key, String value);
+    void batchCommit();
+
+    void scheduleDo(uint8_t target, uint8_t value);
 };
 #endif
 
@@ -5,7 +5,7 @@
 #define _ZINGUO_h
 
 #include "Arduino.h"
-#include <ESP8266WebServer.h>
+#include "HttpServer.h"
 #include <Ticker.h>
 #include "Module.h"
 
@@ -94,12 +94,16 @@ private:
 
     uint8_t operationFlag = 0;
 
+    boolean isBatch = false;
+    uint8_t batchPublish = 0; // 批量操作中待发布的按键
+
     Ticker *schTicker;
     void beepBeep(char i);
     void convertTemp();
     void dispCtrl();
     unsigned short getKey();
     void analysisKey(unsigned short code);
+    void publishState(uint8_t key, bool isOn);
 
     // 照明 Key1
     void switchLight(boolean isOn, bool isBeep = true);
@@ -114,9 +118,11 @@ private:
     void switchBlowReal(boolean isOn, bool isBeep = true);
     // 全关 Key3
     void switchCloseAll(boolean isOn, bool isBeep = true);
+    // 按编号开关 KEY_x
+    void switchKey(uint8_t key, boolean isOn, bool isBeep = true);
 
-    void httpDo(ESP8266WebServer *server);
-    void httpSetting(ESP8266WebServer *server);
+    void httpDo(HttpServer *server);
+    void httpSetting(HttpServer *server);
 
 public:
     void init();
@@ -135,9 +141,14 @@ public:
     void mqttConnected();
     void mqttDiscovery(boolean isEnable = true);
 
-    void httpAdd(ESP8266WebServer *server);
-    void httpHtml(ESP8266WebServer *server);
-    String httpGetStatus(ESP8266WebServer *server);
+    void httpAdd(HttpServer *server);
+    void httpHtml(HttpServer *server);
+    String httpGetStatus(HttpServer *server);
+
+    boolean batchCommand(String key, String value);
+    void batchCommit();
+
+    void scheduleDo(uint8_t target, uint8_t value);
 };
 #endif
 
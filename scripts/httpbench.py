@@ -0,0 +1,125 @@
+# HTTP 负载下的 loop 延迟测量
+# 用法: python scripts/httpbench.py 10.0.0.25 [-c 4] [--slow 2] [-t 30] [--path /get_status] [--user admin --password xxx]
+# 先空载测一个窗口作为基准, 再用 -c 个并发连接不停请求 --path, --slow 个慢速客户端逐字节发送请求头,
+# 每个窗口开始前请求 /metrics?reset=1 清零设备端最大值, 结束后读取:
+#   esp_loop_time_max_us         窗口内单次 loop 最长耗时
+#   esp_http_handle_time_max_us  窗口内单次 handleClient 最长耗时
+#   esp_http_clients             当前连接数, esp_http_reject_total 连接满/超时/请求错误被断开的连接数
+# 同时统计客户端看到的请求耗时分布和失败数
+
+import argparse
+import base64
+import socket
+import threading
+import time
+
+KEYS = ["esp_loop_time_max_us", "esp_http_handle_time_max_us", "esp_heap_free_bytes", "esp_heap_max_block_bytes", "esp_http_clients",
+        "esp_http_reject_total"]
+
+
+def request(args, path, timeout=5):
+    s = socket.create_connection((args.host, args.port), timeout=timeout)
+    head = "GET {} HTTP/1.1\r\nHost: {}\r\nConnection: close\r\n".format(path, args.host)
+    if args.user:
+        token = base64.b64encode("{}:{}".format(args.user, args.password).encode()).decode()
+        head += "Authorization: Basic {}\r\n".format(token)
+    s.sendall((head + "\r\n").encode())
+    data = b""
+    while True:
+        chunk = s.recv(4096)
+        if not chunk:
+            break
+        data += chunk
+    s.close()
+    return data
+
+
+def metrics(args, reset=False):
+    data = request(args, "/metrics?reset=1" if reset else "/metrics")
+    body = data.partition(b"\r\n\r\n")[2].decode("utf-8", "replace")
+    values = {}
+    for line in body.split("\n"):
+        if line and not line.startswith("#"):
+            name, _, value = line.partition(" ")
+            values[name] = int(value)
+    return values
+
+
+def worker(args, stop, times, errors):
+    while not stop.is_set():
+        start = time.time()
+        try:
+            if not request(args, args.path).startswith(b"HTTP/1.1 200"):
+                errors.append(1)
+                continue
+            times.append((time.time() - start) * 1000)
+        except OSError:
+            errors.append(1)
+
+
+def slow_worker(args, stop, errors):
+    # 请求头每 --slow-interval 秒发一个字节, 模拟弱网或恶意慢速客户端
+    head = "GET {} HTTP/1.1\r\nHost: {}\r\n\r\n".format(args.path, args.host).encode()
+    while not stop.is_set():
+        try:
+            s = socket.create_connection((args.host, args.port), timeout=10)
+            for i in range(len(head)):
+                if stop.is_set():
+                    break
+                s.send(head[i:i + 1])
+                time.sleep(args.slow_interval)
+            s.close()
+        except OSError:
+            errors.append(1)
+            time.sleep(1)
+
+
+def window(args, name, concurrency, slow):
+    metrics(args, reset=True)
+    stop = threading.Event()
+    times = []
+    errors = []
+    threads = [threading.Thread(target=worker, args=(args, stop, times, errors)) for _ in range(concurrency)]
+    threads += [threading.Thread(target=slow_worker, args=(args, stop, errors)) for _ in range(slow)]
+    for t in threads:
+        t.daemon = True
+        t.start()
+    time.sleep(args.time)
+    stop.set()
+    for t in threads:
+        t.join(args.time)
+    values = metrics(args)
+
+    times.sort()
+    if times:
+        p50 = times[len(times) // 2]
+        p99 = times[min(len(times) - 1, len(times) * 99 // 100)]
+        client = "请求 {} 失败 {} p50 {:.0f}ms p99 {:.0f}ms max {:.0f}ms".format(len(times), len(errors), p50, p99, times[-1])
+    else:
+        client = "请求 0 失败 {}".format(len(errors))
+    print("[{}] 并发 {} 慢速 {} {}".format(name, concurrency, slow, client))
+    for key in KEYS:
+        print("    {:<30} {}".format(key, values.get(key, "-")))
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("host")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--path", default="/get_status")
+    parser.add_argument("-c", type=int, default=4, help="并发连接数")
+    parser.add_argument("--slow", type=int, default=0, help="慢速客户端数")
+    parser.add_argument("--slow-interval", type=float, default=0.5)
+    parser.add_argument("-t", "--time", type=float, default=30, help="每个窗口秒数")
+    parser.add_argument("--user")
+    parser.add_argument("--password", default="")
+    args = parser.parse_args()
+
+    window(args, "空载", 0, 0)
+    window(args, "并发", args.c, 0)
+    if args.slow:
+        window(args, "慢速", args.c, args.slow)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,235 @@
+# 局域网组播控制
+# 用法:
+#   python scripts/lanctl.py 密钥 listen                      监听组播 (设备信息/状态)
+#   python scripts/lanctl.py 密钥 discover                    发现设备
+#   python scripts/lanctl.py 密钥 cmd UID relay_1:ON [-n 20]  发送命令并统计往返时间 (命令只能单播, 先取设备会话)
+#   python scripts/lanctl.py 密钥 serve [UID]                 模拟一个继电器设备, 用于本机测试
+# 本机测试时加 --iface 127.0.0.1
+# 对比 MQTT: cmd ... --mqtt 10.0.0.25 --mqtt-cmnd 主题 --mqtt-stat 主题 (需要 paho-mqtt)
+
+import argparse
+import hashlib
+import hmac
+import random
+import socket
+import struct
+import threading
+import time
+
+GROUP = "239.255.42.10"
+PORT = 4210
+MAC_LEN = 8
+
+
+def sign(key, data):
+    return hmac.new(key, data, hashlib.sha256).hexdigest()[: MAC_LEN * 2].encode()
+
+
+def pack(key, type, src, dst, session, seq, payload):
+    head = "ESP1|{}|{}|{}|{:08x}:{}|{}|".format(type, src, dst, session, seq, payload).encode()
+    return head + sign(key, head)
+
+
+def unpack(key, data):
+    fields = data.split(b"|")
+    if len(fields) != 7 or fields[0] != b"ESP1":
+        return None
+    if not hmac.compare_digest(sign(key, data[: -len(fields[6])]), fields[6]):
+        return None
+    session, _, seq = fields[4].partition(b":")
+    return {
+        "type": fields[1].decode(),
+        "src": fields[2].decode(),
+        "dst": fields[3].decode(),
+        "session": int(session, 16),
+        "seq": int(seq or 0),
+        "payload": fields[5].decode("utf-8", "replace"),
+    }
+
+
+def open_socket(iface, join=True):
+    s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    s.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    if hasattr(socket, "SO_REUSEPORT"):
+        s.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEPORT, 1)
+    s.bind(("", PORT if join else 0))
+    if join:
+        mreq = struct.pack("4s4s", socket.inet_aton(GROUP), socket.inet_aton(iface))
+        s.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, mreq)
+    s.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_IF, socket.inet_aton(iface))
+    s.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_LOOP, 1)
+    s.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, 1)
+    return s
+
+
+def listen(args):
+    s = open_socket(args.iface)
+    while True:
+        data, addr = s.recvfrom(1024)
+        msg = unpack(args.key, data)
+        if msg is None:
+            print("{} <invalid>".format(addr[0]))
+        else:
+            print("{} {type} {src} -> {dst} #{session:08x}:{seq}: {payload}".format(addr[0], **msg))
+
+
+def discover(args):
+    s = open_socket(args.iface, False)
+    s.sendto(pack(args.key, "D", args.uid, "*", 0, 0, ""), (GROUP, PORT))
+    s.settimeout(args.timeout)
+    try:
+        while True:
+            data, addr = s.recvfrom(1024)
+            msg = unpack(args.key, data)
+            if msg and msg["type"] == "A":
+                print("{} {src}: {payload}".format(addr[0], **msg))
+    except socket.timeout:
+        pass
+
+
+def stats(name, times):
+    if not times:
+        print("{}: no reply".format(name))
+        return
+    times.sort()
+    print("{}: n={} min={:.1f}ms median={:.1f}ms p90={:.1f}ms max={:.1f}ms".format(
+        name, len(times), times[0], times[len(times) // 2], times[int(len(times) * 0.9)], times[-1]))
+
+
+def get_session(s, args):
+    # 单播发现请求, 设备回复中带当前会话
+    s.sendto(pack(args.key, "D", args.uid, args.dst, 0, 0, ""), (GROUP, PORT))
+    try:
+        while True:
+            data, addr = s.recvfrom(1024)
+            msg = unpack(args.key, data)
+            if msg and msg["type"] == "A" and msg["src"] == args.dst:
+                return msg["session"]
+    except socket.timeout:
+        return None
+
+
+def cmd(args):
+    if args.dst == "*":
+        print("cmd: 命令需要指定设备 UID")
+        return
+    s = open_socket(args.iface, False)
+    s.settimeout(args.timeout)
+    session = get_session(s, args)
+    if session is None:
+        print("LAN: no reply")
+        return
+    seq = 0
+    times = []
+    for i in range(args.n):
+        seq += 1
+        start = time.perf_counter()
+        s.sendto(pack(args.key, "C", args.uid, args.dst, session, seq, args.ops), (GROUP, PORT))
+        try:
+            while True:
+                data, addr = s.recvfrom(1024)
+                msg = unpack(args.key, data)
+                if not msg or msg["src"] != args.dst or msg["seq"] != seq:
+                    continue
+                if msg["type"] == "N":
+                    # 会话已更换或序号已用过, 按设备给出的会话和最后序号重发
+                    session, seq = msg["session"], int(msg["payload"]) + 1
+                    s.sendto(pack(args.key, "C", args.uid, args.dst, session, seq, args.ops), (GROUP, PORT))
+                elif msg["type"] == "R":
+                    session = msg["session"]
+                    times.append((time.perf_counter() - start) * 1000)
+                    if args.n == 1:
+                        print("{} {src}: {payload}".format(addr[0], **msg))
+                    break
+        except socket.timeout:
+            pass
+        time.sleep(args.interval)
+    stats("LAN", times)
+
+    if args.mqtt:
+        mqtt_rtt(args)
+
+
+def mqtt_rtt(args):
+    import paho.mqtt.client as mqtt
+
+    host, _, port = args.mqtt.partition(":")
+    got = threading.Event()
+    client = mqtt.Client()
+    client.on_message = lambda c, u, m: got.set()
+    client.connect(host, int(port or 1883))
+    client.subscribe(args.mqtt_stat)
+    client.loop_start()
+    time.sleep(0.5)
+    times = []
+    for i in range(args.n):
+        got.clear()
+        start = time.perf_counter()
+        client.publish(args.mqtt_cmnd, args.mqtt_payload)
+        if got.wait(args.timeout):
+            times.append((time.perf_counter() - start) * 1000)
+        time.sleep(args.interval)
+    client.loop_stop()
+    stats("MQTT", times)
+
+
+def serve(args):
+    # 模拟设备: 支持 relay_x:ON/OFF/TOGGLE
+    state = {}
+    last = {}
+    session = random.getrandbits(32) or 1
+    s = open_socket(args.iface)
+    print("serve {} on {}:{}".format(args.uid, GROUP, PORT))
+    while True:
+        data, addr = s.recvfrom(1024)
+        msg = unpack(args.key, data)
+        if msg is None or msg["src"] == args.uid or msg["dst"] not in ("*", args.uid):
+            continue
+        if msg["type"] == "D":
+            s.sendto(pack(args.key, "A", args.uid, msg["src"], session, msg["seq"], "relay,127.0.0.1,host"), addr)
+        elif msg["type"] == "C":
+            if msg["dst"] != args.uid:
+                continue
+            if msg["session"] != session or msg["seq"] <= last.get(msg["src"], 0):
+                prev = last.get(msg["src"], 0) if msg["session"] == session else 0
+                s.sendto(pack(args.key, "N", args.uid, msg["src"], session, msg["seq"], str(prev)), addr)
+                continue
+            if msg["src"] not in last and len(last) >= 8:
+                session = random.getrandbits(32) or 1  # 记录满, 更换会话
+                last = {}
+            else:
+                last[msg["src"]] = msg["seq"]
+            count = 0
+            for op in msg["payload"].split(","):
+                key, _, value = op.partition(":")
+                if key.startswith("relay_"):
+                    state[key] = 1 if value == "ON" else 0 if value == "OFF" else 1 - state.get(key, 0)
+                    count += 1
+            status = "{" + ",".join('"{}":{}'.format(k, v) for k, v in sorted(state.items())) + "}"
+            s.sendto(pack(args.key, "R", args.uid, msg["src"], session, msg["seq"], "{};0;{}".format(count, status)), addr)
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("key")
+    parser.add_argument("action", choices=["listen", "discover", "cmd", "serve"])
+    parser.add_argument("dst", nargs="?", default="*")
+    parser.add_argument("ops", nargs="?", default="")
+    parser.add_argument("--iface", default="0.0.0.0")
+    parser.add_argument("--uid", default="lanctl")
+    parser.add_argument("-n", type=int, default=1)
+    parser.add_argument("--interval", type=float, default=0.2)
+    parser.add_argument("--timeout", type=float, default=2)
+    parser.add_argument("--mqtt")
+    parser.add_argument("--mqtt-cmnd")
+    parser.add_argument("--mqtt-stat")
+    parser.add_argument("--mqtt-payload", default="TOGGLE")
+    args = parser.parse_args()
+    args.key = args.key.encode()
+    if args.action == "serve":
+        args.uid = args.dst if args.dst != "*" else "host_relay"
+    {"listen": listen, "discover": discover, "cmd": cmd, "serve": serve}[args.action](args)
+
+
+if __name__ == "__main__":
+    main()
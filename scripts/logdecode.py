@@ -0,0 +1,106 @@
+# 二进制日志解码
+# 用法: python scripts/logdecode.py output/relay.logstr [端口]
+# 在端口上接收设备发出的 UDP 日志, "BLOG" 开头的按字符串表还原, 其它按 syslog 文本输出
+
+import re
+import socket
+import struct
+import sys
+
+SPEC = re.compile(r"%[-+ #0]*\d*(?:\.\d+)?(hh|h|ll|l|z)?([diouxXcspfFeEgG%])")
+LEVELS = ["NONE", "ERROR", "INFO", "DEBUG", "MORE", "ALL"]
+
+
+def load_strings(file):
+    with open(file, "rb") as f:
+        data = f.read()
+    return struct.unpack_from("<I", data, 0)[0], data[4:]
+
+
+def get_format(strings, addr):
+    base, data = strings
+    offset = addr - base
+    if offset < 0 or offset >= len(data):
+        return None
+    return data[offset:data.index(b"\0", offset)].decode("utf-8", "replace")
+
+
+TRUNCATED = 0x80  # 与 Config.h BIN_LOG_TRUNCATED 一致
+
+
+def decode_record(strings, record):
+    level = record[1] & ~TRUNCATED
+    addr, = struct.unpack_from("<I", record, 2)
+    fmt = get_format(strings, addr)
+    if fmt is None:
+        return "[{}] <unknown 0x{:08x}>".format(LEVELS[level] if level < len(LEVELS) else level, addr)
+    pos = 6
+    args = []
+    for m in SPEC.finditer(fmt):
+        conv = m.group(2)
+        if conv == "%":
+            continue
+        if pos >= len(record):
+            args.append("?")
+        elif conv == "s":
+            n = record[pos]
+            args.append(record[pos + 1:pos + 1 + n].decode("utf-8", "replace"))
+            pos += 1 + n
+        else:
+            # 与 Debug.h binLogArg 一致: 浮点为 8 字节 double, ll 为 8 字节, 其它 4 字节
+            if conv in "fFeEgG":
+                code = "<d"
+            elif m.group(1) == "ll":
+                code = "<q" if conv in "di" else "<Q"
+            else:
+                code = "<i" if conv in "di" else "<I"
+            size = struct.calcsize(code)
+            if pos + size > len(record):
+                args.append("?")
+                pos = len(record)
+                continue
+            v, = struct.unpack_from(code, record, pos)
+            args.append(chr(v & 0xff) if conv == "c" else v)
+            pos += size
+    text = SPEC.sub(lambda m: "%" if m.group(2) == "%" else "{}", fmt.replace("{", "{{").replace("}", "}}"))
+    out = []
+    for m, a in zip([m for m in SPEC.finditer(fmt) if m.group(2) != "%"], args):
+        spec = m.group(0).replace("hh", "").replace("ll", "").replace("l", "").replace("h", "").replace("z", "")
+        try:
+            out.append(spec % a)
+        except (TypeError, ValueError):
+            out.append(str(a))
+    line = "[{}] {}".format(LEVELS[level] if level < len(LEVELS) else level, text.format(*out))
+    # 设备端放不下的参数没有写入, 显示为 ?
+    return line + " (truncated)" if record[1] & TRUNCATED else line
+
+
+def decode_packet(strings, data):
+    if data[:4] != b"BLOG":
+        return [data.decode("utf-8", "replace")]
+    n = data[4]
+    uid = data[5:5 + n].decode()
+    pos = 5 + n
+    lines = []
+    while pos < len(data):
+        size = data[pos]
+        if size < 6:
+            break
+        lines.append("{} {}".format(uid, decode_record(strings, bytearray(data[pos:pos + size]))))
+        pos += size
+    return lines
+
+
+def main():
+    strings = load_strings(sys.argv[1])
+    port = int(sys.argv[2]) if len(sys.argv) > 2 else 514
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("", port))
+    while True:
+        data, _ = sock.recvfrom(2048)
+        for line in decode_packet(strings, bytearray(data)):
+            print(line)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,44 @@
+Import('env')
+import os
+import re
+import sys
+
+# 编译前统计当前环境会注册的指标数, 超过 METRICS_MAX 直接报错, 避免运行时静默丢弃
+# 整个文件由 #ifdef USE_xxx 包住的只在对应环境计入
+
+def get_defines():
+    # pre 脚本运行时 build_flags 还没展开到 CPPDEFINES, 直接读项目配置
+    defines = set()
+    for d in env.get("CPPDEFINES", []):
+        defines.add(d[0] if isinstance(d, (list, tuple)) else str(d))
+    flags = env.GetProjectOption("build_flags", []) if hasattr(env, "GetProjectOption") else []
+    if isinstance(flags, str):
+        flags = [flags]
+    for flag in flags:
+        defines.update(re.findall(r"-D\s*(\w+)", flag))
+    return defines
+
+def count_metrics(src_dir, defines):
+    total = 0
+    for name in sorted(os.listdir(src_dir)):
+        if not name.endswith(".cpp"):
+            continue
+        with open(os.path.join(src_dir, name), encoding="utf-8") as f:
+            text = f.read()
+        m = re.match(r"\s*#ifdef\s+(USE_\w+)", text)
+        if m and m.group(1) not in defines:
+            continue
+        total += len(re.findall(r"\badd\(PSTR\(", text))
+    return total
+
+def get_max(include_dir):
+    with open(os.path.join(include_dir, "Metrics.h"), encoding="utf-8") as f:
+        return int(re.search(r"#define\s+METRICS_MAX\s+(\d+)", f.read()).group(1))
+
+project_dir = env.subst("$PROJECT_DIR")
+count = count_metrics(os.path.join(project_dir, "src"), get_defines())
+limit = get_max(os.path.join(project_dir, "include"))
+print("Metrics: {} / {}".format(count, limit))
+if count > limit:
+    sys.stderr.write("Error: {} metrics registered but METRICS_MAX is {}, raise it in include/Metrics.h\n".format(count, limit))
+    env.Exit(1)
@@ -1,9 +1,41 @@
 Import('env')
 import os
 import shutil
+import gzip
+import re
+import struct
+import zlib
 
 OUTPUT_DIR = "output{}".format(os.path.sep)
 
+def get_version():
+    with open(os.path.join(env.subst("$PROJECT_DIR"), "include", "Config.h")) as f:
+        m = re.search(r'#define\s+VERSION\s+"([^"]+)"', f.read())
+    return m.group(1) if m else ""
+
+def write_manifest(file, version):
+    # OTA 清单: <固件>.json, 设备据此跳过同版本、断点续传并校验 CRC32
+    with open(file, "rb") as f:
+        data = f.read()
+    with open(file + ".json", "w") as f:
+        f.write('{{"version":"{}","size":{},"crc32":"{:08x}"}}'.format(version, len(data), zlib.crc32(data) & 0xffffffff))
+
+def write_log_strings(elf_file, out_file):
+    # 二进制日志字符串表: [.irom0.text 起始地址 4字节][段内容], 供 scripts/logdecode.py 按地址取格式串
+    with open(elf_file, "rb") as f:
+        elf = f.read()
+    shoff, = struct.unpack_from("<I", elf, 0x20)
+    shentsize, shnum, shstrndx = struct.unpack_from("<HHH", elf, 0x2E)
+    sections = [struct.unpack_from("<IIIIIIIIII", elf, shoff + i * shentsize) for i in range(shnum)]
+    names = sections[shstrndx][4]
+    for sh in sections:
+        name = elf[names + sh[0]:elf.index(b"\0", names + sh[0])]
+        if name == b".irom0.text":
+            with open(out_file, "wb") as f:
+                f.write(struct.pack("<I", sh[3]))
+                f.write(elf[sh[4]:sh[4] + sh[5]])
+            return
+
 def bin_map_copy(source, target, env):
     variant = str(target[0]).split(os.path.sep)[2]
     #print(variant)
@@ -25,6 +57,21 @@ def bin_map_copy(source, target, env):
 
     # copy firmware.bin to firmware/<variant>.bin
     shutil.copy(str(target[0]), bin_file)
-    
+
+    # gzip 压缩固件, OTA 时由 eboot 边解压边写入
+    gz_file = bin_file + ".gz"
+    with open(bin_file, "rb") as f_in:
+        with gzip.GzipFile(gz_file, "wb", 9, mtime=0) as f_out:
+            shutil.copyfileobj(f_in, f_out)
+    print("{}: {} -> {} bytes".format(variant, os.path.getsize(bin_file), os.path.getsize(gz_file)))
+
+    version = get_version()
+    write_manifest(bin_file, version)
+    write_manifest(gz_file, version)
+
+    elf_file = str(target[0]).replace(".bin", ".elf")
+    if os.path.isfile(elf_file):
+        write_log_strings(elf_file, "{}{}{}.logstr".format(OUTPUT_DIR, os.path.sep, variant))
+
 
 env.AddPostAction("$BUILD_DIR/${PROGNAME}.bin", [bin_map_copy])
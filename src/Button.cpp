@@ -0,0 +1,134 @@
+#include "Button.h"
+#include "Metrics.h"
+
+ButtonState Button::buttons[BUTTON_MAX];
+uint8_t Button::count = 0;
+uint32_t Button::edgeCount = 0;
+uint32_t Button::eventCount = 0;
+uint32_t Button::latency = 0;
+
+void Button::init()
+{
+    Metrics::add(PSTR("esp_button_edge_total"), METRICS_COUNTER, &edgeCount);
+    Metrics::add(PSTR("esp_button_event_total"), METRICS_COUNTER, &eventCount);
+    Metrics::add(PSTR("esp_button_latency_us"), METRICS_GAUGE, &latency);
+}
+
+/**
+ * 注册按键, 低电平为按下
+ */
+bool Button::add(uint8_t pin, uint8_t mode, ButtonCallback callback, uint8_t arg)
+{
+    if (count >= BUTTON_MAX || pin > 16)
+    {
+        return false;
+    }
+    ButtonState *b = &buttons[count++];
+    memset(b, 0, sizeof(ButtonState));
+    b->pin = pin;
+    b->mode = mode;
+    b->arg = arg;
+    b->callback = callback;
+    b->poll = pin == 16;
+    pinMode(pin, b->poll ? INPUT : INPUT_PULLUP);
+    b->pressed = digitalRead(pin) == LOW;
+    b->raw = b->pressed;
+    b->changeTime = micros();
+    if (!b->poll)
+    {
+        attachInterruptArg(pin, isr, b, CHANGE);
+    }
+    return true;
+}
+
+void ICACHE_RAM_ATTR Button::isr(void *arg)
+{
+    ButtonState *b = (ButtonState *)arg;
+    uint32_t now = micros();
+    if (!b->dirty)
+    {
+        b->firstEdge = now;
+        b->dirty = true;
+    }
+    b->edgeTime = now;
+    edgeCount++;
+}
+
+void Button::emit(ButtonState *b, uint8_t event, uint8_t value)
+{
+    eventCount++;
+    if (b->callback)
+    {
+        b->callback(b->arg, event, value);
+    }
+}
+
+void Button::loop()
+{
+    for (uint8_t i = 0; i < count; i++)
+    {
+        ButtonState *b = &buttons[i];
+        if (b->poll)
+        {
+            bool level = digitalRead(b->pin) == LOW;
+            if (level != b->raw)
+            {
+                uint32_t now = micros();
+                b->raw = level;
+                if (!b->dirty)
+                {
+                    b->firstEdge = now;
+                    b->dirty = true;
+                }
+                b->edgeTime = now;
+            }
+        }
+
+        // 关中断取边沿时间后再取 now, 否则中断在两者之间到来时 now - edgeTime 会回绕成极大值
+        noInterrupts();
+        uint32_t firstEdge = b->firstEdge;
+        uint32_t now = micros();
+        // 最后一次边沿之后电平稳定 BUTTON_DEBOUNCE 才确认
+        bool stable = b->dirty && now - b->edgeTime >= BUTTON_DEBOUNCE;
+        if (stable)
+        {
+            // 先清标记再读电平, 之后的新边沿会在下次处理
+            b->dirty = false;
+        }
+        interrupts();
+
+        if (stable)
+        {
+            bool level = digitalRead(b->pin) == LOW;
+            if (level != b->pressed)
+            {
+                b->pressed = level;
+                b->changeTime = now;
+                latency = now - firstEdge;
+                if (b->mode == BUTTON_MODE_TOGGLE || level)
+                {
+                    b->count++;
+                }
+                if (!level)
+                {
+                    b->longFired = false;
+                }
+                emit(b, BUTTON_EVENT_CHANGE, level ? 1 : 0);
+            }
+        }
+
+        if (b->mode == BUTTON_MODE_PUSH && b->pressed && !b->longFired && now - b->changeTime >= BUTTON_LONG_PRESS)
+        {
+            b->longFired = true;
+            b->count = 0;
+            emit(b, BUTTON_EVENT_LONG, 1);
+        }
+
+        if (b->count > 0 && !b->dirty && now - b->changeTime >= BUTTON_CLICK_GAP && (b->mode == BUTTON_MODE_TOGGLE || !b->pressed))
+        {
+            uint8_t n = b->count;
+            b->count = 0;
+            emit(b, BUTTON_EVENT_CLICK, n);
+        }
+    }
+}
@@ -1,6 +1,7 @@
 
 #include "Config.h"
 #include "Debug.h"
+#include "Metrics.h"
 #include <EEPROM.h>
 #include <Ticker.h>
 
@@ -12,6 +13,8 @@ Ticker *tickerPerSecond;
 GlobalConfigMessage globalConfig;
 
 uint16_t Config::nowCrc;
+uint32_t Config::saveCount = 0;
+uint32_t Config::flashWriteCount = 0;
 
 const uint16_t crcTalbe[] = {
     0x0000, 0xCC01, 0xD801, 0x1400, 0xF001, 0x3C00, 0x2800, 0xE401,
@@ -71,6 +74,12 @@ void Config::resetConfig()
     module->resetConfig();
 }
 
+void Config::init()
+{
+    Metrics::add(PSTR("esp_config_save_total"), METRICS_COUNTER, &saveCount);
+    Metrics::add(PSTR("esp_config_flash_write_total"), METRICS_COUNTER, &flashWriteCount);
+}
+
 void Config::readConfig()
 {
     uint16 len;
@@ -103,6 +112,11 @@ void Config::readConfig()
             {
                 globalConfig.http.port = 80;
             }
+            // 旧版设置页面会把占位符当作密钥保存
+            if (strcmp(globalConfig.lan_key, "{lan_key}") == 0)
+            {
+                memset(globalConfig.lan_key, 0, sizeof(globalConfig.lan_key));
+            }
         }
     }
 
@@ -121,6 +135,7 @@ void Config::readConfig()
 
 boolean Config::saveConfig()
 {
+    saveCount++;
     module->saveConfig();
     uint8_t buffer[GlobalConfigMessage_size];
     pb_ostream_t stream = pb_ostream_from_buffer(buffer, sizeof(buffer));
@@ -159,6 +174,7 @@ boolean Config::saveConfig()
         EEPROM.write(i + 6, buffer[i]);
     }
     EEPROM.commit();
+    flashWriteCount++;
 
     Debug.AddLog(LOG_LEVEL_INFO, PSTR("saveConfig . . . OK Len: %d"), len);
     return true;
@@ -217,7 +233,7 @@ boolean Config::moduleSaveConfig(uint16_t version, uint16_t size, const pb_field
     return status;
 }
 
-const pb_field_t GlobalConfigMessage_fields[9] = {
+const pb_field_t GlobalConfigMessage_fields[11] = {
     PB_FIELD(1, MESSAGE, SINGULAR, STATIC, FIRST, GlobalConfigMessage, wifi, wifi, &WifiConfigMessage_fields),
     PB_FIELD(2, MESSAGE, SINGULAR, STATIC, OTHER, GlobalConfigMessage, http, wifi, &HttpConfigMessage_fields),
     PB_FIELD(3, MESSAGE, SINGULAR, STATIC, OTHER, GlobalConfigMessage, mqtt, http, &MqttConfigMessage_fields),
@@ -226,15 +242,18 @@ const pb_field_t GlobalConfigMessage_fields[9] = {
     PB_FIELD(6, UINT32, SINGULAR, STATIC, OTHER, GlobalConfigMessage, module_crc, cfg_version, 0),
     PB_FIELD(7, BYTES, SINGULAR, STATIC, OTHER, GlobalConfigMessage, module_cfg, module_crc, 0),
     PB_FIELD(8, STRING, SINGULAR, STATIC, OTHER, GlobalConfigMessage, uid, module_cfg, 0),
+    PB_FIELD(9, MESSAGE, SINGULAR, STATIC, OTHER, GlobalConfigMessage, schedule, uid, &ScheduleConfigMessage_fields),
+    PB_FIELD(10, STRING, SINGULAR, STATIC, OTHER, GlobalConfigMessage, lan_key, schedule, 0),
     PB_LAST_FIELD};
 
-const pb_field_t WifiConfigMessage_fields[7] = {
+const pb_field_t WifiConfigMessage_fields[8] = {
     PB_FIELD(1, STRING, SINGULAR, STATIC, FIRST, WifiConfigMessage, ssid, ssid, 0),
     PB_FIELD(2, STRING, SINGULAR, STATIC, OTHER, WifiConfigMessage, pass, ssid, 0),
     PB_FIELD(3, BOOL, SINGULAR, STATIC, OTHER, WifiConfigMessage, is_static, pass, 0),
     PB_FIELD(4, STRING, SINGULAR, STATIC, OTHER, WifiConfigMessage, ip, is_static, 0),
     PB_FIELD(5, STRING, SINGULAR, STATIC, OTHER, WifiConfigMessage, sn, ip, 0),
     PB_FIELD(6, STRING, SINGULAR, STATIC, OTHER, WifiConfigMessage, gw, sn, 0),
+    PB_FIELD(7, BYTES, SINGULAR, STATIC, OTHER, WifiConfigMessage, cache, gw, 0),
     PB_LAST_FIELD};
 
 const pb_field_t HttpConfigMessage_fields[5] = {
@@ -255,8 +274,18 @@ const pb_field_t MqttConfigMessage_fields[9] = {
     PB_FIELD(8, STRING, SINGULAR, STATIC, OTHER, MqttConfigMessage, discovery_prefix, discovery, 0),
     PB_LAST_FIELD};
 
-const pb_field_t DebugConfigMessage_fields[4] = {
+const pb_field_t DebugConfigMessage_fields[8] = {
     PB_FIELD(1, UINT32, SINGULAR, STATIC, FIRST, DebugConfigMessage, type, type, 0),
     PB_FIELD(2, STRING, SINGULAR, STATIC, OTHER, DebugConfigMessage, server, type, 0),
     PB_FIELD(3, UINT32, SINGULAR, STATIC, OTHER, DebugConfigMessage, port, server, 0),
-    PB_LAST_FIELD};
\ No newline at end of file
+    PB_FIELD(4, UINT32, SINGULAR, STATIC, OTHER, DebugConfigMessage, serial_level, port, 0),
+    PB_FIELD(5, UINT32, SINGULAR, STATIC, OTHER, DebugConfigMessage, serial1_level, serial_level, 0),
+    PB_FIELD(6, UINT32, SINGULAR, STATIC, OTHER, DebugConfigMessage, web_level, serial1_level, 0),
+    PB_FIELD(7, UINT32, SINGULAR, STATIC, OTHER, DebugConfigMessage, syslog_level, web_level, 0),
+    PB_LAST_FIELD};
+
+const pb_field_t ScheduleConfigMessage_fields[4] = {
+    PB_FIELD(1, FIXED32, REPEATED, STATIC, FIRST, ScheduleConfigMessage, entry, entry, 0),
+    PB_FIELD(2, SINT32, SINGULAR, STATIC, OTHER, ScheduleConfigMessage, latitude, entry, 0),
+    PB_FIELD(3, SINT32, SINGULAR, STATIC, OTHER, ScheduleConfigMessage, longitude, latitude, 0),
+    PB_LAST_FIELD};
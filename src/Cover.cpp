@@ -3,9 +3,13 @@
 #include <DOOYACommand.h>
 #include "Debug.h"
 #include "Led.h"
+#include "Button.h"
 #include "Cover.h"
 #include "Mqtt.h"
 #include "Wifi.h"
+#include "Http.h"
+#include "Metrics.h"
+#include "Lan.h"
 
 #pragma region 继承
 
@@ -21,10 +25,12 @@ void Cover::init()
     }
     softwareSerial = new SoftwareSerial(config.pin_rx, config.pin_tx); // RX, TX
     softwareSerial->begin(9600);
+    Metrics::add(PSTR("esp_dooya_frame_error_total"), METRICS_COUNTER, &frameError);
     if (config.pin_led != 99)
     {
         Led::init(config.pin_led > 30 ? config.pin_led - 30 : config.pin_led, config.pin_led > 30 ? HIGH : LOW);
     }
+    Button::add(config.pin_btn, BUTTON_MODE_PUSH, buttonCallback);
 }
 
 String Cover::getModuleName()
@@ -45,7 +51,6 @@ bool Cover::moduleLed()
 void Cover::loop()
 {
     readSoftwareSerialTick();
-    checkButton();
 }
 
 void Cover::perSecondDo()
@@ -56,47 +61,16 @@ void Cover::perSecondDo()
     }
 }
 
-void Cover::checkButton()
+void Cover::buttonCallback(uint8_t arg, uint8_t event, uint8_t count)
 {
-    boolean buttonState = digitalRead(config.pin_btn);
-
-    if (buttonState == 0)
-    { // 按下按钮
-        if (buttonTiming == false)
-        {
-            buttonTiming = true;
-            buttonTimingStart = millis();
-        }
-        else
-        { // buttonTiming = true
-            if (millis() >= (buttonTimingStart + buttonDebounceTime))
-            {
-                buttonAction = 1;
-            }
-
-            if (millis() >= (buttonTimingStart + buttonLongPressTime))
-            {
-                buttonAction = 2;
-            }
-        }
+    if (event == BUTTON_EVENT_CLICK) // 执行短按动作
+    {
+        Debug.AddLog(LOG_LEVEL_INFO, PSTR("buttonShortPressAction %d"), count);
     }
-    else
-    { // buttonState == 1, 释放按钮
-        buttonTiming = false;
-
-        if (buttonAction != 0)
-        {
-            if (buttonAction == 1) // 执行短按动作
-            {
-                Debug.AddLog(LOG_LEVEL_INFO, PSTR("buttonShortPressAction"));
-            }
-            else if (buttonAction == 2) // 执行长按动作
-            {
-                Debug.AddLog(LOG_LEVEL_INFO, PSTR("buttonLongPressAction"));
-                Wifi::setupWifiManager(false);
-            }
-            buttonAction = 0;
-        }
+    else if (event == BUTTON_EVENT_LONG) // 执行长按动作
+    {
+        Debug.AddLog(LOG_LEVEL_INFO, PSTR("buttonLongPressAction"));
+        Wifi::setupWifiManager(false);
     }
 }
 #pragma endregion
@@ -267,7 +241,7 @@ void Cover::mqttConnected()
 
 #pragma region HTTP
 
-void Cover::httpAdd(ESP8266WebServer *server)
+void Cover::httpAdd(HttpServer *server)
 {
     server->on(F("/cover_position"), std::bind(&Cover::httpPosition, this, server));
     server->on(F("/cover_set"), std::bind(&Cover::httpDo, this, server));
@@ -275,14 +249,14 @@ void Cover::httpAdd(ESP8266WebServer *server)
     server->on(F("/cover_reset"), std::bind(&Cover::httpReset, this, server));
 }
 
-String Cover::httpGetStatus(ESP8266WebServer *server)
+String Cover::httpGetStatus(HttpServer *server)
 {
     String data = F("\"cover_position\":");
     data += config.position;
     return data;
 }
 
-void Cover::httpHtml(ESP8266WebServer *server)
+void Cover::httpHtml(HttpServer *server)
 {
     String radioJs = F("<script type='text/javascript'>");
     radioJs += F("var iscover=0;function setDataSub(data,key){if(key=='cover_position'){var t=id(key);var v=data[key];if(iscover>0&&v==t.value&&iscover++>5){iscover=0;intervalTime=defIntervalTime}t.value=v;t.nextSibling.nextSibling.innerHTML=v+'%';id('cover_open').disabled=v==100;id('cover_close').disabled=v==0;return true}return false}");
@@ -349,7 +323,7 @@ uint8_t Cover::getInt(String str, uint8_t min, uint8_t max)
     return n;
 }
 
-void Cover::httpPosition(ESP8266WebServer *server)
+void Cover::httpPosition(HttpServer *server)
 {
     String position = server->arg(F("position"));
     uint8_t n = getInt(position, 0, 100);
@@ -361,7 +335,7 @@ void Cover::httpPosition(ESP8266WebServer *server)
     server->send(200, F("text/html"), "{\"code\":1,\"msg\":\"已设置窗帘位置。\",\"data\":{\"position\":" + position + "}}");
 }
 
-void Cover::httpDo(ESP8266WebServer *server)
+void Cover::httpDo(HttpServer *server)
 {
     String str = server->arg(F("do"));
     uint8_t tmp[10];
@@ -391,7 +365,55 @@ void Cover::httpDo(ESP8266WebServer *server)
     server->send(200, F("text/html"), F("{\"code\":1,\"msg\":\"已执行窗帘操作。\"}"));
 }
 
-void Cover::httpSetting(ESP8266WebServer *server)
+boolean Cover::batchCommand(String key, String value)
+{
+    if (key.equals(F("cover_position")))
+    {
+        batchLen = DOOYACommand::setPosition(batchCmd, 0xFEFE, 0, getInt(value, 0, 100));
+        getPositionState = true;
+    }
+    else if (key.equals(F("cover")) && value.equals(F("OPEN")))
+    {
+        batchLen = DOOYACommand::open(batchCmd, 0xFEFE, 0);
+        getPositionState = true;
+    }
+    else if (key.equals(F("cover")) && value.equals(F("CLOSE")))
+    {
+        batchLen = DOOYACommand::close(batchCmd, 0xFEFE, 0);
+        getPositionState = true;
+    }
+    else if (key.equals(F("cover")) && value.equals(F("STOP")))
+    {
+        batchLen = DOOYACommand::stop(batchCmd, 0xFEFE, 0);
+        getPositionState = false;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+void Cover::batchCommit()
+{
+    // 电机只执行最后一条指令
+    if (batchLen > 0)
+    {
+        softwareSerial->write(batchCmd, batchLen);
+        batchLen = 0;
+    }
+}
+
+void Cover::scheduleDo(uint8_t target, uint8_t value)
+{
+    // 窗帘只有一个电机, value 为目标位置
+    uint8_t tmp[10];
+    uint8_t len = DOOYACommand::setPosition(tmp, 0xFEFE, 0, value > 100 ? 100 : value);
+    softwareSerial->write(tmp, len);
+    getPositionState = true;
+}
+
+void Cover::httpSetting(HttpServer *server)
 {
     uint8_t tmp[10];
     int len;
@@ -431,25 +453,20 @@ void Cover::httpSetting(ESP8266WebServer *server)
     server->send(200, F("text/html"), F("{\"code\":1,\"msg\":\"已经设置。\"}"));
 }
 
-void Cover::httpReset(ESP8266WebServer *server)
+void Cover::httpReset(HttpServer *server)
 {
     server->send(200, F("text/html"), F("{\"code\":1,\"msg\":\"正在重置电机 . . . 设备将会重启。\"}"));
-    delay(200);
-
-    Led::blinkLED(400, 4);
 
     uint8_t tmp[10];
-    int len;
-    DOOYACommand::reset(tmp, 0xFEFE, 0);
+    int len = DOOYACommand::reset(tmp, 0xFEFE, 0);
     softwareSerial->write(tmp, len);
-    delay(100);
     config.position = 127;
     config.direction = 127;
     config.hand_pull = 127;
     config.weak_switch = 127;
     config.power_switch = 127;
     Config::saveConfig();
-    ESP.restart();
+    Http::restart();
 }
 #pragma endregion
 
@@ -492,6 +509,7 @@ void Cover::doPosition(uint8_t position, uint8_t command)
     else if (config.position != position)
     {
         config.position = position;
+        Lan::stateChanged();
         if (mqtt)
         {
             String topic = mqtt->getStatTopic(F("position"));
@@ -504,9 +522,12 @@ void Cover::doSoftwareSerialTick(uint8_t *buf, int len)
 {
     DOOYACommand::Command command = DOOYACommand::parserReplyCommand(buf, len);
 
-    char strHex[50];
-    DOOYACommand::hex2Str(buf, len, strHex, true);
-    Debug.AddLog(LOG_LEVEL_INFO, PSTR("%s: %s"), (command.command == 0x01 ? "Read" : (command.command == 0x02 ? "Write" : (command.command == 0x03 ? "Control" : (command.command == 0x04 ? "Request" : "??")))), strHex);
+    if (Debug.checkLevel(LOG_LEVEL_DEBUG))
+    {
+        char strHex[50];
+        DOOYACommand::hex2Str(buf, len, strHex, true);
+        Debug.AddLog(LOG_LEVEL_DEBUG, PSTR("%s: %s"), (command.command == 0x01 ? "Read" : (command.command == 0x02 ? "Write" : (command.command == 0x03 ? "Control" : (command.command == 0x04 ? "Request" : "??")))), strHex);
+    }
 
     if (command.command == 0x01)
     {
@@ -592,13 +613,23 @@ void Cover::doSoftwareSerialTick(uint8_t *buf, int len)
  */
 void Cover::readSoftwareSerialTick()
 {
+    // 逐字节输出仅在串口日志为最详细级别时打开
+    bool isSerialDump = (1 & globalConfig.debug.type) && Debug.sinkLevel(globalConfig.debug.serial_level) >= LOG_LEVEL_DEBUG_MORE && LOG_LEVEL_DEBUG_MORE <= LOG_LEVEL_COMPILE;
     while (softwareSerial->available())
     {
         uint8_t c = softwareSerial->read();
-        Serial.printf("%02X ", c);
+        if (isSerialDump)
+        {
+            char hex[4];
+            sprintf(hex, "%02X ", c);
+            Debug.serialTx.write(hex, 3);
+        }
         if (softwareSerialPos == 0 && c != 0x55)
         { // 第一个字节不是0x55 抛弃
-            Serial.print(F("\nBuff NO 0x55\n"));
+            if (isSerialDump)
+            {
+                Debug.serialTx.write("\nBuff NO 0x55\n", 14);
+            }
             continue;
         }
         if (softwareSerialPos == 0)
@@ -609,7 +640,10 @@ void Cover::readSoftwareSerialTick()
 
         if (softwareSerialPos >= 6 && softwareSerialBuff[softwareSerialPos - 1] * 256 + softwareSerialBuff[softwareSerialPos - 2] == DOOYACommand::crc16(softwareSerialBuff, softwareSerialPos - 2)) // crc 正确
         {
-            Serial.println();
+            if (isSerialDump)
+            {
+                Debug.serialTx.write("\r\n", 2);
+            }
             softwareSerialBuff[softwareSerialPos] = 0x00;
             doSoftwareSerialTick(softwareSerialBuff, softwareSerialPos);
             Led::led(200);
@@ -619,12 +653,14 @@ void Cover::readSoftwareSerialTick()
         {
             Debug.AddLog(LOG_LEVEL_INFO, PSTR("\nBuff Len Error"));
             softwareSerialPos = 0;
+            frameError++;
         }
     }
 
     if (softwareSerialPos > 0 && (millis() - softwareSerialTime >= 100))
     { // 距离0x55 超过100ms则抛弃指令
         softwareSerialPos = 0;
+        frameError++;
     }
 }
 
@@ -0,0 +1,152 @@
+#include "Crash.h"
+#include "Debug.h"
+#include "Mqtt.h"
+#include <user_interface.h>
+
+CrashRecord Crash::record;
+bool Crash::hasRecord = false;
+bool Crash::isReport = false;
+
+extern "C" void custom_crash_callback(struct rst_info *rst_info, uint32_t stack, uint32_t stack_end)
+{
+    Crash::save(rst_info->reason, rst_info->exccause, rst_info->epc1, rst_info->epc2, rst_info->epc3, rst_info->excvaddr, rst_info->depc, stack, stack_end);
+}
+
+void Crash::save(uint32_t reason, uint32_t exccause, uint32_t epc1, uint32_t epc2, uint32_t epc3, uint32_t excvaddr, uint32_t depc, uint32_t stack, uint32_t stack_end)
+{
+    memset(&record, 0, sizeof(record));
+    record.magic = CRASH_MAGIC;
+    record.reason = reason;
+    record.exccause = exccause;
+    record.epc1 = epc1;
+    record.epc2 = epc2;
+    record.epc3 = epc3;
+    record.excvaddr = excvaddr;
+    record.depc = depc;
+    record.perSecond = perSecond;
+    record.heap = ESP.getFreeHeap();
+    for (uint8_t i = 0; i < CRASH_STACK && stack + i * 4 < stack_end; i++)
+    {
+        record.stack[i] = *(uint32_t *)(stack + i * 4);
+    }
+
+    // 从最新一行往前取日志，直到放不下
+    uint16_t pos = CRASH_LOG_SIZE - 1;
+    uint8_t idx = Debug.webLogIndex;
+    for (uint8_t n = 0; n < WEB_LOG_LINES; n++)
+    {
+        if (!--idx)
+        {
+            idx--;
+        }
+        char *line;
+        uint16_t len;
+        Debug.GetLog(idx, &line, &len);
+        if (len == 0 || len + 1 > pos)
+        {
+            break;
+        }
+        pos -= len + 1;
+        memcpy(record.log + pos, line, len);
+        record.log[pos + len] = '\n';
+    }
+    memmove(record.log, record.log + pos, CRASH_LOG_SIZE - 1 - pos);
+    record.log[CRASH_LOG_SIZE - 1 - pos] = '\0';
+
+    ESP.rtcUserMemoryWrite(RTC_CRASH_OFFSET, (uint32_t *)&record, sizeof(record));
+}
+
+/**
+ * 启动时读取上次的崩溃记录，看门狗复位不会进入 crash 回调，用复位信息补上
+ */
+void Crash::init()
+{
+    struct rst_info *info = ESP.getResetInfoPtr();
+    ESP.rtcUserMemoryRead(RTC_CRASH_OFFSET, (uint32_t *)&record, sizeof(record));
+    if (record.magic == CRASH_MAGIC && (info->reason == REASON_EXCEPTION_RST || info->reason == REASON_SOFT_WDT_RST))
+    {
+        hasRecord = true;
+    }
+    else if (info->reason == REASON_WDT_RST || info->reason == REASON_EXCEPTION_RST || info->reason == REASON_SOFT_WDT_RST)
+    {
+        memset(&record, 0, sizeof(record));
+        record.reason = info->reason;
+        record.exccause = info->exccause;
+        record.epc1 = info->epc1;
+        record.epc2 = info->epc2;
+        record.epc3 = info->epc3;
+        record.excvaddr = info->excvaddr;
+        record.depc = info->depc;
+        hasRecord = true;
+    }
+
+    // 清除，避免下次正常重启时重复上报
+    uint32_t magic = 0;
+    ESP.rtcUserMemoryWrite(RTC_CRASH_OFFSET, &magic, sizeof(magic));
+    if (hasRecord)
+    {
+        Debug.AddLog(LOG_LEVEL_ERROR, PSTR("Crash reason: %d exccause: %d epc1: 0x%08x"), record.reason, record.exccause, record.epc1);
+    }
+}
+
+String Crash::toJson()
+{
+    if (!hasRecord)
+    {
+        return F("{}");
+    }
+    char buf[32];
+    String json = F("{\"reason\":");
+    json += record.reason;
+    json += F(",\"exccause\":");
+    json += record.exccause;
+    snprintf_P(buf, sizeof(buf), PSTR(",\"epc1\":\"0x%08x\""), record.epc1);
+    json += buf;
+    snprintf_P(buf, sizeof(buf), PSTR(",\"epc2\":\"0x%08x\""), record.epc2);
+    json += buf;
+    snprintf_P(buf, sizeof(buf), PSTR(",\"epc3\":\"0x%08x\""), record.epc3);
+    json += buf;
+    snprintf_P(buf, sizeof(buf), PSTR(",\"excvaddr\":\"0x%08x\""), record.excvaddr);
+    json += buf;
+    snprintf_P(buf, sizeof(buf), PSTR(",\"depc\":\"0x%08x\""), record.depc);
+    json += buf;
+    json += F(",\"uptime\":");
+    json += record.perSecond;
+    json += F(",\"heap\":");
+    json += record.heap;
+    json += F(",\"stack\":[");
+    for (uint8_t i = 0; i < CRASH_STACK; i++)
+    {
+        snprintf_P(buf, sizeof(buf), PSTR("%s\"%08x\""), i ? "," : "", record.stack[i]);
+        json += buf;
+    }
+    json += F("],\"log\":\"");
+    for (uint8_t i = 0; i < CRASH_LOG_SIZE && record.log[i] != '\0'; i++)
+    {
+        char c = record.log[i];
+        if (c == '\\' || c == '"')
+        {
+            json += '\\';
+            json += c;
+        }
+        else if (c == '\n')
+        {
+            json += F("\\n");
+        }
+        else if (c >= 0x20)
+        {
+            json += c;
+        }
+    }
+    json += F("\"}");
+    return json;
+}
+
+void Crash::mqttConnected()
+{
+    if (!hasRecord || isReport)
+    {
+        return;
+    }
+    isReport = mqtt->publish(mqtt->getTeleTopic(F("CRASH")), toJson().c_str(), false);
+}
@@ -2,112 +2,301 @@
 #include "Config.h"
 #include "Debug.h"
 #include "Ntp.h"
+#include "Metrics.h"
 #include <ESP8266WiFi.h>
 #include <WiFiUdp.h>
+#include <algorithm>
 
 WiFiUDP Udp;
-size_t DebugClass::strchrspn(const char *str1, int character)
+
+void SerialRing::put(const char *data, size_t len)
+{
+    size_t first = std::min(len, (size_t)(SERIAL_LOG_SIZE - head));
+    memcpy(buf + head, data, first);
+    memcpy(buf, data + first, len - first);
+    head = (head + len) % SERIAL_LOG_SIZE;
+}
+
+bool SerialRing::write(const char *data, size_t len)
+{
+    if (len > (tail + SERIAL_LOG_SIZE - head - 1) % SERIAL_LOG_SIZE)
+    {
+        drop++;
+        return false;
+    }
+    put(data, len);
+    loop();
+    return true;
+}
+
+bool SerialRing::writeLine(const char *data1, const char *data2)
 {
-    size_t ret = 0;
-    char *start = (char *)str1;
-    char *end = strchr(str1, character);
-    if (end)
-        ret = end - start;
-    return ret;
+    size_t len1 = strlen(data1);
+    size_t len2 = strlen(data2);
+    if (len1 + len2 + 2 > (tail + SERIAL_LOG_SIZE - head - 1) % SERIAL_LOG_SIZE)
+    {
+        drop++;
+        return false;
+    }
+    put(data1, len1);
+    put(data2, len2);
+    put("\r\n", 2);
+    loop();
+    return true;
 }
 
+void SerialRing::loop()
+{
+    size_t n = port->availableForWrite();
+    while (n > 0 && tail != head)
+    {
+        size_t len = std::min(n, (size_t)((head > tail ? head : SERIAL_LOG_SIZE) - tail));
+        port->write((const uint8_t *)buf + tail, len);
+        tail = (tail + len) % SERIAL_LOG_SIZE;
+        n -= len;
+    }
+}
+
+void SerialRing::flush()
+{
+    uint32_t start = millis();
+    while (tail != head && millis() - start < 200) // 串口未初始化时不会写出，最多等 200ms
+    {
+        loop();
+        yield();
+    }
+}
 void DebugClass::GetLog(uint8_t idx, char **entry_pp, uint16_t *len_p)
 {
-    char *entry_p = NULL;
-    size_t len = 0;
+    WebLogLine *line = &webLogLines[idx % WEB_LOG_LINES];
+    if (idx && line->idx == idx)
+    {
+        *entry_pp = webLog + line->pos;
+        *len_p = line->len;
+    }
+    else
+    {
+        *entry_pp = NULL;
+        *len_p = 0;
+    }
+}
 
-    if (idx)
+void DebugClass::webLogEvict()
+{
+    WebLogLine *line = &webLogLines[webLogOldest % WEB_LOG_LINES];
+    line->idx = 0;
+    Metrics::webLogDrop++;
+    if (--webLogCount == 0)
     {
-        char *it = webLog;
-        do
+        webLogHead = webLogTail = 0;
+        return;
+    }
+    if (!++webLogOldest)
+    {
+        webLogOldest++;
+    }
+    webLogTail = webLogLines[webLogOldest % WEB_LOG_LINES].pos;
+}
+
+void DebugClass::webLogAdd(const char *mxtime)
+{
+    uint16_t timeLen = strlen(mxtime);
+    uint16_t len = timeLen + strlen(tmpData);
+    if (len > sizeof(tmpData) / 2 - 1) // 输出时需要转义，最长为 tmpData 的一半
+    {
+        len = sizeof(tmpData) / 2 - 1;
+    }
+
+    // 序号对应的槽位被占用时，或者空间不足时，淘汰最旧的行
+    while (webLogLines[webLogIndex % WEB_LOG_LINES].idx != 0)
+    {
+        webLogEvict();
+    }
+    uint16_t pos;
+    while (true)
+    {
+        if (webLogCount == 0)
         {
-            uint8_t cur_idx = *it;
-            it++;
-            size_t tmp = strchrspn(it, '\1');
-            tmp++; // Skip terminating '\1'
-            if (cur_idx == idx)
-            { // Found the requested entry
-                len = tmp;
-                entry_p = it;
+            pos = 0;
+            break;
+        }
+        if (webLogHead > webLogTail)
+        {
+            if (WEB_LOG_SIZE - webLogHead >= len)
+            {
+                pos = webLogHead;
+                break;
+            }
+            if (webLogTail >= len)
+            {
+                pos = 0;
                 break;
             }
-            it += tmp;
-        } while (it < webLog + WEB_LOG_SIZE && *it != '\0');
+        }
+        else if (webLogTail - webLogHead >= len)
+        {
+            pos = webLogHead;
+            break;
+        }
+        webLogEvict();
+    }
+
+    memcpy(webLog + pos, mxtime, timeLen);
+    memcpy(webLog + pos + timeLen, tmpData, len - timeLen);
+    if (webLogCount++ == 0)
+    {
+        webLogOldest = webLogIndex;
+        webLogTail = pos;
+    }
+    webLogHead = pos + len;
+
+    WebLogLine *line = &webLogLines[webLogIndex % WEB_LOG_LINES];
+    line->idx = webLogIndex;
+    line->pos = pos;
+    line->len = len;
+    if (!++webLogIndex)
+    {
+        webLogIndex++; // Index 0 is not allowed
     }
-    *entry_pp = entry_p;
-    *len_p = len;
 }
 
-void DebugClass::Syslog()
+/**
+ * 需要时(重新)解析 syslog 服务器，只在 loop 中解析，AddLog 中不解析
+ * 成功后每 SYSLOG_DNS_TTL 重新解析，失败后每 SYSLOG_DNS_RETRY 重试
+ */
+bool DebugClass::getServer(bool resolve)
 {
-    if ((2 & globalConfig.debug.type) != 2 || WiFi.status() != WL_CONNECTED || globalConfig.debug.server[0] == '\0' || globalConfig.debug.port == 0)
+    if (WiFi.status() != WL_CONNECTED || globalConfig.debug.server[0] == '\0' || globalConfig.debug.port == 0)
+    {
+        return false;
+    }
+    if (resolve && (ipResolve || millis() - ipTime >= (ip.isSet() ? SYSLOG_DNS_TTL : SYSLOG_DNS_RETRY)))
+    {
+        // 重新解析失败时继续用旧地址
+        IPAddress resolved;
+        if (WiFi.hostByName(globalConfig.debug.server, resolved))
+        {
+            ip = resolved;
+        }
+        ipTime = millis();
+        ipResolve = false;
+    }
+    return ip.isSet();
+}
+
+void DebugClass::Syslog(uint8_t loglevel)
+{
+    if ((2 & globalConfig.debug.type) != 2)
     {
         return;
     }
 
-    if (!ip)
+    // <PRI>1 TIMESTAMP HOSTNAME APP PROCID MSGID SD MSG, local0
+    char header[48];
+    int len = snprintf_P(header, sizeof(header), PSTR("<%d>1 - %s esp - - - "), 16 * 8 + (loglevel <= LOG_LEVEL_ERROR ? 3 : (loglevel == LOG_LEVEL_INFO ? 6 : 7)), UID);
+    int msgLen = strlen(tmpData);
+    if (len + msgLen + 6 > SYSLOG_SIZE) // 前缀最长 "1400 "
     {
-        WiFi.hostByName(globalConfig.debug.server, ip);
+        msgLen = SYSLOG_SIZE - len - 6;
     }
-    if (Udp.beginPacket(ip, globalConfig.debug.port))
+    char prefix[8];
+    int prefixLen = snprintf_P(prefix, sizeof(prefix), PSTR("%d "), len + msgLen);
+    if (syslogLen + prefixLen + len + msgLen > SYSLOG_SIZE)
     {
-        char syslog_preamble[64]; // Hostname + Id
+        syslogFlush(false);
+        if (syslogLen + prefixLen + len + msgLen > SYSLOG_SIZE)
+        {
+            return; // 服务器还不可用, 保留已缓存的行, 丢弃新行
+        }
+    }
+    if (syslogLen == 0)
+    {
+        syslogTime = millis();
+    }
+    memcpy(syslogBuf + syslogLen, prefix, prefixLen);
+    memcpy(syslogBuf + syslogLen + prefixLen, header, len);
+    memcpy(syslogBuf + syslogLen + prefixLen + len, tmpData, msgLen);
+    syslogLen += prefixLen + len + msgLen;
+    // 不合并时已解析到服务器就立即发送, 否则留给 loop 解析后发送
+    if ((32 & globalConfig.debug.type) != 32 && ip.isSet())
+    {
+        syslogFlush(false);
+    }
+}
 
-        snprintf_P(syslog_preamble, sizeof(syslog_preamble), PSTR("%s "), UID);
-        memmove(tmpData + strlen(syslog_preamble), tmpData, sizeof(tmpData) - strlen(syslog_preamble));
-        tmpData[sizeof(tmpData) - 1] = '\0';
-        memcpy(tmpData, syslog_preamble, strlen(syslog_preamble));
-        Udp.write(tmpData, strlen(tmpData));
-        Udp.endPacket();
-        delay(1); // Add time for UDP handling (#5512)
+/**
+ * 服务器不可用时保留缓冲, 由 loop 解析成功后再发送
+ */
+void DebugClass::syslogFlush(bool resolve)
+{
+    if (syslogLen == 0 || !getServer(resolve))
+    {
+        return;
     }
+    if ((32 & globalConfig.debug.type) == 32)
+    {
+        if (Udp.beginPacket(ip, globalConfig.debug.port))
+        {
+            Udp.write(syslogBuf, syslogLen);
+            Udp.endPacket();
+        }
+    }
+    else
+    {
+        uint16_t pos = 0;
+        while (pos < syslogLen)
+        {
+            uint16_t msgLen = atoi(syslogBuf + pos);
+            pos = (char *)memchr(syslogBuf + pos, ' ', syslogLen - pos) - syslogBuf + 1;
+            if (Udp.beginPacket(ip, globalConfig.debug.port))
+            {
+                Udp.write(syslogBuf + pos, msgLen);
+                Udp.endPacket();
+            }
+            pos += msgLen;
+        }
+    }
+    syslogLen = 0;
 }
 
 void DebugClass::AddLog(uint8_t loglevel)
 {
-    char mxtime[10]; // "13:45:21 "
-    snprintf_P(mxtime, sizeof(mxtime), PSTR("%02d:%02d:%02d "), Ntp::rtcTime.hour, Ntp::rtcTime.minute, Ntp::rtcTime.second);
+    char mxtime[14]; // "13:45:21.123 "
+    uint64_t nowMs = Ntp::nowMs();
+    if (nowMs > 0)
+    {
+        // 时分秒与毫秒取自同一时刻, 避免秒跳变时两者不一致
+        uint32_t sec = (nowMs / 1000) % 86400;
+        snprintf_P(mxtime, sizeof(mxtime), PSTR("%02d:%02d:%02d.%03d "), sec / 3600, (sec / 60) % 60, sec % 60, (uint16_t)(nowMs % 1000));
+    }
+    else
+    {
+        snprintf_P(mxtime, sizeof(mxtime), PSTR("%02d:%02d:%02d.%03d "), Ntp::rtcTime.hour, Ntp::rtcTime.minute, Ntp::rtcTime.second, Ntp::millisecond());
+    }
+    textCount++;
+    textBytes += strlen(mxtime) + strlen(tmpData);
 
-    if ((1 & globalConfig.debug.type) == 1)
+    if ((1 & globalConfig.debug.type) == 1 && loglevel <= sinkLevel(globalConfig.debug.serial_level))
     {
-        Serial.printf("%s%s\r\n", mxtime, tmpData);
+        serialTx.writeLine(mxtime, tmpData);
     }
-    if ((8 & globalConfig.debug.type) == 8)
+    if ((8 & globalConfig.debug.type) == 8 && loglevel <= sinkLevel(globalConfig.debug.serial1_level))
     {
-        Serial1.printf("%s%s\r\n", mxtime, tmpData);
+        serial1Tx.writeLine(mxtime, tmpData);
     }
 
-    //if (Settings.webserver && (loglevel <= Settings.weblog_level))
-    //{
-    // Delimited, zero-terminated buffer of log lines.
-    // Each entry has this format: [index][log data]['\1']
-    if ((4 & globalConfig.debug.type) == 4)
+    if ((4 & globalConfig.debug.type) == 4 && loglevel <= sinkLevel(globalConfig.debug.web_level))
     {
-        if (!webLogIndex)
-            webLogIndex++;                                           // Index 0 is not allowed as it is the end of char string
-        while (webLogIndex == webLog[0] ||                           // If log already holds the next index, remove it
-               strlen(webLog) + strlen(tmpData) + 13 > WEB_LOG_SIZE) // 13 = web_log_index + mxtime + '\1' + '\0'
-        {
-            char *it = webLog;
-            it++;                                              // Skip web_log_index
-            it += strchrspn(it, '\1');                         // Skip log line
-            it++;                                              // Skip delimiting "\1"
-            memmove(webLog, it, WEB_LOG_SIZE - (it - webLog)); // Move buffer forward to remove oldest log line
-        }
-        snprintf_P(webLog, sizeof(webLog), PSTR("%s%c%s%s\1"), webLog, webLogIndex++, mxtime, tmpData);
-        if (!webLogIndex)
-            webLogIndex++; // Index 0 is not allowed as it is the end of char string
+        webLogAdd(mxtime);
     }
 
-    Syslog();
+    if (loglevel <= sinkLevel(globalConfig.debug.syslog_level))
+    {
+        Syslog(loglevel);
+    }
 }
 
-void DebugClass::AddLog(uint8_t loglevel, PGM_P formatP, ...)
+void DebugClass::AddLogFormat(uint8_t loglevel, PGM_P formatP, ...)
 {
     va_list arg;
     va_start(arg, formatP);
@@ -117,4 +306,115 @@ void DebugClass::AddLog(uint8_t loglevel, PGM_P formatP, ...)
     AddLog(loglevel);
 }
 
+void DebugClass::binLogBegin(uint8_t loglevel, PGM_P formatP)
+{
+    if (binLogLen + BIN_LOG_RECORD_MAX > BIN_LOG_SIZE)
+    {
+        binLogFlush(false);
+    }
+    if (binLogLen == 0)
+    {
+        binLogTime = millis();
+    }
+    binLogStart = binLogLen;
+    binLog[binLogLen++] = 0;
+    binLog[binLogLen++] = loglevel;
+    uint32_t id = (uint32_t)(uintptr_t)formatP;
+    binLogPut(&id, 4);
+}
+
+/**
+ * 上位机按格式串依次解码参数，中间不能缺参数，放不下时截断整条记录的剩余部分
+ */
+void DebugClass::binLogPut(const void *data, uint8_t len)
+{
+    if ((binLog[binLogStart + 1] & BIN_LOG_TRUNCATED) || binLogLen - binLogStart + len > BIN_LOG_RECORD_MAX)
+    {
+        binLog[binLogStart + 1] |= BIN_LOG_TRUNCATED;
+        return;
+    }
+    memcpy(binLog + binLogLen, data, len);
+    binLogLen += len;
+}
+
+/**
+ * 字符串缩短到记录剩余空间并标记截断，连长度字节都放不下时由 binLogPut 截断
+ */
+void DebugClass::binLogArg(const char *str)
+{
+    uint8_t buf[BIN_LOG_STR_MAX + 1];
+    uint8_t len = str ? strnlen(str, BIN_LOG_STR_MAX) : 0;
+    int room = BIN_LOG_RECORD_MAX - (binLogLen - binLogStart) - 1;
+    bool shortened = room >= 0 && len > room;
+    if (shortened)
+    {
+        len = room;
+    }
+    buf[0] = len;
+    memcpy(buf + 1, str, len);
+    binLogPut(buf, len + 1);
+    if (shortened)
+    {
+        binLog[binLogStart + 1] |= BIN_LOG_TRUNCATED;
+    }
+}
+
+void DebugClass::binLogEnd()
+{
+    binLog[binLogStart] = binLogLen - binLogStart;
+    binCount++;
+    binBytes += binLogLen - binLogStart;
+}
+
+/**
+ * 一个 UDP 包: "BLOG" [UID长度][UID] [记录...]
+ */
+void DebugClass::binLogFlush(bool resolve)
+{
+    if (binLogLen == 0)
+    {
+        return;
+    }
+    if (getServer(resolve) && Udp.beginPacket(ip, globalConfig.debug.port))
+    {
+        uint8_t len = strlen(UID);
+        Udp.write("BLOG", 4);
+        Udp.write(&len, 1);
+        Udp.write(UID, len);
+        Udp.write(binLog, binLogLen);
+        Udp.endPacket();
+    }
+    else
+    {
+        binDrop += binLogLen;
+    }
+    binLogLen = 0;
+}
+
+void DebugClass::flush()
+{
+    serialTx.flush();
+    serial1Tx.flush();
+}
+
+void DebugClass::loop()
+{
+    serialTx.loop();
+    serial1Tx.loop();
+
+    // 按 TTL 重新解析, 不依赖是否有待发送的日志
+    if ((18 & globalConfig.debug.type) != 0)
+    {
+        getServer();
+    }
+    if (syslogLen > 0 && ((32 & globalConfig.debug.type) != 32 || millis() - syslogTime >= SYSLOG_FLUSH_TIME))
+    {
+        syslogFlush(false);
+    }
+    if (binLogLen > 0 && millis() - binLogTime >= BIN_LOG_FLUSH_TIME)
+    {
+        binLogFlush();
+    }
+}
+
 DebugClass Debug;
@@ -5,14 +5,29 @@
 #include "Wifi.h"
 #include "Led.h"
 #include "Ntp.h"
+#include "Metrics.h"
+#include "Crash.h"
+#include "Watchdog.h"
+#include "Schedule.h"
+#include "HttpServer.h"
 #include <ESP8266mDNS.h>
-#include <ESP8266WebServer.h>
-#include <ESP8266HTTPUpdateServer.h>
+#include <Updater.h>
 
-ESP8266WebServer *Http::server;
-ESP8266HTTPUpdateServer httpUpdater;
+HttpServer *Http::server;
+String Http::_updaterError;
+boolean Http::updateDone = false;
 
 boolean Http::isBegin = false;
+uint8_t Http::operationFlag = 0;
+uint32_t Http::operationTime = 0;
+uint32_t Http::handleTimeMax = 0;
+
+char Http::statusCache[HTTP_STATUS_CACHE_SIZE];
+uint16_t Http::statusCacheLen = 0;
+uint32_t Http::statusCacheTime = 0;
+uint32_t Http::statusCacheHit = 0;
+uint32_t Http::statusCacheMiss = 0;
+uint32_t Http::statusRenderTime = 0;
 
 void Http::handleRoot()
 {
@@ -98,7 +113,7 @@ void Http::handleRoot()
     page += F("<tr><td colspan='2'><button type='submit' class='btn-info'>连接WiFi</button></td></tr>");
     page += F("<tr><td colspan='2'><button type='button' class='btn-danger' onclick='scanWifi()'>搜索WiFi</button></td></tr>");
     page += F("</tbody></table></form>");
-    page += F("<script type='text/javascript'>function clickwifi(t){id('wifi_ssid').value=t.value}function scanWifi(){ajaxPost('scan_wifi','',function(data){if(data.code==1){if(data.data.list.length==0){scanWifi();return;}var trs=document.getElementsByClassName('addwifi');for(var i=trs.length-1;i>=0;i--){trs[i].remove()}for(var a in data.data.list){var w=data.data.list[a];var tr=document.createElement(\"tr\");var td=document.createElement(\"td\");tr.setAttribute('class','addwifi');td.innerHTML=\"<label class='bui-radios-label'><input type='radio' name='wifi' onclick='clickwifi(this)' value='\"+w.name+\"'/><i class='bui-radios'></i> \"+w.name+(w.type==7?' [开放]':'')+\"</label>\";tr.appendChild(td);td=document.createElement(\"td\");td.innerHTML=w.rssi+'dBm '+w.quality+'%';tr.appendChild(td);var oldEle=id('clusss');oldEle.parentNode.insertBefore(tr,oldEle)}}else{toast(data.msg,data.code?3000:5000,data.code)}})}</script>");
+    page += F("<script type='text/javascript'>function clickwifi(t){id('wifi_ssid').value=t.value}function scanWifi(){ajaxPost('scan_wifi','',function(data){if(data.code==1){if(data.data.scanning==1){setTimeout(scanWifi,1000);return;}var trs=document.getElementsByClassName('addwifi');for(var i=trs.length-1;i>=0;i--){trs[i].remove()}for(var a in data.data.list){var w=data.data.list[a];var tr=document.createElement(\"tr\");var td=document.createElement(\"td\");tr.setAttribute('class','addwifi');td.innerHTML=\"<label class='bui-radios-label'><input type='radio' name='wifi' onclick='clickwifi(this)' value='\"+w.name+\"'/><i class='bui-radios'></i> \"+w.name+(w.type==7?' [开放]':'')+\"</label>\";tr.appendChild(td);td=document.createElement(\"td\");td.innerHTML=w.rssi+'dBm '+w.quality+'%';tr.appendChild(td);var oldEle=id('clusss');oldEle.parentNode.insertBefore(tr,oldEle)}}else{toast(data.msg,data.code?3000:5000,data.code)}})}</script>");
     if (!WiFi.isConnected())
     {
         radioJs += "scanWifi();";
@@ -173,13 +188,18 @@ void Http::handleRoot()
     page = F("<form method='post' action='/module_setting' onsubmit='postform(this);return false'>");
     page += F("<table class='gridtable'><thead><tr><th colspan='2'>模块设置</th></tr></thead><tbody>");
     page += F("<tr><td>主机名</td><td><input type='text' name='uid' value='{UID}'>&nbsp;具有唯一性，留空默认</td></tr>");
+    // 密钥不回显到页面, 只提示是否已设置
+    page += F("<tr><td>局域网密钥</td><td><input type='password' name='lan_key' placeholder='{lan_key}' autocomplete='new-password'>&nbsp;");
+    page += F("<label class='bui-radios-label'><input type='checkbox' name='lan_key_clear' value='1'/><i class='bui-radios' style='border-radius:20%'></i> 清除</label>&nbsp;局域网组播控制，留空不修改</td></tr>");
     page += F("<tr><td>日志输出</td><td>");
     page += F("<label class='bui-radios-label'><input type='checkbox' name='log_serial' value='1'/><i class='bui-radios' style='border-radius:20%'></i> Serial</label>&nbsp;&nbsp;&nbsp;&nbsp;");
     page += F("<label class='bui-radios-label'><input type='checkbox' name='log_serial1' value='1'/><i class='bui-radios' style='border-radius:20%'></i> Serial1</label>&nbsp;&nbsp;&nbsp;&nbsp;");
     page += F("<label class='bui-radios-label'><input type='checkbox' name='log_syslog' value='1'/><i class='bui-radios' style='border-radius:20%'></i> syslog</label>&nbsp;&nbsp;&nbsp;&nbsp;");
     page += F("<label class='bui-radios-label'><input type='checkbox' name='log_web' value='1'/><i class='bui-radios' style='border-radius:20%'></i> web</label>&nbsp;&nbsp;&nbsp;&nbsp;");
+    page += F("<label class='bui-radios-label'><input type='checkbox' name='log_bin' value='1'/><i class='bui-radios' style='border-radius:20%'></i> 二进制UDP</label>&nbsp;&nbsp;&nbsp;&nbsp;");
     page += F("</td></tr>");
     page.replace(F("{UID}"), UID);
+    page.replace(F("{lan_key}"), globalConfig.lan_key[0] ? String(F("已设置")) : String(F("未设置")));
     if ((1 & globalConfig.debug.type) == 1)
     {
         radioJs += F("setRadioValue('log_serial', '1');");
@@ -196,9 +216,35 @@ void Http::handleRoot()
     {
         radioJs += F("setRadioValue('log_serial1', '1');");
     }
+    if ((16 & globalConfig.debug.type) == 16)
+    {
+        radioJs += F("setRadioValue('log_bin', '1');");
+    }
+    if ((32 & globalConfig.debug.type) == 32)
+    {
+        radioJs += F("setRadioValue('log_syslog_batch', '1');");
+    }
+
+    String tmp = F("<option value='1'>错误</option><option value='2'>信息</option><option value='3'>调试</option><option value='4'>详细</option><option value='5'>全部</option>");
+    page += F("<tr><td>日志级别</td><td>");
+    page += F("Serial <select id='log_serial_level' name='log_serial_level'>");
+    page += tmp;
+    page += F("</select>&nbsp;&nbsp;Serial1 <select id='log_serial1_level' name='log_serial1_level'>");
+    page += tmp;
+    page += F("</select>&nbsp;&nbsp;syslog <select id='log_syslog_level' name='log_syslog_level'>");
+    page += tmp;
+    page += F("</select>&nbsp;&nbsp;web <select id='log_web_level' name='log_web_level'>");
+    page += tmp;
+    page += F("</select></td></tr>");
+    radioJs += F("id('log_serial_level').value={v1};id('log_serial1_level').value={v2};id('log_syslog_level').value={v3};id('log_web_level').value={v4};");
+    radioJs.replace(F("{v1}"), String(Debug.sinkLevel(globalConfig.debug.serial_level)));
+    radioJs.replace(F("{v2}"), String(Debug.sinkLevel(globalConfig.debug.serial1_level)));
+    radioJs.replace(F("{v3}"), String(Debug.sinkLevel(globalConfig.debug.syslog_level)));
+    radioJs.replace(F("{v4}"), String(Debug.sinkLevel(globalConfig.debug.web_level)));
 
     page += F("<tr><td>syslog服务器</td><td>");
-    page += F("<input type='text' name='log_syslog_host' style='width:150px' value='{server}'> : <input type='number' name='log_syslog_port' value='{port}' min='0' max='65000' style='width:50px'>");
+    page += F("<input type='text' name='log_syslog_host' style='width:150px' value='{server}'> : <input type='number' name='log_syslog_port' value='{port}' min='0' max='65000' style='width:50px'>&nbsp;&nbsp;");
+    page += F("<label class='bui-radios-label'><input type='checkbox' name='log_syslog_batch' value='1'/><i class='bui-radios' style='border-radius:20%'></i> 合并发送</label>&nbsp;需服务器支持 RFC 6587");
     page += F("</td></tr>");
 
     page += F("<tr><td colspan='2'><button type='submit' class='btn-info'>设置</button></td></tr>");
@@ -378,85 +424,38 @@ void Http::handleScanWifi()
     {
         return;
     }
-    int n = WiFi.scanNetworks();
-    Debug.AddLog(LOG_LEVEL_INFO, PSTR("Scan done"));
-    if (n == 0)
-    {
-        Debug.AddLog(LOG_LEVEL_INFO, PSTR("No networks found"));
-        Http::server->send(200, F("text/html"), F("{\"code\":1,\"msg\":\"\",\"data\":{\"list\":[]}}"));
-        //Http::server->send(200, F("text/html"), F("{\"code\":0,\"msg\":\"找不到网络，请重新试试。\"}"));
-        return;
-    }
-
-    //sort networks
-    int indices[n];
-    for (int i = 0; i < n; i++)
+    // 扫描在后台进行，结果缓存 WIFI_SCAN_CACHE_TIME 内直接返回
+    if (Wifi::scanTime == 0 || millis() - Wifi::scanTime > WIFI_SCAN_CACHE_TIME)
     {
-        indices[i] = i;
-    }
-
-    // RSSI排序
-    for (int i = 0; i < n; i++)
-    {
-        for (int j = i + 1; j < n; j++)
-        {
-            if (WiFi.RSSI(indices[j]) > WiFi.RSSI(indices[i]))
-            {
-                std::swap(indices[i], indices[j]);
-            }
-        }
+        Wifi::scanStart();
     }
-
-    // 删除重复项（必须对RSSI进行排序）
-    String cssid;
-    for (int i = 0; i < n; i++)
+    if (Wifi::scanTime == 0)
     {
-        if (indices[i] == -1)
-            continue;
-        cssid = WiFi.SSID(indices[i]);
-        for (int j = i + 1; j < n; j++)
-        {
-            if (cssid == WiFi.SSID(indices[j]))
-            {
-                Debug.AddLog(LOG_LEVEL_INFO, PSTR("DUP AP: %s"), WiFi.SSID(indices[j]).c_str());
-                indices[j] = -1; // set dup aps to index -1
-            }
-        }
+        Http::server->send(200, F("text/html"), F("{\"code\":1,\"msg\":\"\",\"data\":{\"scanning\":1,\"list\":[]}}"));
+        return;
     }
 
     String data = "";
-    for (int i = 0; i < n; i++)
+    for (uint8_t i = 0; i < Wifi::scanCount; i++)
     {
-        if (indices[i] == -1)
-            continue; // skip dups
-        Debug.AddLog(LOG_LEVEL_INFO, PSTR("%s"), WiFi.SSID(indices[i]).c_str());
-        Debug.AddLog(LOG_LEVEL_INFO, PSTR("%d"), WiFi.RSSI(indices[i]));
-        int RSSI = WiFi.RSSI(indices[i]);
+        WifiScanResult *r = &Wifi::scanResult[i];
         int quality;
-        if (RSSI <= -100)
+        if (r->rssi <= -100)
         {
             quality = 0;
         }
-        else if (RSSI >= -50)
+        else if (r->rssi >= -50)
         {
             quality = 100;
         }
         else
         {
-            quality = 2 * (RSSI + 100);
-        }
-        int _minimumQuality = -1;
-        if (_minimumQuality == -1 || _minimumQuality < quality)
-        {
-            data += ",{\"name\":\"" + WiFi.SSID(indices[i]) + "\",\"rssi\":\"" + RSSI + "\",\"quality\":" + quality + ",\"type\":" + WiFi.encryptionType(indices[i]) + "}";
-        }
-        else
-        {
-            Debug.AddLog(LOG_LEVEL_INFO, PSTR("Skipping due to quality"));
+            quality = 2 * (r->rssi + 100);
         }
+        data += ",{\"name\":\"" + String(r->ssid) + "\",\"rssi\":\"" + r->rssi + "\",\"quality\":" + quality + ",\"type\":" + r->enc + ",\"channel\":" + r->channel + "}";
     }
 
-    Http::server->send(200, F("text/html"), "{\"code\":1,\"msg\":\"\",\"data\":{\"list\":[" + data.substring(1) + "]}}");
+    Http::server->send(200, F("text/html"), "{\"code\":1,\"msg\":\"\",\"data\":{\"age\":" + String((millis() - Wifi::scanTime) / 1000) + ",\"list\":[" + data.substring(1) + "]}}");
 }
 
 void Http::handleWifi()
@@ -518,10 +517,7 @@ void Http::handleRestart()
         return;
     }
     Http::server->send(200, F("text/html"), F("{\"code\":1,\"msg\":\"设备正在重启 . . .\"}"));
-    delay(200);
-
-    Led::blinkLED(400, 4);
-    ESP.restart();
+    restart();
 }
 
 void Http::handleReset()
@@ -531,13 +527,7 @@ void Http::handleReset()
         return;
     }
     Http::server->send(200, F("text/html"), F("{\"code\":1,\"msg\":\"正在重置模块 . . . 设备将会重启。\"}"));
-    delay(200);
-
-    Led::blinkLED(400, 4);
-
-    Config::resetConfig();
-    Config::saveConfig();
-    ESP.restart();
+    restart(true);
 }
 
 void Http::handleOTA()
@@ -549,7 +539,8 @@ void Http::handleOTA()
     strcpy(globalConfig.http.ota_url, server->arg(F("ota_url")).c_str());
     Config::saveConfig();
     Http::server->send(200, F("text/html"), F("{\"code\":1,\"msg\":\"如果成功后设备会重启 . . . \"}"));
-    Wifi::OTA(String(globalConfig.http.ota_url));
+    bitSet(operationFlag, 2);
+    operationTime = millis();
 }
 
 void Http::handleNotFound()
@@ -573,25 +564,11 @@ void Http::handleNotFound()
     server->sendHeader(F("Cache-Control"), F("no-cache, no-store, must-revalidate"));
     server->sendHeader(F("Pragma"), F("no-cache"));
     server->sendHeader(F("Expires"), F("-1"));
-    server->sendHeader(F("Content-Length"), String(message.length()));
     server->send(404, F("text/plain"), message);
 }
 
-void Http::handleGetStatus()
+String Http::getStatus()
 {
-    if (!checkAuth())
-    {
-        return;
-    }
-    bool cflg = true;
-    uint8_t counter = 0;
-    if (server->hasArg(F("i")))
-    {
-        counter = server->arg(F("i")).toInt();
-    }
-
-    server->setContentLength(CONTENT_LENGTH_UNKNOWN);
-    server->send(200, F("text/html"), "");
     String data = F("{\"code\":1,\"msg\":\"\",\"data\":{");
     data += F("\"mqttconnected\":\"");
     data += mqtt && mqtt->mqttClient.connected() ? F("已连接") : F("未连接");
@@ -624,8 +601,54 @@ void Http::handleGetStatus()
             data += tmp;
         }
     }
+    return data;
+}
+
+void Http::handleGetStatus()
+{
+    if (!checkAuth())
+    {
+        return;
+    }
+    bool cflg = true;
+    uint8_t counter = 0;
+    if (server->hasArg(F("i")))
+    {
+        counter = server->arg(F("i")).toInt();
+    }
+
+    server->setContentLength(CONTENT_LENGTH_UNKNOWN);
+    server->send(200, F("text/html"), "");
+
+    // 同一时间窗口内的请求共用一份状态JSON，日志部分仍按各自的 i 追加
+    if (statusCacheLen == 0 || millis() - statusCacheTime >= HTTP_STATUS_CACHE_TIME)
+    {
+        uint32_t start = micros();
+        String data = getStatus();
+        statusCacheMiss++;
+        statusRenderTime += micros() - start;
+        if (data.length() < sizeof(statusCache))
+        {
+            statusCacheLen = data.length();
+            memcpy(statusCache, data.c_str(), statusCacheLen);
+            statusCacheTime = millis();
+        }
+        else
+        {
+            statusCacheLen = 0;
+            server->sendContent(data);
+        }
+    }
+    else
+    {
+        statusCacheHit++;
+    }
+    if (statusCacheLen > 0)
+    {
+        server->sendContent_P(statusCache, statusCacheLen);
+    }
 
-    data += F(",\"logindex\":");
+    String data = F(",\"logindex\":");
     data += Debug.webLogIndex;
 
     data += F(",\"log\":\"");
@@ -651,7 +674,7 @@ void Http::handleGetStatus()
                 }
 
                 size_t j = 0;
-                for (size_t i = 0; i < len - 1; i++)
+                for (size_t i = 0; i < len; i++)
                 {
                     char each = tmp[i];
                     if (each == '\\' || each == '"')
@@ -705,6 +728,141 @@ void Http::handleGetStatus()
     server->sendContent(F("\"}}"));
 }
 
+void Http::handleBatch()
+{
+    if (!checkAuth())
+    {
+        return;
+    }
+    uint32_t start = micros();
+    uint8_t count = batchDo(server->arg(F("ops")));
+    start = micros() - start;
+    if (count == 0)
+    {
+        server->send(200, F("text/html"), F("{\"code\":0,\"msg\":\"参数错误。\"}"));
+        return;
+    }
+    Debug.AddLog(LOG_LEVEL_INFO, PSTR("Batch %d ops %dus"), count, start);
+    String data = module->httpGetStatus(server);
+    server->send(200, F("text/html"), "{\"code\":1,\"msg\":\"操作成功\",\"data\":{\"count\":" + String(count) + ",\"time\":" + String(start) + (data.length() > 0 ? "," + data : "") + "}}");
+}
+
+void Http::handleMetrics()
+{
+    if (!checkAuth())
+    {
+        return;
+    }
+    Metrics::handle(server);
+    // 带 reset 参数时清零最大值, 用于按时间窗口测量 (scripts/httpbench.py)
+    if (server->hasArg(F("reset")))
+    {
+        handleTimeMax = 0;
+        Metrics::loopTimeMax = 0;
+    }
+}
+
+void Http::handleStall()
+{
+    if (!checkAuth())
+    {
+        return;
+    }
+    if (server->hasArg(F("budget")))
+    {
+        long budget = server->arg(F("budget")).toInt();
+        if (budget < 1 || budget > WATCHDOG_BUDGET_MAX)
+        {
+            server->send(200, F("text/html"), F("{\"code\":0,\"msg\":\"budget 范围 1-5000\"}"));
+            return;
+        }
+        Watchdog::budget = budget;
+    }
+    server->send(200, F("text/html"), "{\"code\":1,\"msg\":\"\",\"data\":" + Watchdog::toJson() + "}");
+}
+
+void Http::handleCrash()
+{
+    if (!checkAuth())
+    {
+        return;
+    }
+    server->send(200, F("text/html"), "{\"code\":1,\"msg\":\"\",\"data\":" + Crash::toJson() + "}");
+}
+
+void Http::handleWifiLink()
+{
+    if (!checkAuth())
+    {
+        return;
+    }
+    server->send(200, F("text/html"), "{\"code\":1,\"msg\":\"\",\"data\":" + Wifi::linkJson() + "}");
+}
+
+void Http::handleSchedule()
+{
+    if (!checkAuth())
+    {
+        return;
+    }
+    float lat = server->hasArg(F("lat")) ? server->arg(F("lat")).toFloat() : 0;
+    float lon = server->hasArg(F("lon")) ? server->arg(F("lon")).toFloat() : 0;
+    if (fabs(lat) > 90 || fabs(lon) > 180)
+    {
+        server->send(200, F("text/html"), F("{\"code\":0,\"msg\":\"经纬度超出范围\"}"));
+        return;
+    }
+    if (server->hasArg(F("entries")) && !Schedule::set(server->arg(F("entries"))))
+    {
+        server->send(200, F("text/html"), F("{\"code\":0,\"msg\":\"定时任务格式错误\"}"));
+        return;
+    }
+    // 定时任务有效后再更新, 只改传入的那一项
+    if (server->hasArg(F("lat")))
+    {
+        globalConfig.schedule.latitude = round(lat * 100000);
+    }
+    if (server->hasArg(F("lon")))
+    {
+        globalConfig.schedule.longitude = round(lon * 100000);
+    }
+    if (server->hasArg(F("lat")) || server->hasArg(F("lon")) || server->hasArg(F("entries")))
+    {
+        Schedule::reload();
+        Config::saveConfig();
+    }
+    server->send(200, F("text/html"), "{\"code\":1,\"msg\":\"\",\"data\":" + Schedule::toJson() + "}");
+}
+
+/**
+ * 批量执行 key:value,key:value 形式的操作，最后统一发布一次状态
+ */
+uint8_t Http::batchDo(String ops)
+{
+    if (!module)
+    {
+        return 0;
+    }
+    uint8_t count = 0;
+    int start = 0;
+    while (start < ops.length())
+    {
+        int end = ops.indexOf(',', start);
+        if (end == -1)
+        {
+            end = ops.length();
+        }
+        int sep = ops.indexOf(':', start);
+        if (sep > start && sep < end && module->batchCommand(ops.substring(start, sep), ops.substring(sep + 1, end)))
+        {
+            count++;
+        }
+        start = end + 1;
+    }
+    module->batchCommit();
+    return count;
+}
+
 void Http::begin()
 {
     if (isBegin)
@@ -712,8 +870,14 @@ void Http::begin()
         return;
     }
     isBegin = true;
-    server = new ESP8266WebServer();
-    httpUpdater.setup(server);
+    server = new HttpServer();
+
+    Metrics::add(PSTR("esp_http_status_cache_hit_total"), METRICS_COUNTER, &statusCacheHit);
+    Metrics::add(PSTR("esp_http_status_cache_miss_total"), METRICS_COUNTER, &statusCacheMiss);
+    Metrics::add(PSTR("esp_http_status_render_us_total"), METRICS_COUNTER, &statusRenderTime);
+    Metrics::add(PSTR("esp_http_handle_time_max_us"), METRICS_GAUGE, &handleTimeMax);
+    Metrics::add(PSTR("esp_http_clients"), METRICS_GAUGE, &server->clientCount);
+    Metrics::add(PSTR("esp_http_reject_total"), METRICS_COUNTER, &server->rejectCount);
 
     server->on(F("/"), handleRoot);
     server->on(F("/mqtt"), handleMqtt);
@@ -726,6 +890,13 @@ void Http::begin()
     server->on(F("/module_setting"), handleModuleSetting);
     server->on(F("/ota"), handleOTA);
     server->on(F("/get_status"), handleGetStatus);
+    server->on(F("/api/batch"), handleBatch);
+    server->on(F("/metrics"), handleMetrics);
+    server->on(F("/crash"), handleCrash);
+    server->on(F("/stall"), handleStall);
+    server->on(F("/schedule"), handleSchedule);
+    server->on(F("/wifi_link"), handleWifiLink);
+    server->on(F("/update"), HTTP_POST, handleUpdate, handleUpload);
     server->onNotFound(handleNotFound);
 
     if (module)
@@ -751,9 +922,55 @@ void Http::loop()
 {
     if (isBegin)
     {
+        // 每次只处理有限的数据和一个请求, 负载下的耗时用 scripts/httpbench.py 测量
+        uint32_t start = micros();
+        Watchdog::begin(WATCHDOG_STAGE_HTTP);
         server->handleClient();
+        if (Watchdog::end())
+        {
+            Watchdog::setTag(server->uri().c_str());
+        }
+        start = micros() - start;
+        if (start > handleTimeMax)
+        {
+            handleTimeMax = start;
+        }
         MDNS.update();
     }
+
+    // 等响应发送完成后再执行耗时操作
+    if (operationFlag == 0 || millis() - operationTime < 200)
+    {
+        return;
+    }
+    if (bitRead(operationFlag, 2))
+    {
+        bitClear(operationFlag, 2);
+        Wifi::OTA(String(globalConfig.http.ota_url));
+    }
+    if (bitRead(operationFlag, 1))
+    {
+        Config::resetConfig();
+        Config::saveConfig();
+    }
+    if (bitRead(operationFlag, 0) || bitRead(operationFlag, 1))
+    {
+        operationFlag = 0;
+        bitSet(operationFlag, 3);
+        Led::play(&LED_RESTART);
+    }
+    // 指示灯闪完再重启
+    if (bitRead(operationFlag, 3) && !Led::isPlaying())
+    {
+        Debug.flush();
+        ESP.restart();
+    }
+}
+
+void Http::restart(boolean isReset)
+{
+    bitSet(operationFlag, isReset ? 1 : 0);
+    operationTime = millis();
 }
 
 boolean Http::captivePortal()
@@ -761,9 +978,8 @@ boolean Http::captivePortal()
     if (!Wifi::isIp(server->hostHeader()))
     {
         //Debug.AddLog(LOG_LEVEL_INFO, PSTR("Request redirected to captive portal"));
-        server->sendHeader(F("Location"), String(F("http://")) + server->client().localIP().toString(), true);
-        server->send(302, F("text/plain"), ""); // Empty content inhibits Content-length header so we have to close the socket ourselves.
-        server->client().stop();                // Stop is needed because we sent no content length
+        server->sendHeader(F("Location"), String(F("http://")) + server->localIP().toString(), true);
+        server->send(302, F("text/plain"), "");
         return true;
     }
     return false;
@@ -775,7 +991,7 @@ void Http::handleModuleSetting()
     {
         return;
     }
-    if (Http::server->hasArg(F("log_serial")) || Http::server->hasArg(F("log_serial1")) || Http::server->hasArg(F("log_syslog")) || Http::server->hasArg(F("log_web")))
+    if (Http::server->hasArg(F("log_serial")) || Http::server->hasArg(F("log_serial1")) || Http::server->hasArg(F("log_syslog")) || Http::server->hasArg(F("log_web")) || Http::server->hasArg(F("log_bin")))
     {
         int t = 0;
         if (Http::server->arg(F("log_serial")).equals(F("1")))
@@ -791,10 +1007,22 @@ void Http::handleModuleSetting()
             t = t | 4;
         }
 
+        if (Http::server->arg(F("log_bin")).equals(F("1")))
+        {
+            t = t | 16;
+        }
+
         String log_syslog = Http::server->arg(F("log_syslog"));
         if (log_syslog.equals(F("1")))
         {
             t = t | 2;
+        }
+        if (Http::server->arg(F("log_syslog_batch")).equals(F("1")))
+        {
+            t = t | 32;
+        }
+        if ((t & 18) != 0)
+        {
             String log_syslog_host = Http::server->arg(F("log_syslog_host"));
             String log_syslog_port = Http::server->arg(F("log_syslog_port"));
             if (log_syslog_host.length() == 0)
@@ -804,7 +1032,7 @@ void Http::handleModuleSetting()
             }
             strcpy(globalConfig.debug.server, log_syslog_host.c_str());
             globalConfig.debug.port = log_syslog_port.toInt();
-            WiFi.hostByName(globalConfig.debug.server, Debug.ip);
+            Debug.serverChanged();
         }
 
         if (Http::server->arg(F("log_serial1")).equals(F("1")))
@@ -813,14 +1041,28 @@ void Http::handleModuleSetting()
         }
         globalConfig.debug.type = t;
     }
+    if (Http::server->hasArg(F("log_serial_level")))
+    {
+        globalConfig.debug.serial_level = Http::server->arg(F("log_serial_level")).toInt();
+        globalConfig.debug.serial1_level = Http::server->arg(F("log_serial1_level")).toInt();
+        globalConfig.debug.syslog_level = Http::server->arg(F("log_syslog_level")).toInt();
+        globalConfig.debug.web_level = Http::server->arg(F("log_web_level")).toInt();
+    }
+    if (Http::server->arg(F("lan_key_clear")).equals(F("1")))
+    {
+        memset(globalConfig.lan_key, 0, sizeof(globalConfig.lan_key));
+    }
+    else if (Http::server->arg(F("lan_key")).length() > 0)
+    {
+        strncpy(globalConfig.lan_key, Http::server->arg(F("lan_key")).c_str(), sizeof(globalConfig.lan_key) - 1);
+    }
     String uid = Http::server->arg(F("uid"));
     strcpy(globalConfig.uid, uid.c_str());
     Config::saveConfig();
     if (uid.length() == 0 || strncmp(globalConfig.uid, UID, uid.length()) != 0)
     {
         Http::server->send(200, F("text/html"), F("{\"code\":1,\"msg\":\"修改了重要配置 . . . 正在重启中。\"}"));
-        Led::blinkLED(400, 4);
-        ESP.restart();
+        restart();
     }
     else
     {
@@ -828,15 +1070,85 @@ void Http::handleModuleSetting()
     }
 }
 
+boolean Http::isAuthorized()
+{
+    return globalConfig.http.user[0] == 0 || globalConfig.http.pass[0] == 0 || server->localIP().toString() == "192.168.4.1" || server->authenticate(globalConfig.http.user, globalConfig.http.pass);
+}
+
 boolean Http::checkAuth()
 {
-    if (globalConfig.http.user[0] != 0 && globalConfig.http.pass[0] != 0 && server->client().localIP().toString() != "192.168.4.1")
+    if (!isAuthorized())
+    {
+        server->requestAuthentication();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * 上传固件: 数据在 handleClient 中边收边写入 Update, 收完后由 handleUpdate 回复并重启
+ */
+void Http::handleUpload()
+{
+    HTTPUpload &upload = server->upload();
+    if (upload.status == UPLOAD_FILE_START)
     {
-        if (!server->authenticate(globalConfig.http.user, globalConfig.http.pass))
+        _updaterError = "";
+        updateDone = false;
+        if (!isAuthorized())
         {
-            server->requestAuthentication();
-            return false;
+            _updaterError = F("未授权");
+            return;
+        }
+        Debug.AddLog(LOG_LEVEL_INFO, PSTR("Update: %s"), upload.filename.c_str());
+        uint32_t maxSketchSpace = (ESP.getFreeSketchSpace() - 0x1000) & 0xFFFFF000;
+        if (!Update.begin(maxSketchSpace, U_FLASH))
+        {
+            _updaterError = String(F("begin error: ")) + Update.getError();
         }
     }
-    return true;
+    else if (_updaterError.length() > 0)
+    {
+        return;
+    }
+    else if (upload.status == UPLOAD_FILE_WRITE)
+    {
+        if (Update.write(upload.buf, upload.currentSize) != upload.currentSize)
+        {
+            _updaterError = String(F("write error: ")) + Update.getError();
+        }
+    }
+    else if (upload.status == UPLOAD_FILE_END)
+    {
+        updateDone = Update.end(true);
+        if (!updateDone)
+        {
+            _updaterError = String(F("end error: ")) + Update.getError();
+        }
+    }
+    else if (upload.status == UPLOAD_FILE_ABORTED)
+    {
+        Update.end();
+        _updaterError = F("aborted");
+    }
+}
+
+void Http::handleUpdate()
+{
+    if (!checkAuth())
+    {
+        return;
+    }
+    if (!updateDone)
+    {
+        if (_updaterError.length() == 0)
+        {
+            _updaterError = F("没有收到固件");
+        }
+        Debug.AddLog(LOG_LEVEL_ERROR, PSTR("Update error: %s"), _updaterError.c_str());
+        server->send(200, F("text/html"), String(F("升级失败: ")) + _updaterError);
+        return;
+    }
+    server->send(200, F("text/html"), F("升级成功, 正在重启 . . ."));
+    restart();
 }
\ No newline at end of file
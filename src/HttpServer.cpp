@@ -0,0 +1,1268 @@
+#include "HttpServer.h"
+#include "lwip/tcp.h"
+
+static const char base64Chars[] PROGMEM = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static String base64(const char *data, size_t len)
+{
+    String out;
+    for (size_t i = 0; i < len; i += 3)
+    {
+        uint32_t n = (uint8_t)data[i] << 16;
+        if (i + 1 < len)
+        {
+            n |= (uint8_t)data[i + 1] << 8;
+        }
+        if (i + 2 < len)
+        {
+            n |= (uint8_t)data[i + 2];
+        }
+        out += (char)pgm_read_byte(base64Chars + (n >> 18 & 63));
+        out += (char)pgm_read_byte(base64Chars + (n >> 12 & 63));
+        out += i + 1 < len ? (char)pgm_read_byte(base64Chars + (n >> 6 & 63)) : '=';
+        out += i + 2 < len ? (char)pgm_read_byte(base64Chars + (n & 63)) : '=';
+    }
+    return out;
+}
+
+static uint8_t hexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    return 0;
+}
+
+static void urlDecode(const char *s, size_t len, String *out)
+{
+    *out = "";
+    for (size_t i = 0; i < len; i++)
+    {
+        if (s[i] == '+')
+        {
+            *out += ' ';
+        }
+        else if (s[i] == '%' && i + 2 < len && isxdigit((uint8_t)s[i + 1]) && isxdigit((uint8_t)s[i + 2]))
+        {
+            *out += (char)(hexValue(s[i + 1]) << 4 | hexValue(s[i + 2]));
+            i += 2;
+        }
+        else
+        {
+            *out += s[i];
+        }
+    }
+}
+
+static void urlEncode(const String &s, String *out)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    for (size_t i = 0; i < s.length(); i++)
+    {
+        char c = s[i];
+        if (isalnum((uint8_t)c) || c == '-' || c == '_' || c == '.' || c == '~')
+        {
+            *out += c;
+        }
+        else
+        {
+            *out += '%';
+            *out += hex[(uint8_t)c >> 4];
+            *out += hex[c & 15];
+        }
+    }
+}
+
+static String statusText(int code)
+{
+    switch (code)
+    {
+    case 200:
+        return F("OK");
+    case 302:
+        return F("Found");
+    case 400:
+        return F("Bad Request");
+    case 401:
+        return F("Unauthorized");
+    case 404:
+        return F("Not Found");
+    case 413:
+        return F("Payload Too Large");
+    case 431:
+        return F("Request Header Fields Too Large");
+    case 500:
+        return F("Internal Server Error");
+    case 503:
+        return F("Service Unavailable");
+    }
+    return F("");
+}
+
+// 取 name 后面到 stop 中任一字符之前的内容, 如 filename=" 到 "
+static String headerParam(const char *line, const char *name, const char *stop)
+{
+    String out;
+    const char *p = strstr(line, name);
+    if (p)
+    {
+        for (p += strlen(name); *p && !strchr(stop, *p); p++)
+        {
+            out += *p;
+        }
+    }
+    return out;
+}
+
+HttpServer::HttpServer()
+{
+    for (uint8_t i = 0; i < HTTP_MAX_CLIENTS; i++)
+    {
+        clients[i].state = HTTP_STATE_FREE;
+        clients[i].pcb = NULL;
+        clients[i].rx = NULL;
+        clients[i].buf = NULL;
+        clients[i].tx = NULL;
+    }
+}
+
+void HttpServer::begin(uint16_t port)
+{
+    tcp_pcb *pcb = tcp_new();
+    if (!pcb)
+    {
+        return;
+    }
+    ip_set_option(pcb, SOF_REUSEADDR);
+    if (tcp_bind(pcb, IP_ADDR_ANY, port) != ERR_OK)
+    {
+        tcp_close(pcb);
+        return;
+    }
+    listenPcb = tcp_listen(pcb);
+    if (!listenPcb)
+    {
+        tcp_close(pcb);
+        return;
+    }
+    tcp_arg(listenPcb, this);
+    tcp_accept(listenPcb, onAccept);
+}
+
+void HttpServer::stop()
+{
+    if (listenPcb)
+    {
+        tcp_arg(listenPcb, NULL);
+        tcp_accept(listenPcb, NULL);
+        tcp_close(listenPcb);
+        listenPcb = NULL;
+    }
+    for (uint8_t i = 0; i < HTTP_MAX_CLIENTS; i++)
+    {
+        if (clients[i].state != HTTP_STATE_FREE)
+        {
+            abort(&clients[i]);
+        }
+    }
+}
+
+void HttpServer::on(const String &uri, THandlerFunction fn)
+{
+    on(uri, HTTP_ANY, fn, NULL);
+}
+
+void HttpServer::on(const String &uri, HTTPMethod method, THandlerFunction fn)
+{
+    on(uri, method, fn, NULL);
+}
+
+void HttpServer::on(const String &uri, HTTPMethod method, THandlerFunction fn, THandlerFunction uploadFn)
+{
+    HttpRoute *route = new HttpRoute;
+    route->uri = uri;
+    route->method = method;
+    route->fn = fn;
+    route->uploadFn = uploadFn;
+    route->next = NULL;
+    // 按注册顺序匹配
+    HttpRoute **tail = &routes;
+    while (*tail)
+    {
+        tail = &(*tail)->next;
+    }
+    *tail = route;
+}
+
+void HttpServer::onNotFound(THandlerFunction fn)
+{
+    notFoundFn = fn;
+}
+
+// lwIP 回调: 只登记连接/挂接收数据/续发, 不解析
+
+int8_t HttpServer::onAccept(void *arg, tcp_pcb *pcb, int8_t err)
+{
+    HttpServer *server = (HttpServer *)arg;
+    if (!server || err != ERR_OK || !pcb)
+    {
+        return ERR_VAL;
+    }
+    HttpClient *c = NULL;
+    for (uint8_t i = 0; i < HTTP_MAX_CLIENTS; i++)
+    {
+        if (server->clients[i].state == HTTP_STATE_FREE)
+        {
+            c = &server->clients[i];
+            break;
+        }
+    }
+    if (!c)
+    {
+        server->rejectCount++;
+        tcp_abort(pcb);
+        return ERR_ABRT;
+    }
+    c->pcb = pcb;
+    c->rx = NULL;
+    c->rxOffset = 0;
+    c->state = HTTP_STATE_REQUEST;
+    c->method = HTTP_GET;
+    c->form = false;
+    c->remoteClosed = false;
+    c->mpFile = false;
+    c->time = millis();
+    c->contentLength = 0;
+    c->bodyLen = 0;
+    c->bufLen = 0;
+    c->txLen = 0;
+    c->txPos = 0;
+    c->uri = "";
+    c->query = "";
+    c->host = "";
+    c->auth = "";
+    c->delimiter = "";
+    c->route = NULL;
+    server->clientCount++;
+
+    tcp_setprio(pcb, TCP_PRIO_MIN);
+    tcp_nagle_disable(pcb); // 响应分段写入, 不等上一段的确认
+    tcp_arg(pcb, c);
+    tcp_recv(pcb, onRecv);
+    tcp_sent(pcb, onSent);
+    tcp_err(pcb, onError);
+    return ERR_OK;
+}
+
+int8_t HttpServer::onRecv(void *arg, tcp_pcb *pcb, pbuf *p, int8_t err)
+{
+    HttpClient *c = (HttpClient *)arg;
+    if (!p)
+    {
+        if (c)
+        {
+            c->remoteClosed = true;
+        }
+        return ERR_OK;
+    }
+    if (!c)
+    {
+        tcp_recved(pcb, p->tot_len);
+        pbuf_free(p);
+        return ERR_OK;
+    }
+    if (c->rx)
+    {
+        pbuf_cat(c->rx, p);
+    }
+    else
+    {
+        c->rx = p;
+    }
+    return ERR_OK;
+}
+
+int8_t HttpServer::onSent(void *arg, tcp_pcb *pcb, uint16_t len)
+{
+    HttpClient *c = (HttpClient *)arg;
+    if (c)
+    {
+        c->time = millis();
+    }
+    return ERR_OK;
+}
+
+void HttpServer::onError(void *arg, int8_t err)
+{
+    // pcb 已被 lwIP 释放, 清理留给 handleClient
+    HttpClient *c = (HttpClient *)arg;
+    if (c)
+    {
+        c->pcb = NULL;
+    }
+}
+
+void HttpServer::handleClient()
+{
+    bool dispatched = false;
+    for (uint8_t k = 0; k < HTTP_MAX_CLIENTS; k++)
+    {
+        uint8_t i = (nextClient + k) % HTTP_MAX_CLIENTS;
+        HttpClient *c = &clients[i];
+        if (c->state == HTTP_STATE_FREE)
+        {
+            continue;
+        }
+        if (!c->pcb)
+        {
+            release(c);
+            continue;
+        }
+        receive(c);
+        if (c->state == HTTP_STATE_READY && !dispatched)
+        {
+            dispatch(c);
+            dispatched = true;
+            nextClient = i + 1;
+            if (!c->pcb)
+            {
+                release(c);
+                continue;
+            }
+        }
+        if (c->state == HTTP_STATE_SENDING)
+        {
+            flush(c);
+            if (c->txPos == c->txLen)
+            {
+                close(c);
+                continue;
+            }
+        }
+        else if (c->remoteClosed && c->state < HTTP_STATE_READY && !c->rx)
+        {
+            // 请求没发完就关闭了
+            abort(c);
+            continue;
+        }
+        if (millis() - c->time > HTTP_CLIENT_TIMEOUT)
+        {
+            if (c->state < HTTP_STATE_READY)
+            {
+                rejectCount++;
+            }
+            abort(c);
+        }
+    }
+}
+
+void HttpServer::receive(HttpClient *c)
+{
+    size_t budget = HTTP_PARSE_BUDGET;
+    while (c->rx && budget > 0 && c->state != HTTP_STATE_READY)
+    {
+        const char *data = (const char *)c->rx->payload + c->rxOffset;
+        size_t len = c->rx->len - c->rxOffset;
+        if (len > budget)
+        {
+            len = budget;
+        }
+        // 响应阶段收到的数据直接丢弃, 关闭前必须全部确认, 否则 lwIP 会发 RST 导致对方丢掉响应
+        size_t used = c->state == HTTP_STATE_SENDING ? len : parse(c, data, len);
+        consume(c, used);
+        budget -= used;
+        if (used < len)
+        {
+            break;
+        }
+    }
+}
+
+void HttpServer::consume(HttpClient *c, size_t len)
+{
+    if (len > 0)
+    {
+        tcp_recved(c->pcb, len);
+    }
+    c->rxOffset += len;
+    if (c->rxOffset == c->rx->len)
+    {
+        pbuf *next = c->rx->next;
+        if (next)
+        {
+            pbuf_ref(next);
+        }
+        pbuf_free(c->rx);
+        c->rx = next;
+        c->rxOffset = 0;
+    }
+}
+
+/**
+ * 处理一段收到的数据, 返回用掉的字节数; 请求完整或被拒绝后停止
+ */
+size_t HttpServer::parse(HttpClient *c, const char *data, size_t len)
+{
+    size_t i = 0;
+    while (i < len && c->state < HTTP_STATE_READY)
+    {
+        if (c->state == HTTP_STATE_REQUEST || c->state == HTTP_STATE_HEADER)
+        {
+            const char *nl = (const char *)memchr(data + i, '\n', len - i);
+            size_t n = nl ? nl - (data + i) + 1 : len - i;
+            if (!append(c->buf, c->bufLen, c->bufSize, data + i, n, false) || c->bufLen > HTTP_LINE_SIZE)
+            {
+                reject(c, 431);
+                return i + n;
+            }
+            i += n;
+            if (nl)
+            {
+                parseLine(c);
+            }
+            continue;
+        }
+
+        size_t n = c->contentLength - c->bodyLen;
+        if (n > len - i)
+        {
+            n = len - i;
+        }
+        c->time = millis(); // 请求体有进展就不算超时, 上传固件需要较长时间
+        if (c->state == HTTP_STATE_UPLOAD)
+        {
+            n = parseUpload(c, data + i, n);
+        }
+        else if (c->form && !append(c->buf, c->bufLen, c->bufSize, data + i, n, false))
+        {
+            reject(c, 413);
+            return i + n;
+        }
+        i += n;
+        c->bodyLen += n;
+        if (c->bodyLen == c->contentLength)
+        {
+            if (c->form && c->bufLen > 0)
+            {
+                c->buf[c->bufLen] = 0;
+                if (c->query.length() > 0)
+                {
+                    c->query += '&';
+                }
+                c->query += c->buf;
+            }
+            if (uploadClient == c && c->mpFile)
+            {
+                // 没有收到结束分隔符
+                c->mpFile = false;
+                uploadCallback(c, UPLOAD_FILE_ABORTED);
+            }
+            c->bufLen = 0;
+            c->state = HTTP_STATE_READY;
+        }
+    }
+    return i;
+}
+
+void HttpServer::parseLine(HttpClient *c)
+{
+    // 去掉行尾 \r\n
+    while (c->bufLen > 0 && (c->buf[c->bufLen - 1] == '\n' || c->buf[c->bufLen - 1] == '\r'))
+    {
+        c->bufLen--;
+    }
+    c->buf[c->bufLen] = 0;
+    char *line = c->buf;
+    c->bufLen = 0;
+
+    if (c->state == HTTP_STATE_REQUEST)
+    {
+        if (line[0] == 0)
+        {
+            return; // 请求之间多余的空行
+        }
+        // METHOD SP URI SP HTTP/1.x
+        char *uri = strchr(line, ' ');
+        char *version = uri ? strchr(uri + 1, ' ') : NULL;
+        if (!uri || !version)
+        {
+            reject(c, 400);
+            return;
+        }
+        *uri++ = 0;
+        *version = 0;
+        static const char *const methods[] = {"GET", "HEAD", "POST", "PUT", "PATCH", "DELETE", "OPTIONS"};
+        c->method = HTTP_ANY;
+        for (uint8_t i = 0; i < sizeof(methods) / sizeof(methods[0]); i++)
+        {
+            if (strcmp(line, methods[i]) == 0)
+            {
+                c->method = HTTP_GET + i;
+            }
+        }
+        char *query = strchr(uri, '?');
+        if (query)
+        {
+            *query++ = 0;
+            c->query = query;
+        }
+        c->uri = uri;
+        c->state = HTTP_STATE_HEADER;
+        return;
+    }
+    if (line[0] == 0)
+    {
+        headerDone(c);
+        return;
+    }
+    parseHeader(c, line);
+}
+
+void HttpServer::parseHeader(HttpClient *c, const char *line)
+{
+    const char *value = strchr(line, ':');
+    if (!value)
+    {
+        return;
+    }
+    size_t nameLen = value - line;
+    value++;
+    while (*value == ' ' || *value == '\t')
+    {
+        value++;
+    }
+    if (nameLen == 4 && strncasecmp(line, "Host", 4) == 0)
+    {
+        c->host = value;
+    }
+    else if (nameLen == 13 && strncasecmp(line, "Authorization", 13) == 0)
+    {
+        c->auth = value;
+    }
+    else if (nameLen == 14 && strncasecmp(line, "Content-Length", 14) == 0)
+    {
+        c->contentLength = strtoul(value, NULL, 10);
+    }
+    else if (nameLen == 12 && strncasecmp(line, "Content-Type", 12) == 0)
+    {
+        if (strncasecmp(value, "multipart/form-data", 19) == 0)
+        {
+            const char *boundary = strstr(value, "boundary=");
+            if (boundary)
+            {
+                c->delimiter = "\r\n--";
+                c->delimiter += boundary[9] == '"' ? headerParam(boundary, "=\"", "\"") : headerParam(boundary, "=", "; ");
+            }
+        }
+        else
+        {
+            c->form = strncasecmp(value, "application/x-www-form-urlencoded", 33) == 0;
+        }
+    }
+}
+
+void HttpServer::headerDone(HttpClient *c)
+{
+    c->route = findRoute(c);
+    if (c->contentLength == 0)
+    {
+        c->state = HTTP_STATE_READY;
+        return;
+    }
+    if (c->delimiter.length() > 4)
+    {
+        if (uploadClient)
+        {
+            reject(c, 503);
+            return;
+        }
+        uploadClient = c;
+        c->form = false;
+        c->mpState = HTTP_MP_BOUNDARY;
+        c->mpMatch = 0;
+        c->state = HTTP_STATE_UPLOAD;
+        return;
+    }
+    if (c->form && c->contentLength > HTTP_BODY_MAX)
+    {
+        reject(c, 413);
+        return;
+    }
+    c->state = HTTP_STATE_BODY;
+}
+
+HttpRoute *HttpServer::findRoute(HttpClient *c)
+{
+    for (HttpRoute *r = routes; r; r = r->next)
+    {
+        if ((r->method == HTTP_ANY || r->method == c->method) && r->uri == c->uri)
+        {
+            return r;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * multipart/form-data: 分隔符和段头按行处理, 文件内容逐字节查找 "\r\n--boundary",
+ * 分隔符第一个字节 '\r' 不会出现在分隔符其余部分中, 失配时只需把已匹配的部分当作数据输出
+ */
+size_t HttpServer::parseUpload(HttpClient *c, const char *data, size_t len)
+{
+    if (c->mpState == HTTP_MP_END)
+    {
+        return len;
+    }
+    if (c->mpState != HTTP_MP_DATA)
+    {
+        const char *nl = (const char *)memchr(data, '\n', len);
+        size_t n = nl ? nl - data + 1 : len;
+        if (!append(c->buf, c->bufLen, c->bufSize, data, n, false) || c->bufLen > HTTP_LINE_SIZE)
+        {
+            c->bufLen = 0; // 超长的行只能是前导内容, 丢弃
+        }
+        if (nl)
+        {
+            while (c->bufLen > 0 && (c->buf[c->bufLen - 1] == '\n' || c->buf[c->bufLen - 1] == '\r'))
+            {
+                c->bufLen--;
+            }
+            c->buf[c->bufLen] = 0;
+            c->bufLen = 0;
+            partLine(c, c->buf);
+        }
+        return n;
+    }
+
+    const char *delimiter = c->delimiter.c_str();
+    size_t delimiterLen = c->delimiter.length();
+    for (size_t i = 0; i < len; i++)
+    {
+        char ch = data[i];
+        if (ch == delimiter[c->mpMatch])
+        {
+            if (++c->mpMatch == delimiterLen)
+            {
+                c->mpMatch = 0;
+                partDone(c);
+                c->mpState = HTTP_MP_NEXT;
+                return i + 1;
+            }
+            continue;
+        }
+        for (uint8_t j = 0; j < c->mpMatch; j++)
+        {
+            if (c->mpFile)
+            {
+                uploadData->buf[uploadData->currentSize++] = delimiter[j];
+                if (uploadData->currentSize == HTTP_UPLOAD_BUFLEN)
+                {
+                    uploadCallback(c, UPLOAD_FILE_WRITE);
+                }
+            }
+            else
+            {
+                append(c->buf, c->bufLen, c->bufSize, delimiter + j, 1, false);
+            }
+        }
+        c->mpMatch = 0;
+        if (ch == delimiter[0])
+        {
+            c->mpMatch = 1;
+            continue;
+        }
+        if (c->mpFile)
+        {
+            uploadData->buf[uploadData->currentSize++] = ch;
+            if (uploadData->currentSize == HTTP_UPLOAD_BUFLEN)
+            {
+                uploadCallback(c, UPLOAD_FILE_WRITE);
+            }
+        }
+        else if (c->bufLen < HTTP_LINE_SIZE)
+        {
+            append(c->buf, c->bufLen, c->bufSize, &ch, 1, false);
+        }
+    }
+    return len;
+}
+
+void HttpServer::partLine(HttpClient *c, const char *line)
+{
+    if (c->mpState == HTTP_MP_BOUNDARY)
+    {
+        // 第一个分隔符前面没有 \r\n
+        const char *boundary = c->delimiter.c_str() + 2;
+        size_t boundaryLen = c->delimiter.length() - 2;
+        if (strncmp(line, boundary, boundaryLen) == 0)
+        {
+            c->mpState = strcmp(line + boundaryLen, "--") == 0 ? HTTP_MP_END : HTTP_MP_HEADER;
+            c->mpName = "";
+            if (uploadData)
+            {
+                uploadData->filename = "";
+            }
+        }
+        return;
+    }
+    if (c->mpState == HTTP_MP_NEXT)
+    {
+        c->mpState = strncmp(line, "--", 2) == 0 ? HTTP_MP_END : HTTP_MP_HEADER;
+        c->mpName = "";
+        if (uploadData)
+        {
+            uploadData->filename = "";
+        }
+        return;
+    }
+    // HTTP_MP_HEADER
+    if (line[0] != 0)
+    {
+        if (strncasecmp(line, "Content-Disposition:", 20) == 0)
+        {
+            c->mpName = headerParam(line, " name=\"", "\"");
+            String filename = headerParam(line, "filename=\"", "\"");
+            if (filename.length() > 0 && c->route && c->route->uploadFn)
+            {
+                if (!uploadData)
+                {
+                    uploadData = new HTTPUpload;
+                }
+                uploadData->filename = filename;
+                uploadData->name = c->mpName;
+                uploadData->type = "";
+            }
+        }
+        else if (strncasecmp(line, "Content-Type:", 13) == 0 && uploadData)
+        {
+            const char *type = line + 13;
+            while (*type == ' ')
+            {
+                type++;
+            }
+            uploadData->type = type;
+        }
+        return;
+    }
+    c->mpState = HTTP_MP_DATA;
+    c->mpMatch = 0;
+    c->bufLen = 0;
+    if (uploadData && uploadData->filename.length() > 0)
+    {
+        uploadData->totalSize = 0;
+        uploadData->currentSize = 0;
+        c->mpFile = true;
+        uploadCallback(c, UPLOAD_FILE_START);
+    }
+}
+
+void HttpServer::partDone(HttpClient *c)
+{
+    if (c->mpFile)
+    {
+        if (uploadData->currentSize > 0)
+        {
+            uploadCallback(c, UPLOAD_FILE_WRITE);
+        }
+        c->mpFile = false;
+        uploadCallback(c, UPLOAD_FILE_END);
+        return;
+    }
+    // 普通字段并入参数
+    if (c->mpName.length() > 0 && c->buf)
+    {
+        c->buf[c->bufLen] = 0;
+        if (c->query.length() > 0)
+        {
+            c->query += '&';
+        }
+        urlEncode(c->mpName, &c->query);
+        c->query += '=';
+        urlEncode(c->buf, &c->query);
+    }
+    c->bufLen = 0;
+}
+
+void HttpServer::uploadCallback(HttpClient *c, HTTPUploadStatus status)
+{
+    uploadData->status = status;
+    if (status == UPLOAD_FILE_WRITE)
+    {
+        uploadData->totalSize += uploadData->currentSize;
+    }
+    current = c;
+    c->route->uploadFn();
+    current = NULL;
+    if (status == UPLOAD_FILE_WRITE)
+    {
+        uploadData->currentSize = 0;
+    }
+}
+
+void HttpServer::dispatch(HttpClient *c)
+{
+    current = c;
+    lastUri = c->uri;
+    responseHeaders = "";
+    contentLength = CONTENT_LENGTH_NOT_SET;
+    responded = false;
+    if (c->route)
+    {
+        c->route->fn();
+    }
+    else if (notFoundFn)
+    {
+        notFoundFn();
+    }
+    else
+    {
+        send(404, "text/plain", String(F("Not found: ")) + c->uri);
+    }
+    if (!responded)
+    {
+        send(500, "text/plain", "");
+    }
+    current = NULL;
+    if (uploadClient == c)
+    {
+        uploadClient = NULL;
+    }
+    c->state = HTTP_STATE_SENDING;
+    c->time = millis();
+}
+
+void HttpServer::reject(HttpClient *c, int code)
+{
+    rejectCount++;
+    if (uploadClient == c)
+    {
+        uploadClient = NULL;
+    }
+    current = c;
+    responseHeaders = "";
+    contentLength = CONTENT_LENGTH_NOT_SET;
+    send(code, "text/plain", "");
+    current = NULL;
+    c->bufLen = 0;
+    c->state = HTTP_STATE_SENDING;
+    c->time = millis();
+}
+
+// 发送: 先写入连接的发送缓冲, 再按 lwIP 发送窗口交出去, 剩下的在 handleClient 里续发
+
+bool HttpServer::append(char *&data, size_t &len, size_t &size, const char *src, size_t n, bool progmem)
+{
+    if (len + n + 1 > size)
+    {
+        size_t newSize = (len + n + 1 + 255) & ~(size_t)255;
+        char *p = (char *)realloc(data, newSize);
+        if (!p)
+        {
+            return false;
+        }
+        data = p;
+        size = newSize;
+    }
+    if (progmem)
+    {
+        memcpy_P(data + len, src, n);
+    }
+    else
+    {
+        memcpy(data + len, src, n);
+    }
+    len += n;
+    return true;
+}
+
+void HttpServer::write(const char *data, size_t len, bool progmem)
+{
+    HttpClient *c = current;
+    if (!c || !c->pcb || len == 0)
+    {
+        return;
+    }
+    if (c->txPos > 0)
+    {
+        // 已交出的部分移走, 缓冲只保存未交出的数据
+        memmove(c->tx, c->tx + c->txPos, c->txLen - c->txPos);
+        c->txLen -= c->txPos;
+        c->txPos = 0;
+    }
+    if (!append(c->tx, c->txLen, c->txSize, data, len, progmem))
+    {
+        disconnect(c);
+        return;
+    }
+    txTotal += len;
+    flush(c);
+    // 缓冲超过上限时等对方确认, 正常客户端几个 RTT 就能收完; 对方不收就断开, loop 最多停 HTTP_TX_WAIT
+    uint32_t start = millis();
+    while (txTotal > HTTP_TX_MAX && c->pcb && c->txPos < c->txLen)
+    {
+        if (millis() - start >= HTTP_TX_WAIT)
+        {
+            rejectCount++;
+            disconnect(c);
+            return;
+        }
+        delay(1);
+        flush(c);
+    }
+}
+
+void HttpServer::flush(HttpClient *c)
+{
+    if (!c->pcb || c->txPos == c->txLen)
+    {
+        return;
+    }
+    size_t n = c->txLen - c->txPos;
+    size_t room = tcp_sndbuf(c->pcb);
+    if (n > room)
+    {
+        n = room;
+    }
+    if (n == 0 || tcp_write(c->pcb, c->tx + c->txPos, n, TCP_WRITE_FLAG_COPY) != ERR_OK)
+    {
+        return;
+    }
+    tcp_output(c->pcb);
+    c->txPos += n;
+    txTotal -= n;
+    c->time = millis();
+}
+
+void HttpServer::close(HttpClient *c)
+{
+    tcp_pcb *pcb = c->pcb;
+    tcp_arg(pcb, NULL);
+    tcp_recv(pcb, NULL);
+    tcp_sent(pcb, NULL);
+    tcp_err(pcb, NULL);
+    while (c->rx)
+    {
+        consume(c, c->rx->len - c->rxOffset);
+    }
+    c->pcb = NULL;
+    if (tcp_close(pcb) != ERR_OK)
+    {
+        tcp_abort(pcb);
+    }
+    release(c);
+}
+
+// 断开但保留连接数据, 处理函数中也可以调用, 由 handleClient 清理
+void HttpServer::disconnect(HttpClient *c)
+{
+    tcp_pcb *pcb = c->pcb;
+    if (pcb)
+    {
+        tcp_arg(pcb, NULL);
+        tcp_recv(pcb, NULL);
+        tcp_sent(pcb, NULL);
+        tcp_err(pcb, NULL);
+        c->pcb = NULL;
+        tcp_abort(pcb);
+    }
+}
+
+void HttpServer::abort(HttpClient *c)
+{
+    disconnect(c);
+    release(c);
+}
+
+void HttpServer::release(HttpClient *c)
+{
+    if (uploadClient == c)
+    {
+        if (c->mpFile)
+        {
+            c->mpFile = false;
+            uploadCallback(c, UPLOAD_FILE_ABORTED);
+        }
+        uploadClient = NULL;
+    }
+    if (!uploadClient && uploadData)
+    {
+        delete uploadData;
+        uploadData = NULL;
+    }
+    if (c->rx)
+    {
+        pbuf_free(c->rx);
+        c->rx = NULL;
+    }
+    txTotal -= c->txLen - c->txPos;
+    free(c->tx);
+    free(c->buf);
+    c->tx = NULL;
+    c->buf = NULL;
+    c->txLen = c->txPos = c->txSize = 0;
+    c->bufLen = c->bufSize = 0;
+    c->pcb = NULL;
+    c->uri = "";
+    c->query = "";
+    c->host = "";
+    c->auth = "";
+    c->delimiter = "";
+    c->mpName = "";
+    c->state = HTTP_STATE_FREE;
+    clientCount--;
+}
+
+// 请求信息: 只在处理函数/上传回调中有效
+
+String HttpServer::uri()
+{
+    return lastUri;
+}
+
+HTTPMethod HttpServer::method()
+{
+    return current ? (HTTPMethod)current->method : HTTP_ANY;
+}
+
+bool HttpServer::nextArg(const char *&p, String *key, String *value)
+{
+    while (*p == '&')
+    {
+        p++;
+    }
+    if (*p == 0)
+    {
+        return false;
+    }
+    const char *end = strchr(p, '&');
+    if (!end)
+    {
+        end = p + strlen(p);
+    }
+    const char *eq = (const char *)memchr(p, '=', end - p);
+    if (key)
+    {
+        urlDecode(p, (eq ? eq : end) - p, key);
+    }
+    if (value)
+    {
+        if (eq)
+        {
+            urlDecode(eq + 1, end - eq - 1, value);
+        }
+        else
+        {
+            *value = "";
+        }
+    }
+    p = end;
+    return true;
+}
+
+String HttpServer::arg(const String &name)
+{
+    String key, value;
+    if (current)
+    {
+        const char *p = current->query.c_str();
+        while (nextArg(p, &key, &value))
+        {
+            if (key == name)
+            {
+                return value;
+            }
+        }
+    }
+    return "";
+}
+
+String HttpServer::arg(int i)
+{
+    String value;
+    if (current)
+    {
+        const char *p = current->query.c_str();
+        for (int n = 0; nextArg(p, NULL, &value); n++)
+        {
+            if (n == i)
+            {
+                return value;
+            }
+        }
+    }
+    return "";
+}
+
+String HttpServer::argName(int i)
+{
+    String key;
+    if (current)
+    {
+        const char *p = current->query.c_str();
+        for (int n = 0; nextArg(p, &key, NULL); n++)
+        {
+            if (n == i)
+            {
+                return key;
+            }
+        }
+    }
+    return "";
+}
+
+int HttpServer::args()
+{
+    int n = 0;
+    if (current)
+    {
+        const char *p = current->query.c_str();
+        while (nextArg(p, NULL, NULL))
+        {
+            n++;
+        }
+    }
+    return n;
+}
+
+bool HttpServer::hasArg(const String &name)
+{
+    String key;
+    if (current)
+    {
+        const char *p = current->query.c_str();
+        while (nextArg(p, &key, NULL))
+        {
+            if (key == name)
+            {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+String HttpServer::hostHeader()
+{
+    return current ? current->host : String("");
+}
+
+IPAddress HttpServer::localIP()
+{
+    if (!current || !current->pcb)
+    {
+        return IPAddress();
+    }
+    return IPAddress(ip4_addr_get_u32(ip_2_ip4(&current->pcb->local_ip)));
+}
+
+HTTPUpload &HttpServer::upload()
+{
+    return *uploadData;
+}
+
+bool HttpServer::authenticate(const char *user, const char *pass)
+{
+    if (!current || strncmp(current->auth.c_str(), "Basic ", 6) != 0)
+    {
+        return false;
+    }
+    String plain = user;
+    plain += ':';
+    plain += pass;
+    return base64(plain.c_str(), plain.length()) == (current->auth.c_str() + 6);
+}
+
+void HttpServer::requestAuthentication()
+{
+    sendHeader(F("WWW-Authenticate"), F("Basic realm=\"Login Required\""));
+    send(401, "text/html", F("401 Unauthorized"));
+}
+
+// 响应: 不用 chunked, 长度未知时靠关闭连接结束
+
+void HttpServer::setContentLength(size_t len)
+{
+    contentLength = len;
+}
+
+void HttpServer::sendHeader(const String &name, const String &value, bool first)
+{
+    String header = name;
+    header += F(": ");
+    header += value;
+    header += F("\r\n");
+    if (first)
+    {
+        responseHeaders = header + responseHeaders;
+    }
+    else
+    {
+        responseHeaders += header;
+    }
+}
+
+void HttpServer::send(int code, const char *contentType, const String &content)
+{
+    String head = F("HTTP/1.1 ");
+    head += String(code);
+    head += ' ';
+    head += statusText(code);
+    head += F("\r\n");
+    if (contentType && contentType[0])
+    {
+        head += F("Content-Type: ");
+        head += contentType;
+        head += F("\r\n");
+    }
+    if (contentLength == CONTENT_LENGTH_NOT_SET)
+    {
+        head += F("Content-Length: ");
+        head += String((unsigned int)content.length());
+        head += F("\r\n");
+    }
+    else if (contentLength != CONTENT_LENGTH_UNKNOWN)
+    {
+        head += F("Content-Length: ");
+        head += String((unsigned int)contentLength);
+        head += F("\r\n");
+    }
+    head += responseHeaders;
+    head += F("Connection: close\r\n\r\n");
+    responseHeaders = "";
+    responded = true;
+    write(head.c_str(), head.length());
+    write(content.c_str(), content.length());
+}
+
+void HttpServer::send(int code, const String &contentType, const String &content)
+{
+    send(code, contentType.c_str(), content);
+}
+
+void HttpServer::send_P(int code, PGM_P contentType, PGM_P content, size_t len)
+{
+    char type[64];
+    strncpy_P(type, contentType, sizeof(type) - 1);
+    type[sizeof(type) - 1] = 0;
+    send(code, type, "");
+    write(content, len, true);
+}
+
+void HttpServer::sendContent(const String &content)
+{
+    write(content.c_str(), content.length());
+}
+
+void HttpServer::sendContent_P(PGM_P content, size_t len)
+{
+    write(content, len, true);
+}
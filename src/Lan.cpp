@@ -0,0 +1,298 @@
+#include "Lan.h"
+#include "Config.h"
+#include "Debug.h"
+#include "Http.h"
+#include "Metrics.h"
+#include <ESP8266WiFi.h>
+#include <bearssl/bearssl_hmac.h>
+
+WiFiUDP Lan::udp;
+bool Lan::started = false;
+uint32_t Lan::localIp = 0;
+uint32_t Lan::session = 0;
+uint32_t Lan::seq = 0;
+uint8_t Lan::operationFlag = 0;
+LanPeer Lan::peers[LAN_PEERS];
+uint8_t Lan::peerCount = 0;
+char Lan::packet[LAN_PACKET_SIZE];
+
+uint32_t Lan::rxCount = 0;
+uint32_t Lan::cmdCount = 0;
+uint32_t Lan::authFail = 0;
+uint32_t Lan::dupCount = 0;
+uint32_t Lan::cmdTime = 0;
+
+void Lan::init()
+{
+    Metrics::add(PSTR("esp_lan_rx_total"), METRICS_COUNTER, &rxCount);
+    Metrics::add(PSTR("esp_lan_cmd_total"), METRICS_COUNTER, &cmdCount);
+    Metrics::add(PSTR("esp_lan_auth_fail_total"), METRICS_COUNTER, &authFail);
+    Metrics::add(PSTR("esp_lan_dup_total"), METRICS_COUNTER, &dupCount);
+    Metrics::add(PSTR("esp_lan_cmd_us"), METRICS_GAUGE, &cmdTime);
+    newSession();
+}
+
+/**
+ * 更换会话并清空序号记录, 之前截获的命令全部失效
+ */
+void Lan::newSession()
+{
+    do
+    {
+        session = RANDOM_REG32;
+    } while (session == 0);
+    seq = 0;
+    memset(peers, 0, sizeof(peers));
+    peerCount = 0;
+}
+
+void Lan::stop()
+{
+    if (started)
+    {
+        udp.stop();
+        started = false;
+    }
+    localIp = 0;
+}
+
+void Lan::sign(const char *data, size_t len, char *hex)
+{
+    br_hmac_key_context kc;
+    br_hmac_context ctx;
+    uint8_t out[32];
+    br_hmac_key_init(&kc, &br_sha256_vtable, globalConfig.lan_key, strlen(globalConfig.lan_key));
+    br_hmac_init(&ctx, &kc, LAN_MAC_LEN);
+    br_hmac_update(&ctx, data, len);
+    br_hmac_out(&ctx, out);
+    for (uint8_t i = 0; i < LAN_MAC_LEN; i++)
+    {
+        sprintf_P(hex + i * 2, PSTR("%02x"), out[i]);
+    }
+}
+
+/**
+ * isReply 为 true 时单播回复给当前数据包的发送者, 否则发送到组播
+ */
+void Lan::send(char type, const char *dst, uint32_t seq, String payload, bool isReply)
+{
+    int len = snprintf_P(packet, sizeof(packet) - LAN_MAC_LEN * 2, PSTR("ESP1|%c|%s|%s|%08x:%u|%s|"), type, UID, dst, session, seq, payload.c_str());
+    if (len < 0 || len >= (int)sizeof(packet) - LAN_MAC_LEN * 2)
+    {
+        Debug.AddLog(LOG_LEVEL_ERROR, PSTR("LAN packet too long"));
+        return;
+    }
+    sign(packet, len, packet + len);
+    len += LAN_MAC_LEN * 2;
+
+    if (isReply)
+    {
+        udp.beginPacket(udp.remoteIP(), udp.remotePort());
+    }
+    else
+    {
+        udp.beginPacketMulticast(LAN_GROUP, LAN_PORT, WiFi.localIP());
+    }
+    udp.write((const uint8_t *)packet, len);
+    udp.endPacket();
+}
+
+/**
+ * 同一会话内同一控制端的命令序号必须递增, 用于去重和防止重放
+ * 记录满时不淘汰单个控制端 (淘汰后它的旧命令可以重放), 而是执行本条命令后更换会话
+ * 拒绝时 last 为该控制端最后执行的序号
+ */
+bool Lan::checkSeq(const char *src, uint32_t seq, uint32_t *last)
+{
+    uint32_t hash = 2166136261UL;
+    while (*src)
+    {
+        hash ^= (uint8_t)*src++;
+        hash *= 16777619UL;
+    }
+    if (hash == 0)
+    {
+        hash = 1;
+    }
+    for (uint8_t i = 0; i < peerCount; i++)
+    {
+        if (peers[i].hash == hash)
+        {
+            if (seq <= peers[i].seq)
+            {
+                *last = peers[i].seq;
+                return false;
+            }
+            peers[i].seq = seq;
+            return true;
+        }
+    }
+    if (peerCount >= LAN_PEERS)
+    {
+        Debug.AddLog(LOG_LEVEL_INFO, PSTR("LAN peers full, new session"));
+        newSession();
+        return true;
+    }
+    peers[peerCount].hash = hash;
+    peers[peerCount].seq = seq;
+    peerCount++;
+    return true;
+}
+
+String Lan::getStatus()
+{
+    return "{" + module->httpGetStatus(Http::server) + "}";
+}
+
+void Lan::handle(int len)
+{
+    packet[len] = '\0';
+    // 拆分 7 个字段
+    char *field[7];
+    uint8_t n = 0;
+    char *p = packet;
+    field[n++] = p;
+    while (n < 7 && (p = strchr(p, '|')) != NULL)
+    {
+        *p++ = '\0';
+        field[n++] = p;
+    }
+    if (n != 7 || strcmp_P(field[0], PSTR("ESP1")) != 0 || strlen(field[1]) != 1 || strlen(field[6]) != LAN_MAC_LEN * 2)
+    {
+        return;
+    }
+
+    // 签名覆盖 HMAC 之前的全部内容
+    size_t signLen = field[6] - packet;
+    for (uint8_t i = 1; i < 7; i++)
+    {
+        field[i][-1] = '|';
+    }
+    char mac[LAN_MAC_LEN * 2 + 1];
+    sign(packet, signLen, mac);
+    uint8_t diff = 0;
+    for (uint8_t i = 0; i < LAN_MAC_LEN * 2; i++)
+    {
+        diff |= mac[i] ^ field[6][i];
+    }
+    for (uint8_t i = 1; i < 7; i++)
+    {
+        field[i][-1] = '\0';
+    }
+    if (diff != 0)
+    {
+        authFail++;
+        Debug.AddLog(LOG_LEVEL_DEBUG, PSTR("LAN bad mac from %s"), udp.remoteIP().toString().c_str());
+        return;
+    }
+
+    // 回复时 packet 会被覆盖, 先复制源 UID
+    char src[24];
+    strncpy(src, field[2], sizeof(src) - 1);
+    src[sizeof(src) - 1] = '\0';
+    const char *dst = field[3];
+    if (strcmp(src, UID) == 0 || (strcmp(dst, "*") != 0 && strcmp(dst, UID) != 0))
+    {
+        return;
+    }
+    rxCount++;
+    // 序号字段: 会话(十六进制):序号, 没有会话时为 0
+    char *end;
+    uint32_t rxSession = strtoul(field[4], &end, 16);
+    uint32_t rxSeq = *end == ':' ? strtoul(end + 1, NULL, 10) : 0;
+
+    switch (field[1][0])
+    {
+    case 'C':
+    {
+        // 广播命令无法带各设备的会话, 一律拒绝
+        if (strcmp(dst, UID) != 0)
+        {
+            dupCount++;
+            return;
+        }
+        uint32_t last = 0;
+        if (rxSession != session || !checkSeq(src, rxSeq, &last))
+        {
+            // 告知当前会话和最后执行的序号, 由控制端重发
+            dupCount++;
+            send('N', src, rxSeq, String(last), true);
+            return;
+        }
+        uint32_t start = micros();
+        uint8_t count = Http::batchDo(field[5]);
+        cmdTime = micros() - start;
+        cmdCount++;
+        Debug.AddLog(LOG_LEVEL_INFO, PSTR("LAN %s #%u: %d ops %dus"), src, rxSeq, count, cmdTime);
+        char head[24];
+        snprintf_P(head, sizeof(head), PSTR("%d;%u;"), count, cmdTime);
+        send('R', src, rxSeq, head + getStatus(), true);
+        stateChanged();
+        break;
+    }
+    case 'D':
+        send('A', src, rxSeq, module->getModuleName() + "," + WiFi.localIP().toString() + "," + VERSION, true);
+        break;
+    default:
+        Debug.AddLog(LOG_LEVEL_DEBUG_MORE, PSTR("LAN %c from %s: %s"), field[1][0], src, field[5]);
+        break;
+    }
+}
+
+void Lan::stateChanged()
+{
+    bitSet(operationFlag, 1);
+}
+
+void Lan::perSecondDo()
+{
+    if (perSecond % LAN_ANNOUNCE_INTERVAL == 0)
+    {
+        bitSet(operationFlag, 0);
+        bitSet(operationFlag, 1);
+    }
+}
+
+void Lan::loop()
+{
+    if (globalConfig.lan_key[0] == '\0' || !WiFi.isConnected())
+    {
+        stop();
+        return;
+    }
+    if (localIp != (uint32_t)WiFi.localIP())
+    {
+        // 获取到新IP时重新加入组播, 失败时等下次IP变化
+        stop();
+        localIp = WiFi.localIP();
+        started = udp.beginMulticast(WiFi.localIP(), LAN_GROUP, LAN_PORT);
+        Debug.AddLog(LOG_LEVEL_INFO, PSTR("LAN multicast %s:%d %s"), LAN_GROUP.toString().c_str(), LAN_PORT, started ? "OK" : "Error");
+        bitSet(operationFlag, 0);
+        bitSet(operationFlag, 1);
+        if (!started)
+        {
+            return;
+        }
+    }
+
+    int len = udp.parsePacket();
+    if (len > 0)
+    {
+        len = udp.read(packet, sizeof(packet) - 1);
+        if (len > 0)
+        {
+            handle(len);
+        }
+    }
+
+    if (bitRead(operationFlag, 0))
+    {
+        bitClear(operationFlag, 0);
+        send('A', "*", ++seq, module->getModuleName() + "," + WiFi.localIP().toString() + "," + VERSION, false);
+    }
+    if (bitRead(operationFlag, 1))
+    {
+        bitClear(operationFlag, 1);
+        send('S', "*", ++seq, getStatus(), false);
+    }
+}
@@ -5,11 +5,24 @@
 #include <Ticker.h>
 #include <ESP8266WiFi.h>
 
+const LedPattern LED_WIFI PROGMEM = {0, 0, 2, {LED_ON_MS(200), LED_OFF_MS(200)}};
+const LedPattern LED_MQTT PROGMEM = {0, 0, 2, {LED_ON_MS(300), LED_OFF_MS(300)}};
+const LedPattern LED_ONLINE PROGMEM = {0, 0, 2, {LED_OFF_MS(4800), LED_ON_MS(200)}};
+const LedPattern LED_MODULE PROGMEM = {0, 0, 1, {LED_ON_MS(1000)}};
+const LedPattern LED_CONNECTED PROGMEM = {2, 8, 2, {LED_ON_MS(40), LED_OFF_MS(40)}};
+const LedPattern LED_NOTICE PROGMEM = {2, 5, 2, {LED_ON_MS(200), LED_OFF_MS(200)}};
+const LedPattern LED_LOGIN PROGMEM = {2, 10, 2, {LED_ON_MS(100), LED_OFF_MS(100)}};
+const LedPattern LED_RESTART PROGMEM = {3, 4, 2, {LED_ON_MS(400), LED_OFF_MS(400)}};
+
 Ticker *Led::ledTicker;
-Ticker *Led::ledTicker2;
 uint8_t Led::io = 99;
 uint8_t Led::light;
 uint8_t Led::ledType = 0;
+LedPattern Led::base;
+LedPattern Led::current;
+uint8_t Led::stepIndex = 0;
+uint8_t Led::repeatLeft = 0;
+bool Led::playing = false;
 
 void Led::init(uint8_t _io, uint8_t _light)
 {
@@ -19,9 +32,8 @@ void Led::init(uint8_t _io, uint8_t _light)
 
     Led::ledType = 0;
     ledTicker = new Ticker();
-    ledTicker2 = new Ticker();
     digitalWrite(io, !light);
-    ledTicker->attach(0.2, []() { digitalWrite(io, !digitalRead(io)); });
+    setBase(&LED_WIFI);
 }
 
 void Led::loop()
@@ -32,15 +44,18 @@ void Led::loop()
     }
     if (module && module->moduleLed())
     {
-        digitalWrite(io, light);
-        Led::ledType = 3;
+        if (Led::ledType != 3)
+        {
+            Led::ledType = 3;
+            setBase(&LED_MODULE);
+        }
     }
     else if (WiFi.status() != WL_CONNECTED)
     {
         if (Led::ledType != 0)
         {
             Led::ledType = 0;
-            ledTicker->attach(0.2, []() { digitalWrite(io, !digitalRead(io)); });
+            setBase(&LED_WIFI);
         }
     }
     else if (!mqtt->mqttClient.connected())
@@ -48,7 +63,7 @@ void Led::loop()
         if (Led::ledType != 1)
         {
             Led::ledType = 1;
-            ledTicker->attach(0.3, []() { digitalWrite(io, !digitalRead(io)); });
+            setBase(&LED_MQTT);
         }
     }
     else
@@ -56,34 +71,84 @@ void Led::loop()
         if (Led::ledType != 2)
         {
             Led::ledType = 2;
-            ledTicker->attach(5, led, 200);
+            setBase(&LED_ONLINE);
         }
     }
 }
 
-void Led::led(int ms)
+/**
+ * 切换状态指示, 一次性样式播放中时等其结束后生效
+ */
+void Led::setBase(const LedPattern *pattern)
+{
+    memcpy_P(&base, pattern, sizeof(LedPattern));
+    if (!playing)
+    {
+        start(base);
+    }
+}
+
+void Led::start(const LedPattern &pattern)
+{
+    current = pattern;
+    stepIndex = 0;
+    repeatLeft = pattern.repeat;
+    step();
+}
+
+void Led::step()
+{
+    uint16_t s = current.steps[stepIndex];
+    digitalWrite(io, (s & 0x8000) ? light : !light);
+    ledTicker->once_ms(s & 0x7FFF, next);
+}
+
+void Led::next()
 {
-    if (io != 99)
+    if (++stepIndex >= current.count)
     {
-        digitalWrite(io, light);
-        ledTicker2->once_ms(ms, []() { digitalWrite(io, !light); });
+        stepIndex = 0;
+        if (current.repeat != 0 && --repeatLeft == 0)
+        {
+            playing = false;
+            start(base);
+            return;
+        }
     }
+    step();
 }
 
-void Led::blinkLED(int duration, int n)
+/**
+ * 播放一次性样式, 优先级低于正在播放的样式时忽略
+ */
+void Led::play(const LedPattern *pattern)
 {
     if (io == 99)
     {
         return;
     }
-    for (int i = 0; i < n; i++)
+    LedPattern tmp;
+    memcpy_P(&tmp, pattern, sizeof(LedPattern));
+    if (playing && tmp.priority < current.priority)
     {
-        digitalWrite(io, light);
-        delay(duration);
-        digitalWrite(io, !light);
-        if (n != i + 1)
-        {
-            delay(duration);
-        }
+        return;
+    }
+    playing = true;
+    start(tmp);
+}
+
+bool Led::isPlaying()
+{
+    return playing;
+}
+
+void Led::led(int ms)
+{
+    if (io == 99 || (playing && current.priority > 1))
+    {
+        return;
     }
+    playing = true;
+    LedPattern flash = {1, 1, 1, {(uint16_t)LED_ON_MS(ms & 0x7FFF)}};
+    start(flash);
 }
@@ -0,0 +1,107 @@
+#include "Metrics.h"
+#include "Debug.h"
+
+MetricsEntry Metrics::entries[METRICS_MAX];
+uint8_t Metrics::count = 0;
+uint32_t Metrics::loopTime = 0;
+uint32_t Metrics::loopTimeMax = 0;
+uint32_t Metrics::webLogDrop = 0;
+
+static uint32_t getFreeHeap()
+{
+    return ESP.getFreeHeap();
+}
+
+static uint32_t getMaxFreeBlock()
+{
+    return ESP.getMaxFreeBlockSize();
+}
+
+static uint32_t getUptime()
+{
+    return millis() / 1000;
+}
+
+void Metrics::init()
+{
+    add(PSTR("esp_heap_free_bytes"), METRICS_GAUGE, getFreeHeap);
+    add(PSTR("esp_heap_max_block_bytes"), METRICS_GAUGE, getMaxFreeBlock);
+    add(PSTR("esp_uptime_seconds"), METRICS_COUNTER, getUptime);
+    add(PSTR("esp_loop_time_us"), METRICS_GAUGE, &loopTime);
+    add(PSTR("esp_loop_time_max_us"), METRICS_GAUGE, &loopTimeMax);
+    add(PSTR("esp_weblog_drop_total"), METRICS_COUNTER, &webLogDrop);
+    add(PSTR("esp_log_text_total"), METRICS_COUNTER, &Debug.textCount);
+    add(PSTR("esp_log_text_cycles_total"), METRICS_COUNTER, &Debug.textCycles);
+    add(PSTR("esp_log_text_bytes_total"), METRICS_COUNTER, &Debug.textBytes);
+    add(PSTR("esp_log_bin_total"), METRICS_COUNTER, &Debug.binCount);
+    add(PSTR("esp_log_bin_cycles_total"), METRICS_COUNTER, &Debug.binCycles);
+    add(PSTR("esp_log_bin_bytes_total"), METRICS_COUNTER, &Debug.binBytes);
+    add(PSTR("esp_log_bin_drop_bytes_total"), METRICS_COUNTER, &Debug.binDrop);
+    add(PSTR("esp_log_serial_drop_total"), METRICS_COUNTER, &Debug.serialTx.drop);
+    add(PSTR("esp_log_serial1_drop_total"), METRICS_COUNTER, &Debug.serial1Tx.drop);
+}
+
+boolean Metrics::add(PGM_P name, uint8_t type, const uint32_t *value)
+{
+    if (count >= METRICS_MAX)
+    {
+        Debug.AddLog(LOG_LEVEL_ERROR, PSTR("Metrics full"));
+        return false;
+    }
+    entries[count].name = name;
+    entries[count].type = type;
+    entries[count].value = value;
+    entries[count].getter = NULL;
+    count++;
+    return true;
+}
+
+boolean Metrics::add(PGM_P name, uint8_t type, uint32_t (*getter)())
+{
+    if (!add(name, type, (const uint32_t *)NULL))
+    {
+        return false;
+    }
+    entries[count - 1].getter = getter;
+    return true;
+}
+
+void Metrics::loopDone(uint32_t start)
+{
+    loopTime = micros() - start;
+    if (loopTime > loopTimeMax)
+    {
+        loopTimeMax = loopTime;
+    }
+}
+
+size_t Metrics::format(char *buf, uint8_t i, uint32_t value)
+{
+    char name[48];
+    strncpy_P(name, entries[i].name, sizeof(name));
+    name[sizeof(name) - 1] = '\0';
+    int len = snprintf_P(buf, METRICS_LINE_SIZE, PSTR("# TYPE %s %s\n%s %u\n"), name, entries[i].type == METRICS_COUNTER ? "counter" : "gauge", name, value);
+    return len < METRICS_LINE_SIZE ? len : METRICS_LINE_SIZE - 1;
+}
+
+/**
+ * 先快照所有值并算出总长度，再按 Content-Length 逐行输出，避免 chunked 和 String 的堆分配
+ */
+void Metrics::handle(HttpServer *server)
+{
+    uint32_t values[METRICS_MAX];
+    char line[METRICS_LINE_SIZE];
+    size_t total = 0;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        values[i] = entries[i].getter ? entries[i].getter() : *entries[i].value;
+        total += format(line, i, values[i]);
+    }
+
+    server->setContentLength(total);
+    server->send_P(200, PSTR("text/plain; version=0.0.4"), "", 0);
+    for (uint8_t i = 0; i < count; i++)
+    {
+        server->sendContent_P(line, format(line, i, values[i]));
+    }
+}
@@ -3,8 +3,16 @@
 #include "Debug.h"
 #include "Mqtt.h"
 #include "Ntp.h"
+#include "Metrics.h"
+#include "Wifi.h"
 #include <PubSubClient.h>
 
+Mqtt::Mqtt()
+{
+    Metrics::add(PSTR("esp_mqtt_connect_total"), METRICS_COUNTER, &connectCount);
+    Metrics::add(PSTR("esp_mqtt_publish_fail_total"), METRICS_COUNTER, &publishFailCount);
+}
+
 bool Mqtt::mqttConnect()
 {
     if (WiFi.status() != WL_CONNECTED)
@@ -28,6 +36,7 @@ bool Mqtt::mqttConnect()
     if (mqttClient.connect(UID, globalConfig.mqtt.user, globalConfig.mqtt.pass, getTeleTopic(F("availability")).c_str(), 0, false, "offline"))
     {
         Debug.AddLog(LOG_LEVEL_INFO, PSTR("(Re)Connected."));
+        connectCount++;
         if (_connectedCallback != NULL)
         {
             _connectedCallback();
@@ -43,9 +52,11 @@ bool Mqtt::mqttConnect()
 
 void Mqtt::doReport()
 {
-    char message[250];
-    sprintf(message, "{\"UID\":\"%s\",\"SSID\":\"%s\",\"RSSI\":\"%s\",\"Version\":\"%s\",\"ip\":\"%s\",\"mac\":\"%s\",\"freeMem\":%d,\"uptime\":%d}",
-            UID, WiFi.SSID().c_str(), String(WiFi.RSSI()).c_str(), VERSION, WiFi.localIP().toString().c_str(), WiFi.macAddress().c_str(), ESP.getFreeHeap(), millis() / 1000);
+    char message[400];
+    uint64_t nowMs = Ntp::nowMs();
+    sprintf(message, "{\"UID\":\"%s\",\"SSID\":\"%s\",\"RSSI\":\"%s\",\"Version\":\"%s\",\"ip\":\"%s\",\"mac\":\"%s\",\"freeMem\":%d,\"uptime\":%d,\"time\":%u.%03u,\"link\":%s}",
+            UID, WiFi.SSID().c_str(), String(WiFi.RSSI()).c_str(), VERSION, WiFi.localIP().toString().c_str(), WiFi.macAddress().c_str(), ESP.getFreeHeap(), millis() / 1000,
+            (uint32_t)(nowMs / 1000), (uint32_t)(nowMs % 1000), Wifi::linkSummary().c_str());
     Debug.AddLog(LOG_LEVEL_INFO, PSTR("%s"), message);
     publish(getTeleTopic(F("HEARTBEAT")), message);
 
@@ -104,6 +115,11 @@ String Mqtt::getCmndTopic(String topic)
     return topicCmnd + topic;
 }
 
+String Mqtt::getCmndTopic(String topic, const char *hostname)
+{
+    return getTopic(0, topic, hostname);
+}
+
 String Mqtt::getStatTopic(String topic)
 {
     return topicStat + topic;
@@ -128,39 +144,48 @@ PubSubClient &Mqtt::setClient(Client &client)
     setTopic();
     return mqttClient.setClient(client);
 }
+boolean Mqtt::publishResult(boolean result)
+{
+    if (!result)
+    {
+        publishFailCount++;
+    }
+    return result;
+}
+
 boolean Mqtt::publish(String topic, const char *payload)
 {
-    return mqttClient.publish(topic.c_str(), payload);
+    return publishResult(mqttClient.publish(topic.c_str(), payload));
 }
 
 boolean Mqtt::publish(String topic, const char *payload, boolean retained)
 {
-    return mqttClient.publish(topic.c_str(), payload, retained);
+    return publishResult(mqttClient.publish(topic.c_str(), payload, retained));
 }
 
 boolean Mqtt::publish(const char *topic, const char *payload)
 {
-    return mqttClient.publish(topic, payload);
+    return publishResult(mqttClient.publish(topic, payload));
 }
 boolean Mqtt::publish(const char *topic, const char *payload, boolean retained)
 {
-    return mqttClient.publish(topic, payload, retained);
+    return publishResult(mqttClient.publish(topic, payload, retained));
 }
 boolean Mqtt::publish(const char *topic, const uint8_t *payload, unsigned int plength)
 {
-    return mqttClient.publish(topic, payload, plength);
+    return publishResult(mqttClient.publish(topic, payload, plength));
 }
 boolean Mqtt::publish(const char *topic, const uint8_t *payload, unsigned int plength, boolean retained)
 {
-    return mqttClient.publish(topic, payload, plength, retained);
+    return publishResult(mqttClient.publish(topic, payload, plength, retained));
 }
 boolean Mqtt::publish_P(const char *topic, const char *payload, boolean retained)
 {
-    return mqttClient.publish_P(topic, payload, retained);
+    return publishResult(mqttClient.publish_P(topic, payload, retained));
 }
 boolean Mqtt::publish_P(const char *topic, const uint8_t *payload, unsigned int plength, boolean retained)
 {
-    return mqttClient.publish_P(topic, payload, plength, retained);
+    return publishResult(mqttClient.publish_P(topic, payload, plength, retained));
 }
 
 boolean Mqtt::subscribe(String topic)
@@ -176,7 +201,7 @@ boolean Mqtt::unsubscribe(String topic)
     return mqttClient.unsubscribe(topic.c_str());
 }
 
-String Mqtt::getTopic(uint8_t prefix, String subtopic)
+String Mqtt::getTopic(uint8_t prefix, String subtopic, const char *hostname)
 {
     // 0: Cmnd  1:Stat 2:Tele
     String fulltopic = String(globalConfig.mqtt.topic);
@@ -185,7 +210,7 @@ String Mqtt::getTopic(uint8_t prefix, String subtopic)
         fulltopic += F("/%prefix%"); // Need prefix for commands to handle mqtt topic loops
     }
     fulltopic.replace(F("%prefix%"), (prefix == 0 ? F("cmnd") : ((prefix == 1 ? F("stat") : F("tele")))));
-    fulltopic.replace(F("%hostname%"), UID);
+    fulltopic.replace(F("%hostname%"), hostname ? hostname : UID);
     fulltopic.replace(F("%module%"), module->getModuleName());
     fulltopic.replace(F("#"), "");
     fulltopic.replace(F("//"), "/");
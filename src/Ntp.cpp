@@ -3,10 +3,18 @@
 #include "sntp.h"
 #include "Debug.h"
 #include <ESP8266WiFi.h>
+#include <sys/time.h>
+#include <coredecls.h>
 
 TIME_T Ntp::rtcTime;
 uint32_t Ntp::utcTime;
 uint8_t Ntp::operationFlag = 0;
+uint64_t Ntp::baseMicros = 0;
+uint64_t Ntp::baseUtc = 0;
+int32_t Ntp::freqPpb = 0;
+int32_t Ntp::slewUs = 0;
+int32_t Ntp::lastOffset = 0;
+uint8_t Ntp::sampleCount = 0;
 static const uint8_t kDaysInMonth[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31}; // API starts months from 1, this array starts from 0
 static const char kMonthNamesEnglish[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
 
@@ -87,19 +95,21 @@ String Ntp::timeSince(uint32_t const start)
     return msToHumanString(diff) + " ago";
 }
 
-void Ntp::breakTime(uint32_t time_input, TIME_T &tm)
+static uint8_t monthLength(uint16_t year, uint8_t month)
 {
-    // break the given time_input into time components
-    // this is a more compact version of the C library localtime function
-    // note that year is offset from 1970 !!!
-
-    uint8_t year;
-    uint8_t month;
-    uint8_t month_length;
-    uint32_t time;
-    unsigned long days;
+    if (month == 2 && ((year % 4 == 0 && year % 100 != 0) || year % 400 == 0))
+    {
+        return 29;
+    }
+    return kDaysInMonth[month - 1];
+}
 
-    time = time_input;
+/**
+ * 常数时间的日期换算 (days_from_civil 的逆运算)，只在 NTP 同步时调用
+ */
+void Ntp::breakTime(uint32_t time_input, TIME_T &tm)
+{
+    uint32_t time = time_input;
     tm.second = time % 60;
     time /= 60; // now it is minutes
     tm.minute = time % 60;
@@ -109,51 +119,55 @@ void Ntp::breakTime(uint32_t time_input, TIME_T &tm)
     tm.days = time;
     tm.day_of_week = ((time + 4) % 7) + 1; // Sunday is day 1
 
-    year = 0;
-    days = 0;
-    while ((unsigned)(days += (LEAP_YEAR(year) ? 366 : 365)) <= time)
-    {
-        year++;
-    }
-    tm.year = year + 1970; // year is offset from 1970
-
-    days -= LEAP_YEAR(year) ? 366 : 365;
-    time -= days; // now it is days in this year, starting at 0
-    tm.day_of_year = time;
-
-    days = 0;
-    month = 0;
-    month_length = 0;
-    for (month = 0; month < 12; month++)
-    {
-        if (1 == month)
-        { // february
-            if (LEAP_YEAR(year))
-            {
-                month_length = 29;
-            }
-            else
-            {
-                month_length = 28;
-            }
-        }
-        else
-        {
-            month_length = kDaysInMonth[month];
-        }
+    // 以 0000-03-01 为起点，400 年为一个周期
+    uint32_t z = time + 719468;
+    uint32_t era = z / 146097;
+    uint32_t doe = z - era * 146097;                                      // [0, 146096]
+    uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365; // [0, 399]
+    uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);               // 从 3 月 1 日起 [0, 365]
+    uint32_t mp = (5 * doy + 2) / 153;                                    // 3 月为 0
+    tm.day_of_month = doy - (153 * mp + 2) / 5 + 1;
+    tm.month = mp < 10 ? mp + 3 : mp - 9;
+    tm.year = yoe + era * 400 + (tm.month <= 2 ? 1 : 0);
+    tm.day_of_year = doy >= 306 ? doy - 306 : doy + 59 + (monthLength(tm.year, 2) == 29 ? 1 : 0);
+    tm.valid = (time_input > 1451602800); // 2016-01-01
+}
 
-        if (time >= month_length)
-        {
-            time -= month_length;
-        }
-        else
-        {
-            break;
-        }
+/**
+ * 每秒进位，不重新换算日期
+ */
+void Ntp::tick(TIME_T &tm)
+{
+    if (++tm.second < 60)
+    {
+        return;
     }
-    tm.month = month + 1;                 // jan is month 1
-    tm.day_of_month = time + 1;           // day of month
-    tm.valid = (time_input > 1451602800); // 2016-01-01
+    tm.second = 0;
+    if (++tm.minute < 60)
+    {
+        return;
+    }
+    tm.minute = 0;
+    if (++tm.hour < 24)
+    {
+        return;
+    }
+    tm.hour = 0;
+    tm.days++;
+    tm.day_of_week = tm.day_of_week % 7 + 1;
+    tm.day_of_year++;
+    if (++tm.day_of_month <= monthLength(tm.year, tm.month))
+    {
+        return;
+    }
+    tm.day_of_month = 1;
+    if (++tm.month <= 12)
+    {
+        return;
+    }
+    tm.month = 1;
+    tm.year++;
+    tm.day_of_year = 0;
 }
 
 void Ntp::loop()
@@ -172,26 +186,108 @@ void Ntp::getNtp()
         uint32_t ntp_time = sntp_get_current_timestamp();
         if (ntp_time > 1451602800)
         {
-            utcTime = ntp_time;
+            // sntp_get_current_timestamp只有秒且已含时区, gettimeofday有微秒但为UTC
+            struct timeval tv;
+            gettimeofday(&tv, nullptr);
+            int32_t tz = (int32_t)(ntp_time - (uint32_t)tv.tv_sec);
+            tz = (tz >= 0 ? tz + 450 : tz - 450) / 900 * 900;
+            sample((uint64_t)(tv.tv_sec + tz) * 1000000ULL + tv.tv_usec);
+
+            utcTime = nowUs() / 1000000;
             breakTime(utcTime, rtcTime);
-            Debug.AddLog(LOG_LEVEL_INFO, PSTR("NTP: %04d-%02d-%02d %02d:%02d:%02d"), rtcTime.year, rtcTime.month, rtcTime.day_of_month, rtcTime.hour, rtcTime.minute, rtcTime.second);
+            Debug.AddLog(LOG_LEVEL_INFO, PSTR("NTP: %04d-%02d-%02d %02d:%02d:%02d.%03d offset %dus freq %dppb"), rtcTime.year, rtcTime.month, rtcTime.day_of_month,
+                         rtcTime.hour, rtcTime.minute, rtcTime.second, millisecond(), lastOffset, freqPpb);
         }
     }
 }
 
+void Ntp::sample(uint64_t ntpUs)
+{
+    uint64_t now = micros64();
+    if (baseUtc == 0)
+    {
+        baseMicros = now;
+        baseUtc = ntpUs;
+        slewUs = lastOffset = 0;
+        sampleCount = 1;
+        return;
+    }
+
+    uint64_t local = nowUs();
+    int64_t offset = (int64_t)(ntpUs - local);
+    if (offset >= NTP_STEP_US || offset <= -NTP_STEP_US)
+    {
+        // 偏差过大直接跳变, 频率修正保留
+        baseMicros = now;
+        baseUtc = ntpUs;
+        slewUs = 0;
+        lastOffset = constrain(offset, (int64_t)-INT32_MAX, (int64_t)INT32_MAX);
+        sampleCount = 1;
+        return;
+    }
+
+    // 扣除上次尚未追完的偏差后, 剩余部分即为晶振频率误差累积
+    int64_t elapsed = (int64_t)(now - baseMicros);
+    int64_t limit = elapsed * NTP_SLEW_PPM / 1000000;
+    int64_t pending = (int64_t)slewUs - constrain((int64_t)slewUs, -limit, limit);
+    if (sampleCount > 0 && elapsed > 60000000)
+    {
+        int64_t ppb = (offset - pending) * 1000000000LL / elapsed;
+        freqPpb = constrain(freqPpb + ppb / 2, (int64_t)-NTP_FREQ_MAX_PPB, (int64_t)NTP_FREQ_MAX_PPB);
+    }
+
+    // 从当前时间重新起算, 偏差通过slew平滑追赶, 保证时间连续
+    baseMicros = now;
+    baseUtc = local;
+    slewUs = lastOffset = offset;
+    if (sampleCount < 255)
+    {
+        sampleCount++;
+    }
+}
+
+uint64_t Ntp::nowUs()
+{
+    if (baseUtc == 0)
+    {
+        return 0;
+    }
+    int64_t elapsed = (int64_t)(micros64() - baseMicros);
+    int64_t limit = elapsed * NTP_SLEW_PPM / 1000000;
+    int64_t slew = constrain((int64_t)slewUs, -limit, limit);
+    return baseUtc + elapsed + elapsed * freqPpb / 1000000000LL + slew;
+}
+
+uint16_t Ntp::millisecond()
+{
+    return baseUtc == 0 ? millis() % 1000 : (nowUs() / 1000) % 1000;
+}
+
+void Ntp::timeSet()
+{
+    // SNTP收到新时间, 回调里只置位, 采样放到loop里
+    bitSet(operationFlag, 0);
+}
+
 void Ntp::perSecondDo()
 {
-    bool isAdd = false;
-    if (utcTime == 0 || perSecond % 600 == 0)
+    if (baseUtc == 0)
     {
         bitSet(operationFlag, 0);
+        return;
+    }
+
+    uint32_t now = nowUs() / 1000000;
+    if (now == utcTime + 1)
+    {
+        tick(rtcTime);
     }
-    if (utcTime > 0)
+    else if (now != utcTime)
     {
-        utcTime += 1;
-        breakTime(utcTime, rtcTime);
-        //Debug.AddLog(LOG_LEVEL_INFO, PSTR("Ticker: %04d-%02d-%02d %02d:%02d:%02d"), rtcTime.year, rtcTime.month, rtcTime.day_of_month, rtcTime.hour, rtcTime.minute, rtcTime.second);
+        breakTime(now, rtcTime);
     }
+    utcTime = now;
+    rtcTime.valid = (utcTime > 1451602800);
 }
 
 void Ntp::init()
@@ -200,7 +296,8 @@ void Ntp::init()
     sntp_setservername(1, (char *)"203.107.6.88");
     sntp_setservername(2, (char *)"ntp3.aliyun.com");
     sntp_stop();
-    sntp_set_timezone(8);
+    sntp_set_timezone(NTP_TIMEZONE);
+    settimeofday_cb(timeSet);
     sntp_init();
     utcTime = 0;
 }
\ No newline at end of file
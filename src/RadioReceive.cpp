@@ -6,6 +6,7 @@
 #include "Relay.h"
 #include "Config.h"
 #include "Led.h"
+#include "Metrics.h"
 
 void RadioReceive::init(Relay *_relay, uint8_t io)
 {
@@ -13,6 +14,9 @@ void RadioReceive::init(Relay *_relay, uint8_t io)
     mySwitch = new RCSwitch();
     pinMode(io, INPUT);
     mySwitch->enableReceive(digitalPinToInterrupt(io));
+
+    Metrics::add(PSTR("esp_rf_receive_total"), METRICS_COUNTER, &receiveCount);
+    Metrics::add(PSTR("esp_rf_match_total"), METRICS_COUNTER, &matchCount);
 }
 
 void RadioReceive::study(uint8_t ch)
@@ -60,6 +64,7 @@ void RadioReceive::loop()
     }
     lastVaue = value;
     lastTime = millis();
+    receiveCount++;
 
     if (studyCH == 0)
     {
@@ -84,6 +89,7 @@ void RadioReceive::loop()
                 if (relay->config.study[(ch * 10) + i] == value)
                 {
                     isOk = true;
+                    matchCount++;
                     Debug.AddLog(LOG_LEVEL_INFO, PSTR("Received %d to channel %d"), value, ch + 1);
                     relay->switchRelay(ch, !relay->lastState[ch], true);
                     break;
@@ -116,7 +122,7 @@ void RadioReceive::loop()
 
         Debug.AddLog(LOG_LEVEL_INFO, PSTR("Received %d del to channel %d"), value, (ch) + 1);
         studyCH = 0;
-        Led::blinkLED(200, 5);
+        Led::play(&LED_NOTICE);
     }
     else if (studyCH >= 10) // 学习
     {
@@ -150,7 +156,7 @@ void RadioReceive::loop()
 
         Debug.AddLog(LOG_LEVEL_INFO, PSTR("Received %d study to channel %d"), value, (ch) + 1);
         studyCH = 0;
-        Led::blinkLED(200, 5);
+        Led::play(&LED_NOTICE);
     }
 }
 
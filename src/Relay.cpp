@@ -2,12 +2,17 @@
 
 #include "Debug.h"
 #include "Relay.h"
-#include "RelayButton.h"
+#include "Button.h"
+#include "Wifi.h"
 #include "RadioReceive.h"
 #include "Config.h"
 #include "Mqtt.h"
 #include "Ntp.h"
 #include "Led.h"
+#include "Http.h"
+#include "Lan.h"
+#include "Metrics.h"
+#include <bearssl/bearssl_hmac.h>
 
 #pragma region 继承
 
@@ -43,7 +48,6 @@ void Relay::init()
         radioReceive->init(this, GPIO_PIN[GPIO_RFRECV]);
     }
     Relay::channels = 0;
-    btns = new RelayButton[4];
     for (uint8_t ch = 0; ch < 4; ch++)
     {
         if (GPIO_PIN[GPIO_REL1 + ch] == 99)
@@ -59,7 +63,7 @@ void Relay::init()
         }
         if (GPIO_PIN[GPIO_KEY1 + ch] != 99)
         {
-            btns[ch].init(this, ch, GPIO_PIN[GPIO_KEY1 + ch]);
+            Button::add(GPIO_PIN[GPIO_KEY1 + ch], BUTTON_MODE_TOGGLE, buttonCallback, ch);
         }
     }
 
@@ -80,7 +84,25 @@ void Relay::init()
         }
     }
 
+    Metrics::add(PSTR("esp_relay_led_us_total"), METRICS_COUNTER, &ledTime);
+    Metrics::add(PSTR("esp_relay_led_write_total"), METRICS_COUNTER, &ledWrites);
+
+    // 绑定对象始终创建, 指标只在这里注册一次; 没有绑定条目时不启动 ESP-NOW
+    espNow = new EspNowRadio();
+    binding = new RelayBinding(espNow, RANDOM_REG32);
+    binding->switchCallback = bindingSwitch;
+    binding->fallbackCallback = bindingFallback;
+    binding->signCallback = bindingSign;
+    Metrics::add(PSTR("esp_binding_sent_total"), METRICS_COUNTER, &binding->sentCount);
+    Metrics::add(PSTR("esp_binding_ack_total"), METRICS_COUNTER, &binding->ackCount);
+    Metrics::add(PSTR("esp_binding_retry_total"), METRICS_COUNTER, &binding->retryCount);
+    Metrics::add(PSTR("esp_binding_fallback_total"), METRICS_COUNTER, &binding->fallbackCount);
+    Metrics::add(PSTR("esp_binding_reject_total"), METRICS_COUNTER, &binding->rejectCount);
+    Metrics::add(PSTR("esp_binding_resync_total"), METRICS_COUNTER, &binding->resyncCount);
+    Metrics::add(PSTR("esp_binding_latency_us"), METRICS_GAUGE, &binding->latency);
+
     checkCanLed(true);
+    bindingInit();
 }
 
 String Relay::getModuleName()
@@ -104,17 +126,11 @@ bool Relay::moduleLed()
 
 void Relay::loop()
 {
-    for (size_t ch = 0; ch < Relay::channels; ch++)
-    {
-        if (GPIO_PIN[GPIO_KEY1 + ch] != 99)
-        {
-            btns[ch].loop();
-        }
-    }
     if (radioReceive)
     {
         radioReceive->loop();
     }
+    bindingLoop();
 }
 
 void Relay::perSecondDo()
@@ -209,7 +225,7 @@ void Relay::mqttDiscovery(boolean isEnable)
 
 #pragma region Http
 
-void Relay::httpAdd(ESP8266WebServer *server)
+void Relay::httpAdd(HttpServer *server)
 {
     server->on(F("/relay_do"), std::bind(&Relay::httpDo, this, server));
     server->on(F("/rf_do"), std::bind(&Relay::httpRadioReceive, this, server));
@@ -217,7 +233,7 @@ void Relay::httpAdd(ESP8266WebServer *server)
     server->on(F("/downlight_setting"), std::bind(&Relay::httpDownlightSetting, this, server));
 }
 
-String Relay::httpGetStatus(ESP8266WebServer *server)
+String Relay::httpGetStatus(HttpServer *server)
 {
     String data;
     for (size_t ch = 0; ch < channels; ch++)
@@ -228,7 +244,7 @@ String Relay::httpGetStatus(ESP8266WebServer *server)
     return data.substring(1);
 }
 
-void Relay::httpHtml(ESP8266WebServer *server)
+void Relay::httpHtml(HttpServer *server)
 {
     String radioJs = F("<script type='text/javascript'>");
     radioJs += F("function setDataSub(data,key){if(key.substr(0,5)=='relay'){var t=id(key);var v=data[key];t.setAttribute('class',v==1?'btn-success':'btn-info');t.innerHTML=v==1?'开':'关';return true}return false}");
@@ -326,6 +342,12 @@ void Relay::httpHtml(ESP8266WebServer *server)
         radioJs.replace(F("{v2}"), String(config.led_end));
         page += F("</td></tr>");
     }
+    page += F("<tr><td>按键绑定</td><td><input type='text' name='binding' value='{v}' style='width:300px'>");
+    page += F("<br/>本地通道-对方MAC-对方通道, 多条用逗号分隔, 如 1-A4:CF:12:AA:BB:CC-2");
+    page += F("<br/>本机MAC: {mac}, 对方也需要绑定本机才会执行, 两台设备需设置相同的局域网密钥</td></tr>");
+    page.replace(F("{v}"), bindingFormat());
+    page.replace(F("{mac}"), WiFi.macAddress());
+
     page += F("<tr><td colspan='2'><button type='submit' class='btn-info'>设置</button></td></tr>");
     page += F("</tbody></table></form>");
 
@@ -414,7 +436,7 @@ void Relay::httpHtml(ESP8266WebServer *server)
     server->sendContent(radioJs);
 }
 
-void Relay::httpDo(ESP8266WebServer *server)
+void Relay::httpDo(HttpServer *server)
 {
     String c = server->arg(F("c"));
     if (c != F("1") && c != F("2") && c != F("3") && c != F("4"))
@@ -434,7 +456,45 @@ void Relay::httpDo(ESP8266WebServer *server)
     server->send(200, F("text/html"), "{\"code\":1,\"msg\":\"操作成功\",\"data\":{" + httpGetStatus(server) + "}}");
 }
 
-void Relay::httpRadioReceive(ESP8266WebServer *server)
+boolean Relay::batchCommand(String key, String value)
+{
+    if (!key.startsWith(F("relay_")))
+    {
+        return false;
+    }
+    uint8_t ch = key.substring(6).toInt() - 1;
+    if (ch >= Relay::channels)
+    {
+        return false;
+    }
+    isBatch = true;
+    switchRelay(ch, (value == "ON" ? true : (value == "OFF" ? false : !Relay::lastState[ch])));
+    return true;
+}
+
+void Relay::batchCommit()
+{
+    isBatch = false;
+    for (uint8_t ch = 0; ch < Relay::channels; ch++)
+    {
+        if (bitRead(batchPublish, ch))
+        {
+            mqtt->publish(Relay::channels == 1 ? powerTopic : (powerTopic + (ch + 1)), lastState[ch] ? "ON" : "OFF", globalConfig.mqtt.retain);
+        }
+    }
+    batchPublish = 0;
+}
+
+void Relay::scheduleDo(uint8_t target, uint8_t value)
+{
+    if (target >= Relay::channels)
+    {
+        return;
+    }
+    switchRelay(target, value == 2 ? !Relay::lastState[target] : value == 1);
+}
+
+void Relay::httpRadioReceive(HttpServer *server)
 {
     if (!radioReceive)
     {
@@ -481,7 +541,7 @@ void Relay::httpRadioReceive(ESP8266WebServer *server)
     server->send(200, F("text/html"), F("{\"code\":1,\"msg\":\"操作成功\"}"));
 }
 
-void Relay::httpDownlightSetting(ESP8266WebServer *server)
+void Relay::httpDownlightSetting(HttpServer *server)
 {
     String color1 = server->arg(F("color1"));
     String color2 = server->arg(F("color2"));
@@ -501,7 +561,7 @@ void Relay::httpDownlightSetting(ESP8266WebServer *server)
     server->send(200, F("text/html"), F("{\"code\":1,\"msg\":\"已经设置成功。\"}"));
 }
 
-void Relay::httpSetting(ESP8266WebServer *server)
+void Relay::httpSetting(HttpServer *server)
 {
     if (server->hasArg(F("power_on_state")))
     {
@@ -545,13 +605,22 @@ void Relay::httpSetting(ESP8266WebServer *server)
     }
     checkCanLed(true);
 
+    if (server->hasArg(F("binding")))
+    {
+        if (!bindingParse(server->arg(F("binding"))))
+        {
+            server->send(200, F("text/html"), F("{\"code\":0,\"msg\":\"按键绑定格式错误。\"}"));
+            return;
+        }
+        bindingInit();
+    }
+
     if (server->hasArg(F("module_type")) && !server->arg(F("module_type")).equals(String(config.module_type)))
     {
         server->send(200, F("text/html"), F("{\"code\":1,\"msg\":\"已经更换模块类型 . . . 正在重启中。\"}"));
         config.module_type = server->arg(F("module_type")).toInt();
         Config::saveConfig();
-        Led::blinkLED(400, 4);
-        ESP.restart();
+        Http::restart();
     }
     else
     {
@@ -563,31 +632,47 @@ void Relay::httpSetting(ESP8266WebServer *server)
 
 #pragma region Led
 
+// 呼吸灯上升半周期: 升余弦再做 2.2 gamma 校正, 0~1024
+static const uint16_t LED_BREATH[65] PROGMEM = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 3, 4,
+    6, 9, 11, 15, 19, 24, 30, 37, 46, 55, 65, 77, 90,
+    105, 121, 138, 157, 178, 200, 223, 248, 274, 301, 330, 360, 390,
+    422, 455, 488, 521, 555, 589, 623, 657, 690, 723, 755, 786, 815,
+    844, 871, 896, 919, 940, 959, 976, 991, 1002, 1012, 1019, 1023, 1024,
+};
+
 void Relay::ledTickerHandle()
 {
-    for (uint8_t ch = 0; ch < Relay::channels; ch++)
+    uint32_t start = micros();
+    int level = ledLight;
+    int range = ledLight - LED_BREATH_MIN;
+    if (range > 0)
     {
-        if (!lastState[ch] && GPIO_PIN[GPIO_LED1 + ch] != 99)
-        {
-            analogWrite(GPIO_PIN[GPIO_LED1 + ch], ledLevel);
-        }
+        // 周期与原来每 led_time 毫秒加减 1 相同
+        uint32_t period = 2 * range * (config.led_time > 0 ? config.led_time : 1);
+        uint32_t step = 65536UL * LED_BREATH_INTERVAL / period;
+        ledPhase = (ledPhase + (step > 32768 ? 32768 : step)) & 0xFFFF;
+        uint16_t tri = ledPhase < 32768 ? ledPhase : 65535 - ledPhase;
+        uint8_t i = tri >> 9;
+        int v0 = pgm_read_word(&LED_BREATH[i]);
+        int v1 = pgm_read_word(&LED_BREATH[i + 1]);
+        int v = v0 + (((v1 - v0) * (tri & 0x1FF)) >> 9);
+        level = LED_BREATH_MIN + ((v * range) >> 10);
     }
-    if (ledUp)
+    // 亮度变化时才写入, 所有通道使用同一个值
+    if (level != ledLevel)
     {
-        ledLevel++;
-        if (ledLevel >= ledLight)
-        {
-            ledUp = false;
-        }
-    }
-    else
-    {
-        ledLevel--;
-        if (ledLevel <= 50)
+        ledLevel = level;
+        for (uint8_t ch = 0; ch < Relay::channels; ch++)
         {
-            ledUp = true;
+            if (!lastState[ch] && GPIO_PIN[GPIO_LED1 + ch] != 99)
+            {
+                analogWrite(GPIO_PIN[GPIO_LED1 + ch], level);
+                ledWrites++;
+            }
         }
     }
+    ledTime += micros() - start;
 }
 
 void Relay::ledPWM(uint8_t ch, bool isOn)
@@ -610,9 +695,10 @@ void Relay::ledPWM(uint8_t ch, bool isOn)
     }
     else
     {
+        ledLevel = -1;
         if (!ledTicker->active())
         {
-            ledTicker->attach_ms(config.led_time, std::bind(&Relay::ledTickerHandle, this));
+            ledTicker->attach_ms(LED_BREATH_INTERVAL, std::bind(&Relay::ledTickerHandle, this));
             Debug.AddLog(LOG_LEVEL_INFO, PSTR("ledTicker active"));
         }
     }
@@ -677,6 +763,202 @@ boolean Relay::checkCanLed(boolean re)
 }
 #pragma endregion
 
+#pragma region 按键
+
+/**
+ * 开关每次电平变化都切换继电器, 300ms 内只切换一次
+ * 连续切换 10/12/16/20 次: 射频学习/射频删除/射频清空/配网
+ */
+void Relay::buttonCallback(uint8_t ch, uint8_t event, uint8_t count)
+{
+    Relay *relay = (Relay *)module;
+    if (event == BUTTON_EVENT_CHANGE)
+    {
+        if (millis() - relay->buttonTime[ch] > 300)
+        {
+            relay->switchRelay(ch, !relay->lastState[ch], true);
+            relay->bindingPress(ch);
+            relay->buttonTime[ch] = millis();
+        }
+    }
+    else if (event == BUTTON_EVENT_CLICK)
+    {
+        Led::led(200);
+        Debug.AddLog(LOG_LEVEL_INFO, PSTR("switchCount %d : %d"), ch + 1, count);
+
+        if (count == 10 && relay->radioReceive)
+        {
+            relay->radioReceive->study(ch);
+        }
+        else if (count == 12 && relay->radioReceive)
+        {
+            relay->radioReceive->del(ch);
+        }
+        else if (count == 16 && relay->radioReceive)
+        {
+            relay->radioReceive->delAll();
+        }
+        else if (count == 20)
+        {
+            Wifi::setupWifiManager(false);
+        }
+    }
+}
+#pragma endregion
+
+#pragma region 按键绑定
+
+void Relay::bindingInit()
+{
+    Debug.AddLog(LOG_LEVEL_INFO, PSTR("Binding: %d"), binding->load(config.binding.bytes, config.binding.size));
+    if (binding->getCount() > 0 && globalConfig.lan_key[0] == '\0')
+    {
+        Debug.AddLog(LOG_LEVEL_INFO, PSTR("Binding: lan key not set, disabled"));
+    }
+}
+
+void Relay::bindingLoop()
+{
+    if (espNow->state != 1)
+    {
+        // ESP-NOW 需要在 WiFi 进入 STA 模式后初始化, 失败后不再重试; 没有密钥时无法认证, 不启动
+        if (binding->getCount() == 0 || globalConfig.lan_key[0] == '\0' || espNow->state == 2 || !(WiFi.getMode() & WIFI_STA))
+        {
+            return;
+        }
+        bool result = espNow->begin();
+        Debug.AddLog(LOG_LEVEL_INFO, PSTR("ESP-NOW init %s"), result ? "OK" : "Error");
+        if (!result)
+        {
+            return;
+        }
+    }
+
+    uint8_t mac[6];
+    uint8_t data[BINDING_FRAME_SIZE];
+    while (espNow->read(mac, data))
+    {
+        if (globalConfig.lan_key[0] != '\0')
+        {
+            binding->receive(mac, data, BINDING_FRAME_SIZE, micros());
+        }
+    }
+    binding->loop(micros());
+}
+
+/**
+ * 本机按键切换后把新状态同步到绑定的设备, 远程执行的切换不会再次转发
+ */
+void Relay::bindingPress(uint8_t ch)
+{
+    if (espNow->state == 1 && globalConfig.lan_key[0] != '\0')
+    {
+        binding->press(ch, lastState[ch], micros());
+    }
+}
+
+/**
+ * 与局域网控制共用密钥, 两台设备需设置相同的局域网密钥
+ */
+void Relay::bindingSign(const uint8_t *data, uint8_t len, uint8_t *mac)
+{
+    br_hmac_key_context kc;
+    br_hmac_context ctx;
+    br_hmac_key_init(&kc, &br_sha256_vtable, globalConfig.lan_key, strlen(globalConfig.lan_key));
+    br_hmac_init(&ctx, &kc, BINDING_MAC_LEN);
+    br_hmac_update(&ctx, data, len);
+    br_hmac_out(&ctx, mac);
+}
+
+void Relay::bindingSwitch(uint8_t ch, bool isOn)
+{
+    Relay *relay = (Relay *)module;
+    if (ch < relay->channels)
+    {
+        Debug.AddLog(LOG_LEVEL_INFO, PSTR("Binding: relay %d %s"), ch + 1, isOn ? "ON" : "OFF");
+        relay->switchRelay(ch, isOn);
+    }
+}
+
+/**
+ * 没有收到确认时通过 MQTT 发送, 对方主机名需为默认的 模块名_MAC后6位
+ */
+void Relay::bindingFallback(const uint8_t *mac, uint8_t ch, bool isOn)
+{
+    char host[24];
+    snprintf_P(host, sizeof(host), PSTR("%s_%02X%02X%02X"), module->getModuleName().c_str(), mac[3], mac[4], mac[5]);
+    bool result = mqtt->publish(mqtt->getCmndTopic(String(F("POWER")) + (ch + 1), host), isOn ? "ON" : "OFF");
+    Debug.AddLog(LOG_LEVEL_INFO, PSTR("Binding: %s no ack, mqtt %s"), host, result ? "OK" : "Error");
+}
+
+String Relay::bindingFormat()
+{
+    String str = "";
+    char buf[32];
+    for (uint8_t i = 0; i + BINDING_ENTRY_SIZE <= config.binding.size; i += BINDING_ENTRY_SIZE)
+    {
+        const uint8_t *b = config.binding.bytes + i;
+        snprintf_P(buf, sizeof(buf), PSTR("%d-%02X:%02X:%02X:%02X:%02X:%02X-%d"), b[0] + 1, b[2], b[3], b[4], b[5], b[6], b[7], b[1] + 1);
+        if (str.length() > 0)
+        {
+            str += ',';
+        }
+        str += buf;
+    }
+    return str;
+}
+
+/**
+ * 解析 "本地通道-远程MAC-远程通道", 多条用逗号分隔, 通道从 1 开始
+ */
+bool Relay::bindingParse(String str)
+{
+    RelayConfigMessage_binding_t tmp;
+    tmp.size = 0;
+    str.replace(F(":"), "");
+    str.replace(F(" "), "");
+    int start = 0;
+    while (start < str.length())
+    {
+        int end = str.indexOf(',', start);
+        if (end == -1)
+        {
+            end = str.length();
+        }
+        String one = str.substring(start, end);
+        start = end + 1;
+        if (one.length() == 0)
+        {
+            continue;
+        }
+        int s1 = one.indexOf('-');
+        int s2 = one.indexOf('-', s1 + 1);
+        int local = one.substring(0, s1).toInt();
+        int remote = one.substring(s2 + 1).toInt();
+        if (s1 <= 0 || s2 - s1 != 13 || local < 1 || local > 4 || remote < 1 || remote > 4 || tmp.size + BINDING_ENTRY_SIZE > sizeof(tmp.bytes))
+        {
+            return false;
+        }
+        uint8_t *b = tmp.bytes + tmp.size;
+        b[0] = local - 1;
+        b[1] = remote - 1;
+        for (uint8_t i = 0; i < 6; i++)
+        {
+            char *endp;
+            String hex = one.substring(s1 + 1 + i * 2, s1 + 3 + i * 2);
+            b[2 + i] = strtoul(hex.c_str(), &endp, 16);
+            if (*endp != '\0')
+            {
+                return false;
+            }
+        }
+        tmp.size += BINDING_ENTRY_SIZE;
+    }
+    config.binding = tmp;
+    return true;
+}
+#pragma endregion
+
 void Relay::switchRelay(uint8_t ch, bool isOn, bool isSave)
 {
     if (ch > Relay::channels)
@@ -684,7 +966,7 @@ void Relay::switchRelay(uint8_t ch, bool isOn, bool isSave)
         Debug.AddLog(LOG_LEVEL_INFO, PSTR("invalid channel: %d"), ch);
         return;
     }
-    Debug.AddLog(LOG_LEVEL_INFO, PSTR("Relay %d . . . %s"), ch + 1, isOn ? "ON" : "OFF");
+    Debug.AddLog(LOG_LEVEL_DEBUG, PSTR("Relay %d . . . %s"), ch + 1, isOn ? "ON" : "OFF");
 
     if (isOn && config.power_mode == 1)
     {
@@ -699,8 +981,16 @@ void Relay::switchRelay(uint8_t ch, bool isOn, bool isSave)
 
     lastState[ch] = isOn;
     digitalWrite(GPIO_PIN[GPIO_REL1 + ch], isOn ? HIGH : LOW);
+    Lan::stateChanged();
 
-    mqtt->publish(Relay::channels == 1 ? powerTopic : (powerTopic + (ch + 1)), isOn ? "ON" : "OFF", globalConfig.mqtt.retain);
+    if (isBatch)
+    {
+        bitSet(batchPublish, ch);
+    }
+    else
+    {
+        mqtt->publish(Relay::channels == 1 ? powerTopic : (powerTopic + (ch + 1)), isOn ? "ON" : "OFF", globalConfig.mqtt.retain);
+    }
 
     if (isSave && config.power_on_state > 0)
     {
@@ -736,7 +1026,7 @@ void Relay::loadModule(uint8_t module)
     }
 }
 
-const pb_field_t RelayConfigMessage_fields[17] = {
+const pb_field_t RelayConfigMessage_fields[18] = {
     PB_FIELD(1, UINT32, SINGULAR, STATIC, FIRST, RelayConfigMessage, led_type, led_type, 0),
     PB_FIELD(2, UINT32, SINGULAR, STATIC, OTHER, RelayConfigMessage, led_start, led_type, 0),
     PB_FIELD(3, UINT32, SINGULAR, STATIC, OTHER, RelayConfigMessage, led_end, led_start, 0),
@@ -753,6 +1043,7 @@ const pb_field_t RelayConfigMessage_fields[17] = {
     PB_FIELD(14, UINT32, SINGULAR, STATIC, OTHER, RelayConfigMessage, downlight_interval, downlight_default, 0),
     PB_FIELD(19, UINT32, SINGULAR, STATIC, OTHER, RelayConfigMessage, power_mode, downlight_interval, 0),
     PB_FIELD(20, UINT32, SINGULAR, STATIC, OTHER, RelayConfigMessage, module_type, power_mode, 0),
+    PB_FIELD(21, BYTES, SINGULAR, STATIC, OTHER, RelayConfigMessage, binding, module_type, 0),
     PB_LAST_FIELD};
 
 #endif
\ No newline at end of file
@@ -0,0 +1,388 @@
+#ifdef USE_RELAY
+
+#include "RelayBinding.h"
+#include <string.h>
+
+RelayBinding::RelayBinding(BindingRadio *_radio, uint32_t _session)
+{
+    radio = _radio;
+    session = _session ? _session : 1;
+    memset(entries, 0, sizeof(entries));
+    memset(remotes, 0, sizeof(remotes));
+    memset(pending, 0, sizeof(pending));
+    memset(peers, 0, sizeof(peers));
+}
+
+/**
+ * 从配置加载绑定, MAC 全为 0 的条目忽略
+ */
+uint8_t RelayBinding::load(const uint8_t *bytes, size_t size)
+{
+    static const uint8_t empty[6] = {0};
+    count = 0;
+    remoteCount = 0;
+    for (size_t i = 0; i + BINDING_ENTRY_SIZE <= size && count < BINDING_MAX; i += BINDING_ENTRY_SIZE)
+    {
+        if (memcmp(bytes + i + 2, empty, 6) == 0)
+        {
+            continue;
+        }
+        entries[count].local = bytes[i];
+        entries[count].remote = bytes[i + 1];
+        memcpy(entries[count].mac, bytes + i + 2, 6);
+        if (findRemote(entries[count].mac) == NULL)
+        {
+            memset(&remotes[remoteCount], 0, sizeof(BindingRemote));
+            memcpy(remotes[remoteCount].mac, entries[count].mac, 6);
+            remoteCount++;
+        }
+        count++;
+    }
+    memset(pending, 0, sizeof(pending));
+    return count;
+}
+
+/**
+ * 只接受绑定表中设备发来的命令, 双向控制时两边互相绑定即可
+ */
+bool RelayBinding::isKnown(const uint8_t *mac)
+{
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (memcmp(entries[i].mac, mac, 6) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+BindingRemote *RelayBinding::findRemote(const uint8_t *mac)
+{
+    for (uint8_t i = 0; i < remoteCount; i++)
+    {
+        if (memcmp(remotes[i].mac, mac, 6) == 0)
+        {
+            return &remotes[i];
+        }
+    }
+    return NULL;
+}
+
+void RelayBinding::newSession()
+{
+    session = session * 1103515245 + 12345; // 调用方传入的随机数作种子
+    if (session == 0)
+    {
+        session = 1;
+    }
+    peerCount = 0;
+}
+
+/**
+ * 返回 1 执行 0 重发只确认 -1 拒绝, 拒绝时 last 为该发送端本会话最后执行的序号
+ * 序号按 16 位序号算术比较, 差值在 (0, 32768) 内为较新
+ * 记录满时不淘汰单个发送端 (淘汰后它的旧命令可以重放), 而是执行本条命令后更换会话
+ */
+int RelayBinding::checkSeq(const uint8_t *mac, uint32_t rxSession, uint16_t rxSeq, uint16_t *last)
+{
+    BindingPeer *peer = NULL;
+    for (uint8_t i = 0; i < peerCount; i++)
+    {
+        if (memcmp(peers[i].mac, mac, 6) == 0)
+        {
+            peer = &peers[i];
+            break;
+        }
+    }
+    *last = peer ? peer->seq : 0;
+    if (rxSession != session)
+    {
+        return -1;
+    }
+    int16_t diff = (int16_t)(rxSeq - *last);
+    if (diff == 0 && peer)
+    {
+        return 0;
+    }
+    if (diff <= 0)
+    {
+        return -1;
+    }
+    if (peer)
+    {
+        peer->seq = rxSeq;
+    }
+    else if (peerCount >= BINDING_PEERS)
+    {
+        newSession();
+    }
+    else
+    {
+        memcpy(peers[peerCount].mac, mac, 6);
+        peers[peerCount].seq = rxSeq;
+        peerCount++;
+    }
+    return 1;
+}
+
+void RelayBinding::sign(uint8_t *frame)
+{
+    signCallback(frame, BINDING_FRAME_SIZE - BINDING_MAC_LEN, frame + BINDING_FRAME_SIZE - BINDING_MAC_LEN);
+}
+
+bool RelayBinding::verify(const uint8_t *frame)
+{
+    uint8_t mac[BINDING_MAC_LEN];
+    signCallback(frame, BINDING_FRAME_SIZE - BINDING_MAC_LEN, mac);
+    uint8_t diff = 0;
+    for (uint8_t i = 0; i < BINDING_MAC_LEN; i++)
+    {
+        diff |= mac[i] ^ frame[BINDING_FRAME_SIZE - BINDING_MAC_LEN + i];
+    }
+    return diff == 0;
+}
+
+static void putFrame(uint8_t *frame, uint8_t type, uint32_t frameSession, uint16_t frameSeq, uint8_t b0, uint8_t b1)
+{
+    frame[0] = 'B';
+    frame[1] = type;
+    frame[2] = frameSession & 0xFF;
+    frame[3] = frameSession >> 8;
+    frame[4] = frameSession >> 16;
+    frame[5] = frameSession >> 24;
+    frame[6] = frameSeq & 0xFF;
+    frame[7] = frameSeq >> 8;
+    frame[8] = b0;
+    frame[9] = b1;
+}
+
+void RelayBinding::sendFrame(const uint8_t *mac, uint8_t type, uint32_t frameSession, uint16_t frameSeq, uint8_t b0, uint8_t b1)
+{
+    uint8_t frame[BINDING_FRAME_SIZE];
+    putFrame(frame, type, frameSession, frameSeq, b0, b1);
+    sign(frame);
+    radio->send(mac, frame, BINDING_FRAME_SIZE);
+}
+
+void RelayBinding::queue(const uint8_t *mac, uint8_t ch, bool isOn, uint32_t now)
+{
+    // 同一目标未确认的命令直接被新状态替换
+    BindingPending *p = NULL;
+    for (uint8_t i = 0; i < BINDING_PENDING; i++)
+    {
+        if (pending[i].tries > 0 && pending[i].frame[8] == ch && memcmp(pending[i].mac, mac, 6) == 0)
+        {
+            p = &pending[i];
+            break;
+        }
+    }
+    for (uint8_t i = 0; i < BINDING_PENDING && p == NULL; i++)
+    {
+        if (pending[i].tries == 0)
+        {
+            p = &pending[i];
+        }
+    }
+    BindingRemote *r = findRemote(mac);
+    if (p == NULL || r == NULL)
+    {
+        fallbackCount++;
+        if (fallbackCallback)
+        {
+            fallbackCallback(mac, ch, isOn);
+        }
+        return;
+    }
+
+    memcpy(p->mac, mac, 6);
+    putFrame(p->frame, BINDING_CMD, r->session, ++r->seq, ch, isOn ? 1 : 0);
+    sign(p->frame);
+    p->tries = 1;
+    p->start = now;
+    p->sentAt = now;
+    radio->send(p->mac, p->frame, BINDING_FRAME_SIZE);
+    sentCount++;
+}
+
+/**
+ * 本机按键切换后调用, 把新状态发送给该通道绑定的全部远程设备
+ */
+uint8_t RelayBinding::press(uint8_t ch, bool isOn, uint32_t now)
+{
+    uint8_t n = 0;
+    if (signCallback == NULL)
+    {
+        return 0;
+    }
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (entries[i].local == ch)
+        {
+            queue(entries[i].mac, entries[i].remote, isOn, now);
+            n++;
+        }
+    }
+    return n;
+}
+
+void RelayBinding::receive(const uint8_t *mac, const uint8_t *data, uint8_t len, uint32_t now)
+{
+    if (len != BINDING_FRAME_SIZE || data[0] != 'B' || signCallback == NULL || !isKnown(mac))
+    {
+        return;
+    }
+    if (!verify(data))
+    {
+        rejectCount++;
+        return;
+    }
+    uint32_t rxSession = data[2] | data[3] << 8 | data[4] << 16 | (uint32_t)data[5] << 24;
+    uint16_t rxSeq = data[6] | data[7] << 8;
+    if (data[1] == BINDING_CMD)
+    {
+        uint16_t last;
+        int result = checkSeq(mac, rxSession, rxSeq, &last);
+        if (result < 0)
+        {
+            rejectCount++;
+            sendFrame(mac, BINDING_NAK, session, last, data[6], data[7]);
+            return;
+        }
+        if (result > 0)
+        {
+            rxCount++;
+            if (switchCallback)
+            {
+                switchCallback(data[8], data[9] == 1);
+            }
+        }
+        // 重发的命令也要确认, 上一次的确认可能丢了
+        sendFrame(mac, BINDING_ACK, rxSession, rxSeq, data[8], data[9]);
+    }
+    else if (data[1] == BINDING_ACK)
+    {
+        for (uint8_t i = 0; i < BINDING_PENDING; i++)
+        {
+            BindingPending *p = &pending[i];
+            if (p->tries > 0 && memcmp(p->frame + 2, data + 2, 8) == 0 && memcmp(p->mac, mac, 6) == 0)
+            {
+                p->tries = 0;
+                latency = now - p->start;
+                ackCount++;
+                break;
+            }
+        }
+    }
+    else if (data[1] == BINDING_NAK)
+    {
+        // 只处理针对当前等待中命令的 NAK, 重放的旧 NAK 对不上序号; 重发次数用完后等超时转 MQTT
+        for (uint8_t i = 0; i < BINDING_PENDING; i++)
+        {
+            BindingPending *p = &pending[i];
+            if (p->tries > 0 && p->tries <= BINDING_RETRY && p->frame[6] == data[8] && p->frame[7] == data[9] && memcmp(p->mac, mac, 6) == 0)
+            {
+                BindingRemote *r = findRemote(mac);
+                if (r == NULL)
+                {
+                    break;
+                }
+                r->session = rxSession;
+                r->seq = rxSeq;
+                putFrame(p->frame, BINDING_CMD, r->session, ++r->seq, p->frame[8], p->frame[9]);
+                sign(p->frame);
+                p->tries++;
+                p->sentAt = now;
+                radio->send(p->mac, p->frame, BINDING_FRAME_SIZE);
+                resyncCount++;
+                break;
+            }
+        }
+    }
+}
+
+void RelayBinding::loop(uint32_t now)
+{
+    for (uint8_t i = 0; i < BINDING_PENDING; i++)
+    {
+        BindingPending *p = &pending[i];
+        if (p->tries == 0 || now - p->sentAt < BINDING_ACK_TIMEOUT)
+        {
+            continue;
+        }
+        if (p->tries > BINDING_RETRY)
+        {
+            p->tries = 0;
+            fallbackCount++;
+            if (fallbackCallback)
+            {
+                fallbackCallback(p->mac, p->frame[8], p->frame[9] == 1);
+            }
+            continue;
+        }
+        p->tries++;
+        p->sentAt = now;
+        radio->send(p->mac, p->frame, BINDING_FRAME_SIZE);
+        retryCount++;
+    }
+}
+
+#ifdef ARDUINO
+#include <espnow.h>
+
+uint8_t EspNowRadio::rxMac[BINDING_RX_QUEUE][6];
+uint8_t EspNowRadio::rxData[BINDING_RX_QUEUE][BINDING_FRAME_SIZE];
+volatile uint8_t EspNowRadio::rxHead = 0;
+volatile uint8_t EspNowRadio::rxTail = 0;
+
+bool EspNowRadio::begin()
+{
+    if (esp_now_init() != 0)
+    {
+        state = 2;
+        return false;
+    }
+    esp_now_set_self_role(ESP_NOW_ROLE_COMBO);
+    esp_now_register_recv_cb(receiveCallback);
+    state = 1;
+    return true;
+}
+
+void EspNowRadio::receiveCallback(uint8_t *mac, uint8_t *data, uint8_t len)
+{
+    uint8_t next = (rxHead + 1) % BINDING_RX_QUEUE;
+    if (len != BINDING_FRAME_SIZE || next == rxTail)
+    {
+        return;
+    }
+    memcpy(rxMac[rxHead], mac, 6);
+    memcpy(rxData[rxHead], data, BINDING_FRAME_SIZE);
+    rxHead = next;
+}
+
+bool EspNowRadio::read(uint8_t *mac, uint8_t *data)
+{
+    if (rxTail == rxHead)
+    {
+        return false;
+    }
+    memcpy(mac, rxMac[rxTail], 6);
+    memcpy(data, rxData[rxTail], BINDING_FRAME_SIZE);
+    rxTail = (rxTail + 1) % BINDING_RX_QUEUE;
+    return true;
+}
+
+/**
+ * 使用当前 WiFi 信道发送, 两台设备需连接同一个 AP
+ */
+bool EspNowRadio::send(const uint8_t *mac, const uint8_t *data, uint8_t len)
+{
+    if (!esp_now_is_peer_exist((uint8_t *)mac))
+    {
+        esp_now_add_peer((uint8_t *)mac, ESP_NOW_ROLE_COMBO, 0, NULL, 0);
+    }
+    return esp_now_send((uint8_t *)mac, (uint8_t *)data, len) == 0;
+}
+#endif
+
+#endif
@@ -1,75 +0,0 @@
-#ifdef USE_RELAY
-
-#include "Debug.h"
-#include "RadioReceive.h"
-#include "RelayButton.h"
-#include "Config.h"
-#include "Relay.h"
-#include "Wifi.h"
-#include "Led.h"
-
-void RelayButton::init(Relay *_relay, uint8_t _ch, uint8_t _io)
-{
-    ch = _ch;
-    io = _io;
-    relay = _relay;
-    pinMode(io, INPUT_PULLUP);
-    if (digitalRead(io))
-    {
-        setStateFlag(DEBOUNCED_STATE | UNSTABLE_STATE);
-    }
-}
-
-void RelayButton::loop()
-{
-    currentState = digitalRead(io);
-    if (currentState != getStateFlag(UNSTABLE_STATE))
-    {
-        timingStart = millis();
-        toggleStateFlag(UNSTABLE_STATE);
-    }
-    else if (millis() - timingStart >= debounceTime)
-    {
-        if (currentState != getStateFlag(DEBOUNCED_STATE))
-        {
-            timingStart = millis();
-            toggleStateFlag(DEBOUNCED_STATE);
-
-            switchCount += 1;
-            intervalStart = millis();
-
-            if (millis() > lastTime + 300)
-            {
-                relay->switchRelay(ch, !relay->lastState[ch], true);
-                lastTime = millis();
-            }
-        }
-    }
-
-    // 如果经过的时间大于超时并且计数大于0，则填充并重置计数
-    if (switchCount > 0 && (millis() - intervalStart) > specialFunctionTimeout)
-    {
-        Led::led(200);
-        Debug.AddLog(LOG_LEVEL_INFO, PSTR("switchCount %d : %d"), ch + 1, switchCount);
-
-        if (switchCount == 10 && relay->radioReceive)
-        {
-            relay->radioReceive->study(ch);
-        }
-        else if (switchCount == 12 && relay->radioReceive)
-        {
-            relay->radioReceive->del(ch);
-        }
-        else if (switchCount == 16 && relay->radioReceive)
-        {
-            relay->radioReceive->delAll();
-        }
-        else if (switchCount == 20)
-        {
-            Wifi::setupWifiManager(false);
-        }
-        switchCount = 0;
-    }
-}
-
-#endif
\ No newline at end of file
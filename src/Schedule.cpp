@@ -0,0 +1,384 @@
+#include "Schedule.h"
+#include "Config.h"
+#include "Debug.h"
+#include "Ntp.h"
+#include "Metrics.h"
+
+uint32_t Schedule::next[SCHEDULE_MAX];
+uint32_t Schedule::nextFire = SCHEDULE_NONE;
+uint32_t Schedule::lastMinute = 0;
+uint8_t Schedule::operationFlag = 0;
+uint32_t Schedule::fireCount = 0;
+uint32_t Schedule::lagTime = 0;
+uint32_t Schedule::execTime = 0;
+
+void Schedule::init()
+{
+    Metrics::add(PSTR("esp_schedule_fire_total"), METRICS_COUNTER, &fireCount);
+    Metrics::add(PSTR("esp_schedule_lag_ms"), METRICS_GAUGE, &lagTime);
+    Metrics::add(PSTR("esp_schedule_exec_us"), METRICS_GAUGE, &execTime);
+}
+
+/**
+ * 计算某天的日出/日落时间 (NOAA 近似公式, 误差1~2分钟)
+ * day 本地时间1970年起的天数, 返回当天分钟数, 极昼极夜或未设置经纬度返回 -1
+ */
+int16_t Schedule::sunTime(uint32_t day, bool isRise)
+{
+    if (globalConfig.schedule.latitude == 0 && globalConfig.schedule.longitude == 0)
+    {
+        return -1;
+    }
+    float lat = globalConfig.schedule.latitude / 100000.0f * DEG_TO_RAD;
+    float lon = globalConfig.schedule.longitude / 100000.0f;
+    float g = 2 * PI * fmod(((int32_t)day - 10957) / 365.2422f, 1.0f); // 10957 = 2000-01-01
+    float eqtime = 229.18f * (0.000075f + 0.001868f * cos(g) - 0.032077f * sin(g) - 0.014615f * cos(2 * g) - 0.040849f * sin(2 * g));
+    float decl = 0.006918f - 0.399912f * cos(g) + 0.070257f * sin(g) - 0.006758f * cos(2 * g) + 0.000907f * sin(2 * g) - 0.002697f * cos(3 * g) + 0.00148f * sin(3 * g);
+    float cosHa = cos(90.833f * DEG_TO_RAD) / (cos(lat) * cos(decl)) - tan(lat) * tan(decl);
+    if (cosHa < -1 || cosHa > 1)
+    {
+        return -1;
+    }
+    float ha = acos(cosHa) * RAD_TO_DEG;
+    int16_t t = round(720 - 4 * (lon + (isRise ? ha : -ha)) - eqtime + NTP_TIMEZONE * 60);
+    return (t % 1440 + 1440) % 1440;
+}
+
+/**
+ * 计算任务在 after 分钟之后的下一次执行时间
+ */
+uint32_t Schedule::nextTime(uint32_t entry, uint32_t after)
+{
+    uint8_t days = SCHEDULE_DAYS(entry);
+    if (days == 0)
+    {
+        return SCHEDULE_NONE;
+    }
+    uint32_t day = after / 1440;
+    for (uint8_t i = 0; i <= 7; i++, day++)
+    {
+        if (!bitRead(days, (day + 4) % 7)) // 1970-01-01 是周四
+        {
+            continue;
+        }
+        uint32_t base = day * 1440;
+        int16_t t = SCHEDULE_TIME(entry);
+        switch (SCHEDULE_KIND(entry))
+        {
+        case SCHEDULE_KIND_DAILY:
+            if (t >= 1440)
+            {
+                return SCHEDULE_NONE;
+            }
+            break;
+        case SCHEDULE_KIND_HOURLY:
+        {
+            uint32_t c = base + t % 60;
+            if (c <= after)
+            {
+                c += ((after - c) / 60 + 1) * 60;
+            }
+            if (c < base + 1440)
+            {
+                return c;
+            }
+            continue;
+        }
+        default:
+        {
+            int16_t sun = sunTime(day, SCHEDULE_KIND(entry) == SCHEDULE_KIND_SUNRISE);
+            if (sun < 0)
+            {
+                continue;
+            }
+            t = constrain(sun + t - 720, 0, 1439);
+            break;
+        }
+        }
+        if (base + t > after)
+        {
+            return base + t;
+        }
+    }
+    return SCHEDULE_NONE;
+}
+
+void Schedule::reload()
+{
+    nextFire = SCHEDULE_NONE;
+    for (uint8_t i = 0; i < globalConfig.schedule.entry_count; i++)
+    {
+        next[i] = nextTime(globalConfig.schedule.entry[i], lastMinute);
+        if (next[i] < nextFire)
+        {
+            nextFire = next[i];
+        }
+    }
+}
+
+void Schedule::fire(uint32_t minute)
+{
+    uint64_t nowMs = Ntp::nowMs();
+    nextFire = SCHEDULE_NONE;
+    for (uint8_t i = 0; i < globalConfig.schedule.entry_count; i++)
+    {
+        uint32_t entry = globalConfig.schedule.entry[i];
+        if (next[i] <= minute)
+        {
+            // 时钟向前跳变太多时不再补执行
+            if (minute - next[i] <= SCHEDULE_GRACE && module)
+            {
+                uint32_t start = micros();
+                module->scheduleDo(SCHEDULE_TARGET(entry), SCHEDULE_VALUE(entry));
+                execTime = micros() - start;
+                lagTime = nowMs - (uint64_t)next[i] * 60000;
+                fireCount++;
+                Debug.AddLog(LOG_LEVEL_INFO, PSTR("Schedule %d: target %d value %d lag %dms exec %dus"), i, SCHEDULE_TARGET(entry), SCHEDULE_VALUE(entry), lagTime, execTime);
+            }
+            next[i] = nextTime(entry, minute);
+        }
+        if (next[i] < nextFire)
+        {
+            nextFire = next[i];
+        }
+    }
+}
+
+void Schedule::perSecondDo()
+{
+    if (globalConfig.schedule.entry_count == 0 || !Ntp::rtcTime.valid)
+    {
+        return;
+    }
+    if (Ntp::nowMs() / 60000 != lastMinute)
+    {
+        bitSet(operationFlag, 0);
+    }
+}
+
+void Schedule::loop()
+{
+    if (!bitRead(operationFlag, 0))
+    {
+        return;
+    }
+    bitClear(operationFlag, 0);
+
+    uint32_t minute = Ntp::nowMs() / 60000;
+    if (lastMinute == 0 || minute < lastMinute)
+    {
+        // 首次对时或时钟回拨, 重新计算
+        lastMinute = minute;
+        reload();
+        return;
+    }
+    lastMinute = minute;
+    if (minute >= nextFire)
+    {
+        fire(minute);
+    }
+}
+
+String Schedule::format(uint32_t entry)
+{
+    char buf[32];
+    char days[8];
+    uint8_t mask = SCHEDULE_DAYS(entry);
+    if (mask == 0x7F)
+    {
+        strcpy(days, "*");
+    }
+    else
+    {
+        uint8_t j = 0;
+        for (uint8_t d = 0; d < 7; d++)
+        {
+            if (bitRead(mask, d))
+            {
+                days[j++] = '0' + d;
+            }
+        }
+        days[j] = '\0';
+    }
+
+    uint16_t t = SCHEDULE_TIME(entry);
+    switch (SCHEDULE_KIND(entry))
+    {
+    case SCHEDULE_KIND_DAILY:
+        snprintf_P(buf, sizeof(buf), PSTR("%s %02d:%02d %d %d"), days, t / 60, t % 60, SCHEDULE_TARGET(entry), SCHEDULE_VALUE(entry));
+        break;
+    case SCHEDULE_KIND_HOURLY:
+        snprintf_P(buf, sizeof(buf), PSTR("%s *:%02d %d %d"), days, t % 60, SCHEDULE_TARGET(entry), SCHEDULE_VALUE(entry));
+        break;
+    default:
+        snprintf_P(buf, sizeof(buf), PSTR("%s %s%+d %d %d"), days, SCHEDULE_KIND(entry) == SCHEDULE_KIND_SUNRISE ? "sunrise" : "sunset", t - 720, SCHEDULE_TARGET(entry), SCHEDULE_VALUE(entry));
+        break;
+    }
+    return String(buf);
+}
+
+/**
+ * 解析 "星期 时间 目标 值"
+ * 星期: * 或 0~6 组合 (0 = 周日), 时间: 07:00 / *:15 / sunrise / sunset-30
+ */
+bool Schedule::parse(String str, uint32_t *entry)
+{
+    str.trim();
+    int s1 = str.indexOf(' ');
+    int s2 = str.indexOf(' ', s1 + 1);
+    int s3 = str.indexOf(' ', s2 + 1);
+    if (s1 <= 0 || s2 <= s1 + 1 || s3 <= s2 + 1)
+    {
+        return false;
+    }
+    String days = str.substring(0, s1);
+    String time = str.substring(s1 + 1, s2);
+    int target = str.substring(s2 + 1, s3).toInt();
+    int value = str.substring(s3 + 1).toInt();
+    if (target < 0 || target > 15 || value < 0 || value > 255)
+    {
+        return false;
+    }
+
+    uint8_t mask = 0;
+    if (days.equals(F("*")))
+    {
+        mask = 0x7F;
+    }
+    else
+    {
+        for (uint8_t i = 0; i < days.length(); i++)
+        {
+            if (days[i] < '0' || days[i] > '6')
+            {
+                return false;
+            }
+            bitSet(mask, days[i] - '0');
+        }
+    }
+
+    uint8_t kind;
+    int t;
+    if (time.startsWith(F("sunrise")) || time.startsWith(F("sunset")))
+    {
+        kind = time.startsWith(F("sunrise")) ? SCHEDULE_KIND_SUNRISE : SCHEDULE_KIND_SUNSET;
+        String offset = time.substring(kind == SCHEDULE_KIND_SUNRISE ? 7 : 6);
+        if (offset.startsWith(F("+")))
+        {
+            offset.remove(0, 1);
+        }
+        t = offset.toInt();
+        if (t < -720 || t > 720)
+        {
+            return false;
+        }
+        t += 720;
+    }
+    else
+    {
+        int sep = time.indexOf(':');
+        if (sep <= 0)
+        {
+            return false;
+        }
+        t = time.substring(sep + 1).toInt();
+        if (t < 0 || t > 59)
+        {
+            return false;
+        }
+        if (time.startsWith(F("*")))
+        {
+            kind = SCHEDULE_KIND_HOURLY;
+        }
+        else
+        {
+            int h = time.substring(0, sep).toInt();
+            if (h < 0 || h > 23)
+            {
+                return false;
+            }
+            kind = SCHEDULE_KIND_DAILY;
+            t += h * 60;
+        }
+    }
+    *entry = SCHEDULE_PACK(t, mask, kind, target, value);
+    return true;
+}
+
+/**
+ * 用分号分隔的任务列表替换当前定时任务
+ */
+bool Schedule::set(String entries)
+{
+    uint32_t tmp[SCHEDULE_MAX];
+    uint8_t count = 0;
+    int start = 0;
+    while (start < entries.length())
+    {
+        int end = entries.indexOf(';', start);
+        if (end == -1)
+        {
+            end = entries.length();
+        }
+        String one = entries.substring(start, end);
+        one.trim();
+        if (one.length() > 0)
+        {
+            if (count >= SCHEDULE_MAX || !parse(one, &tmp[count]))
+            {
+                return false;
+            }
+            count++;
+        }
+        start = end + 1;
+    }
+    memcpy(globalConfig.schedule.entry, tmp, count * sizeof(uint32_t));
+    globalConfig.schedule.entry_count = count;
+    reload();
+    return true;
+}
+
+String Schedule::toJson()
+{
+    String json = F("{\"lat\":");
+    json += String(globalConfig.schedule.latitude / 100000.0, 5);
+    json += F(",\"lon\":");
+    json += String(globalConfig.schedule.longitude / 100000.0, 5);
+
+    uint32_t minute = Ntp::nowMs() / 60000;
+    int16_t rise = sunTime(minute / 1440, true);
+    int16_t set = sunTime(minute / 1440, false);
+    char buf[8];
+    json += F(",\"sunrise\":\"");
+    if (rise >= 0)
+    {
+        snprintf_P(buf, sizeof(buf), PSTR("%02d:%02d"), rise / 60, rise % 60);
+        json += buf;
+    }
+    json += F("\",\"sunset\":\"");
+    if (set >= 0)
+    {
+        snprintf_P(buf, sizeof(buf), PSTR("%02d:%02d"), set / 60, set % 60);
+        json += buf;
+    }
+
+    json += F("\",\"entries\":\"");
+    for (uint8_t i = 0; i < globalConfig.schedule.entry_count; i++)
+    {
+        if (i > 0)
+        {
+            json += ';';
+        }
+        json += format(globalConfig.schedule.entry[i]);
+    }
+    json += F("\",\"next\":");
+    json += nextFire == SCHEDULE_NONE || nextFire < minute ? -1 : (int32_t)(nextFire - minute);
+    json += F(",\"fire\":");
+    json += fireCount;
+    json += F(",\"lag\":");
+    json += lagTime;
+    json += F(",\"exec\":");
+    json += execTime;
+    json += '}';
+    return json;
+}
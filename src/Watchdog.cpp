@@ -0,0 +1,134 @@
+#include "Watchdog.h"
+#include "Debug.h"
+#include "Mqtt.h"
+#include "Metrics.h"
+
+uint8_t Watchdog::stage = WATCHDOG_STAGE_NONE;
+uint32_t Watchdog::startTime = 0;
+uint32_t Watchdog::addr = 0;
+WatchdogStall Watchdog::stalls[WATCHDOG_LOG_NUM];
+uint8_t Watchdog::stallIndex = 0;
+uint32_t Watchdog::reportCount = 0;
+uint8_t Watchdog::operationFlag = 0;
+uint32_t Watchdog::budget = WATCHDOG_BUDGET;
+uint32_t Watchdog::stallCount = 0;
+
+static const char stageNames[] PROGMEM = "none|led|debug|mqtt|module|wifi|http|ntp";
+
+void Watchdog::init()
+{
+    Metrics::add(PSTR("esp_loop_stall_total"), METRICS_COUNTER, &stallCount);
+}
+
+/**
+ * 进入一个阶段，记录调用处的返回地址
+ */
+void Watchdog::begin(uint8_t _stage)
+{
+    stage = _stage;
+    startTime = millis();
+    addr = (uint32_t)__builtin_return_address(0);
+}
+
+/**
+ * 可能阻塞的代码调用，卡顿时记录最后一次 mark 的位置
+ */
+void Watchdog::mark()
+{
+    addr = (uint32_t)__builtin_return_address(0);
+}
+
+/**
+ * 离开阶段，超过 budget 时记录并返回 true
+ */
+bool Watchdog::end()
+{
+    uint32_t time = millis() - startTime;
+    uint8_t _stage = stage;
+    stage = WATCHDOG_STAGE_NONE;
+    if (time < budget)
+    {
+        return false;
+    }
+    WatchdogStall *stall = &stalls[stallIndex];
+    stall->stage = _stage;
+    stall->time = time;
+    stall->addr = addr;
+    stall->perSecond = perSecond;
+    stall->tag[0] = '\0';
+    stallIndex = (stallIndex + 1) % WATCHDOG_LOG_NUM;
+    stallCount++;
+    Debug.AddLog(LOG_LEVEL_DEBUG, PSTR("Stall stage: %d %dms 0x%08x"), _stage, time, addr);
+    return true;
+}
+
+void Watchdog::setTag(const char *tag)
+{
+    WatchdogStall *stall = &stalls[(stallIndex + WATCHDOG_LOG_NUM - 1) % WATCHDOG_LOG_NUM];
+    strncpy(stall->tag, tag, sizeof(stall->tag) - 1);
+    stall->tag[sizeof(stall->tag) - 1] = '\0';
+}
+
+String Watchdog::toJson()
+{
+    char buf[96];
+    char name[8];
+    String json = F("{\"budget\":");
+    json += budget;
+    json += F(",\"count\":");
+    json += stallCount;
+    json += F(",\"list\":[");
+    uint8_t num = stallCount < WATCHDOG_LOG_NUM ? stallCount : WATCHDOG_LOG_NUM;
+    for (uint8_t i = 0; i < num; i++)
+    {
+        WatchdogStall *stall = &stalls[(stallIndex + WATCHDOG_LOG_NUM - 1 - i) % WATCHDOG_LOG_NUM];
+        // 从 stageNames 中取第 stage 个名称
+        PGM_P p = stageNames;
+        for (uint8_t j = 0; j < stall->stage && p; j++)
+        {
+            p = strchr_P(p, '|');
+            p = p ? p + 1 : NULL;
+        }
+        uint8_t len = 0;
+        while (p && len < sizeof(name) - 1)
+        {
+            char c = pgm_read_byte(p + len);
+            if (c == '|' || c == '\0')
+            {
+                break;
+            }
+            name[len++] = c;
+        }
+        name[len] = '\0';
+        snprintf_P(buf, sizeof(buf), PSTR("%s{\"stage\":\"%s\",\"time\":%d,\"addr\":\"0x%08x\",\"at\":%d,\"tag\":\""), i ? "," : "", name, stall->time, stall->addr, stall->perSecond);
+        json += buf;
+        for (uint8_t j = 0; stall->tag[j] != '\0'; j++)
+        {
+            if (stall->tag[j] != '"' && stall->tag[j] != '\\')
+            {
+                json += stall->tag[j];
+            }
+        }
+        json += F("\"}");
+    }
+    json += F("]}");
+    return json;
+}
+
+void Watchdog::perSecondDo()
+{
+    if (perSecond % 60 == 0 && stallCount != reportCount)
+    {
+        bitSet(operationFlag, 0);
+    }
+}
+
+void Watchdog::loop()
+{
+    if (bitRead(operationFlag, 0) && mqtt->mqttClient.connected())
+    {
+        bitClear(operationFlag, 0);
+        reportCount = stallCount;
+        mqtt->publish(mqtt->getTeleTopic(F("STALL")), toJson().c_str(), false);
+    }
+}
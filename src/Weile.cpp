@@ -2,9 +2,11 @@
 
 #include "Debug.h"
 #include "Led.h"
+#include "Button.h"
 #include "Weile.h"
 #include "Mqtt.h"
 #include "Wifi.h"
+#include "Watchdog.h"
 
 #pragma region 继承
 
@@ -14,6 +16,7 @@ void Weile::init()
     {
         Led::init(config.pin_led > 30 ? config.pin_led - 30 : config.pin_led, config.pin_led > 30 ? HIGH : LOW);
     }
+    Button::add(config.pin_btn, BUTTON_MODE_PUSH, buttonCallback);
     pinMode(config.pin_rel, OUTPUT); // 继电器
 }
 
@@ -51,54 +54,22 @@ void Weile::loop()
             Debug.AddLog(LOG_LEVEL_INFO, PSTR("screen close . . ."));
         }
     }
-    checkButton();
 }
 
 void Weile::perSecondDo()
 {
 }
 
-void Weile::checkButton()
+void Weile::buttonCallback(uint8_t arg, uint8_t event, uint8_t count)
 {
-    boolean buttonState = digitalRead(config.pin_btn);
-
-    if (buttonState == 0)
-    { // 按下按钮
-        if (buttonTiming == false)
-        {
-            buttonTiming = true;
-            buttonTimingStart = millis();
-        }
-        else
-        { // buttonTiming = true
-            if (millis() >= (buttonTimingStart + buttonDebounceTime))
-            {
-                buttonAction = 1;
-            }
-
-            if (millis() >= (buttonTimingStart + buttonLongPressTime))
-            {
-                buttonAction = 2;
-            }
-        }
+    if (event == BUTTON_EVENT_CLICK) // 执行短按动作
+    {
+        Debug.AddLog(LOG_LEVEL_INFO, PSTR("buttonShortPressAction %d"), count);
     }
-    else
-    { // buttonState == 1, 释放按钮
-        buttonTiming = false;
-
-        if (buttonAction != 0)
-        {
-            if (buttonAction == 1) // 执行短按动作
-            {
-                Debug.AddLog(LOG_LEVEL_INFO, PSTR("buttonShortPressAction"));
-            }
-            else if (buttonAction == 2) // 执行长按动作
-            {
-                Debug.AddLog(LOG_LEVEL_INFO, PSTR("buttonLongPressAction"));
-                Wifi::setupWifiManager(false);
-            }
-            buttonAction = 0;
-        }
+    else if (event == BUTTON_EVENT_LONG) // 执行长按动作
+    {
+        Debug.AddLog(LOG_LEVEL_INFO, PSTR("buttonLongPressAction"));
+        Wifi::setupWifiManager(false);
     }
 }
 #pragma endregion
@@ -195,18 +166,39 @@ void Weile::mqttConnected()
 
 #pragma region HTTP
 
-void Weile::httpAdd(ESP8266WebServer *server)
+void Weile::httpAdd(HttpServer *server)
 {
     server->on(F("/weile_do"), std::bind(&Weile::httpDo, this, server));
     server->on(F("/weile_setting"), std::bind(&Weile::httpSetting, this, server));
 }
 
-String Weile::httpGetStatus(ESP8266WebServer *server)
+String Weile::httpGetStatus(HttpServer *server)
 {
     return "";
 }
 
-void Weile::httpHtml(ESP8266WebServer *server)
+boolean Weile::batchCommand(String key, String value)
+{
+    return false;
+}
+
+void Weile::batchCommit()
+{
+}
+
+void Weile::scheduleDo(uint8_t target, uint8_t value)
+{
+    if (value == 1 || (value == 2 && !weiLeStatus))
+    {
+        weileOpen();
+    }
+    else
+    {
+        weileClose();
+    }
+}
+
+void Weile::httpHtml(HttpServer *server)
 {
     String radioJs = F("<script type='text/javascript'>");
     radioJs += F("var iscover=0;function setDataSub(data,key){if(key=='cover_position'){var t=id(key);var v=data[key];if(iscover>0&&v==t.value&&iscover++>5){iscover=0;intervalTime=defIntervalTime}t.value=v;t.nextSibling.nextSibling.innerHTML=v+'%';id('cover_open').disabled=v==100;id('cover_close').disabled=v==0;return true}return false}");
@@ -238,14 +230,14 @@ void Weile::httpHtml(ESP8266WebServer *server)
     server->sendContent(radioJs);
 }
 
-void Weile::httpDo(ESP8266WebServer *server)
+void Weile::httpDo(HttpServer *server)
 {
     String str = server->arg(F("do"));
     weileOpen();
     server->send(200, F("text/html"), F("{\"code\":1,\"msg\":\"操作成功\"}"));
 }
 
-void Weile::httpSetting(ESP8266WebServer *server)
+void Weile::httpSetting(HttpServer *server)
 {
     config.jog_time = server->arg(F("jog_time")).toInt();
     config.start_interval = server->arg(F("start_interval")).toInt();
@@ -262,11 +254,11 @@ void Weile::weileOpen()
     {
         return;
     }
-    Debug.AddLog(LOG_LEVEL_INFO, "Open . . .");
+    Debug.AddLog(LOG_LEVEL_INFO, PSTR("Open . . ."));
     openScreen(true);
     weiLeStatus = true;
     weileTime = millis();
-    Debug.AddLog(LOG_LEVEL_INFO, "Open Weile");
+    Debug.AddLog(LOG_LEVEL_INFO, PSTR("Open Weile"));
     pressBtn();
 
     mqtt->publish(powerTopic, "ON", globalConfig.mqtt.retain);
@@ -278,9 +270,9 @@ void Weile::weileClose()
     {
         return;
     }
-    Debug.AddLog(LOG_LEVEL_INFO, "Close . . .");
+    Debug.AddLog(LOG_LEVEL_INFO, PSTR("Close . . ."));
     openScreen(true);
-    Debug.AddLog(LOG_LEVEL_INFO, "Close Weile");
+    Debug.AddLog(LOG_LEVEL_INFO, PSTR("Close Weile"));
     pressBtn();
 
     mqtt->publish(powerTopic, "OFF", globalConfig.mqtt.retain);
@@ -293,7 +285,7 @@ void Weile::openScreen(boolean isInterval)
 {
     if (!screenStatus) // 屏幕关屏
     {
-        Debug.AddLog(LOG_LEVEL_INFO, "Open Screen");
+        Debug.AddLog(LOG_LEVEL_INFO, PSTR("Open Screen"));
         pressBtn();
         screenStatus = true;
         screenTime = millis();
@@ -309,6 +301,7 @@ void Weile::openScreen(boolean isInterval)
  */
 void Weile::pressBtn()
 {
+    Watchdog::mark();
     digitalWrite(config.pin_rel, HIGH);
     delay(config.jog_time);
     digitalWrite(config.pin_rel, LOW);
@@ -3,13 +3,57 @@
 #include "Debug.h"
 #include "Wifi.h"
 #include "Led.h"
+#include "Metrics.h"
 #include <WiFiClient.h>
 #include <ESP8266httpUpdate.h>
+#include <ESP8266HTTPClient.h>
 #include <DNSServer.h>
+#include <algorithm>
 
 WiFiClient Wifi::wifiClient;
 WiFiEventHandler Wifi::STAGotIP;
+WiFiEventHandler Wifi::STAConnected;
+WiFiEventHandler Wifi::STADisconnected;
 bool Wifi::isDHCP = true;
+uint32_t Wifi::connectTime = 0;
+uint32_t Wifi::fastFailCount = 0;
+
+WifiCache Wifi::cache;
+uint8_t Wifi::cacheFrom = 0;
+bool Wifi::cacheIp = false;
+unsigned long Wifi::fastConnectStart = 0;
+
+bool Wifi::directed = false;
+unsigned long Wifi::lostTime = 0;
+int16_t Wifi::rssiAvg = 0;
+unsigned long Wifi::rssiTime = 0;
+unsigned long Wifi::roamTime = 0;
+bool Wifi::roamArmed = true;
+bool Wifi::roamScan = false;
+bool Wifi::roamPending = false;
+uint32_t Wifi::roamCount = 0;
+uint32_t Wifi::roamScanCount = 0;
+int8_t Wifi::roamBefore = 0;
+int8_t Wifi::roamAfter = 0;
+
+WifiRssiMinute Wifi::rssiHistory[WIFI_RSSI_HISTORY];
+uint8_t Wifi::rssiHead = 0;
+uint8_t Wifi::rssiLen = 0;
+uint32_t Wifi::rssiMinute = 0;
+int8_t Wifi::rssiMin = 0;
+int8_t Wifi::rssiMax = 0;
+int32_t Wifi::rssiSum = 0;
+uint8_t Wifi::rssiCount = 0;
+WifiLinkEvent Wifi::linkEvents[WIFI_LINK_EVENTS];
+uint8_t Wifi::linkHead = 0;
+uint8_t Wifi::linkLen = 0;
+WifiLinkEvent Wifi::linkNow;
+bool Wifi::linkDown = true;
+unsigned long Wifi::downStart = 0;
+unsigned long Wifi::assocTime = 0;
+int8_t Wifi::lastRssi = 0;
+uint32_t Wifi::disconnectCount = 0;
+uint32_t Wifi::outageTime = 0;
 
 unsigned long Wifi::configPortalStart = 0;
 bool Wifi::connect = false;
@@ -17,6 +61,11 @@ String Wifi::_ssid = "";
 String Wifi::_pass = "";
 DNSServer *Wifi::dnsServer;
 
+WifiScanResult Wifi::scanResult[WIFI_SCAN_MAX];
+uint8_t Wifi::scanCount = 0;
+unsigned long Wifi::scanTime = 0;
+bool Wifi::scanRunning = false;
+
 void Wifi::OTA(String url)
 {
     if (url.indexOf(F("%04d")) != -1)
@@ -31,16 +80,196 @@ void Wifi::OTA(String url)
     url.replace(F("%module%"), module->getModuleName());
 
     Debug.AddLog(LOG_LEVEL_INFO, PSTR("OTA Url: %s"), url.c_str());
-    Led::blinkLED(200, 5);
+    Led::play(&LED_NOTICE);
+    uint32_t start = millis();
+
+    // 固件旁边有 清单(url.json) 时走断点续传 + CRC32 校验，否则按原方式更新
+    uint32_t size;
+    uint32_t crc;
+    int8_t manifest = otaManifest(url + F(".json"), &size, &crc);
+    if (manifest == -1)
+    {
+        return;
+    }
+    if (manifest == 1)
+    {
+        if (otaDownload(url, size, crc))
+        {
+            Debug.AddLog(LOG_LEVEL_INFO, PSTR("OTA OK %dms"), millis() - start);
+            delay(100);
+            ESP.restart();
+        }
+        return;
+    }
+
     WiFiClient OTAclient;
-    if (ESPhttpUpdate.update(OTAclient, url, VERSION) == HTTP_UPDATE_FAILED)
+    ESPhttpUpdate.rebootOnUpdate(false);
+    HTTPUpdateResult ret = ESPhttpUpdate.update(OTAclient, url, VERSION);
+    if (ret == HTTP_UPDATE_FAILED)
     {
         Debug.AddLog(LOG_LEVEL_ERROR, PSTR("HTTP_UPDATE_FAILD Error (%d): %s"), ESPhttpUpdate.getLastError(), ESPhttpUpdate.getLastErrorString().c_str());
     }
+    else if (ret == HTTP_UPDATE_OK)
+    {
+        // .bin.gz 由 eboot 在重启时解压到程序区
+        Debug.AddLog(LOG_LEVEL_INFO, PSTR("OTA OK %dms"), millis() - start);
+        delay(100);
+        ESP.restart();
+    }
+}
+
+static const uint32_t crc32Table[] PROGMEM = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+
+uint32_t Wifi::crc32(uint32_t crc, const uint8_t *data, size_t len)
+{
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc = pgm_read_dword(&crc32Table[(crc ^ data[i]) & 0x0F]) ^ (crc >> 4);
+        crc = pgm_read_dword(&crc32Table[(crc ^ (data[i] >> 4)) & 0x0F]) ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+/**
+ * 读取固件清单 {"version":"...","size":123,"crc32":"1a2b3c4d"}
+ * 返回 1 = 有清单, 0 = 没有清单, -1 = 版本相同不需要更新
+ */
+int8_t Wifi::otaManifest(String url, uint32_t *size, uint32_t *crc)
+{
+    WiFiClient client;
+    HTTPClient http;
+    if (!http.begin(client, url) || http.GET() != HTTP_CODE_OK)
+    {
+        http.end();
+        return 0;
+    }
+    String json = http.getString();
+    http.end();
+
+    int version = json.indexOf(F("\"version\":\""));
+    int sizePos = json.indexOf(F("\"size\":"));
+    int crcPos = json.indexOf(F("\"crc32\":\""));
+    if (version == -1 || sizePos == -1 || crcPos == -1)
+    {
+        Debug.AddLog(LOG_LEVEL_ERROR, PSTR("OTA manifest error"));
+        return 0;
+    }
+    version += 11;
+    String ver = json.substring(version, json.indexOf('"', version));
+    if (ver.equals(VERSION))
+    {
+        Debug.AddLog(LOG_LEVEL_INFO, PSTR("OTA version %s same, skip"), VERSION);
+        return -1;
+    }
+    *size = json.substring(sizePos + 7).toInt();
+    *crc = strtoul(json.substring(crcPos + 9, crcPos + 17).c_str(), NULL, 16);
+    Debug.AddLog(LOG_LEVEL_INFO, PSTR("OTA manifest %s size: %d crc32: %08x"), ver.c_str(), *size, *crc);
+    return *size > 0 ? 1 : 0;
+}
+
+/**
+ * 分段下载写入 Update，断线后用 Range 从已写入位置继续
+ * 最后一块写入前先校验 CRC32，不一致则放弃本次更新
+ */
+bool Wifi::otaDownload(String url, uint32_t size, uint32_t crc)
+{
+    if (!Update.begin(size))
+    {
+        Debug.AddLog(LOG_LEVEL_ERROR, PSTR("OTA begin error: %d"), Update.getError());
+        return false;
+    }
+
+    uint8_t buff[512];
+    uint32_t offset = 0;
+    uint32_t nowCrc = 0;
+    for (uint8_t retry = 0; retry <= OTA_RETRY && offset < size; retry++)
+    {
+        WiFiClient client;
+        HTTPClient http;
+        http.begin(client, url);
+        if (offset > 0)
+        {
+            http.addHeader(F("Range"), "bytes=" + String(offset) + "-");
+            Debug.AddLog(LOG_LEVEL_INFO, PSTR("OTA resume at %d (%d)"), offset, retry);
+        }
+        int code = http.GET();
+        if (code != HTTP_CODE_OK && code != HTTP_CODE_PARTIAL_CONTENT)
+        {
+            Debug.AddLog(LOG_LEVEL_ERROR, PSTR("OTA http code: %d"), code);
+            http.end();
+            delay(1000);
+            continue;
+        }
+
+        // 服务器不支持 Range 时跳过已写入的部分
+        WiFiClient *stream = http.getStreamPtr();
+        uint32_t skip = code == HTTP_CODE_OK ? offset : 0;
+        uint32_t lastRead = millis();
+        while (offset < size && millis() - lastRead < OTA_READ_TIMEOUT)
+        {
+            size_t len = stream->available();
+            if (len == 0)
+            {
+                if (!http.connected())
+                {
+                    break;
+                }
+                delay(1);
+                continue;
+            }
+            lastRead = millis();
+            if (skip > 0)
+            {
+                len = stream->readBytes(buff, std::min((uint32_t)sizeof(buff), skip));
+                skip -= len;
+                continue;
+            }
+            len = stream->readBytes(buff, std::min((uint32_t)sizeof(buff), std::min((uint32_t)len, size - offset)));
+            nowCrc = crc32(nowCrc, buff, len);
+            if (offset + len == size && nowCrc != crc)
+            {
+                Debug.AddLog(LOG_LEVEL_ERROR, PSTR("OTA crc32 error %08x != %08x"), nowCrc, crc);
+                http.end();
+                Update.end();
+                return false;
+            }
+            if (Update.write(buff, len) != len)
+            {
+                Debug.AddLog(LOG_LEVEL_ERROR, PSTR("OTA write error: %d"), Update.getError());
+                http.end();
+                Update.end();
+                return false;
+            }
+            offset += len;
+        }
+        http.end();
+    }
+
+    if (offset < size)
+    {
+        Debug.AddLog(LOG_LEVEL_ERROR, PSTR("OTA download error %d/%d"), offset, size);
+        Update.end();
+        return false;
+    }
+    if (!Update.end())
+    {
+        Debug.AddLog(LOG_LEVEL_ERROR, PSTR("OTA end error: %d"), Update.getError());
+        return false;
+    }
+    return true;
 }
 
 void Wifi::connectWifi()
 {
+    Metrics::add(PSTR("esp_wifi_connect_ms"), METRICS_GAUGE, &connectTime);
+    Metrics::add(PSTR("esp_wifi_fast_fail_total"), METRICS_COUNTER, &fastFailCount);
+    Metrics::add(PSTR("esp_wifi_roam_total"), METRICS_COUNTER, &roamCount);
+    Metrics::add(PSTR("esp_wifi_roam_scan_total"), METRICS_COUNTER, &roamScanCount);
+    Metrics::add(PSTR("esp_wifi_disconnect_total"), METRICS_COUNTER, &disconnectCount);
+    Metrics::add(PSTR("esp_wifi_outage_ms_total"), METRICS_COUNTER, &outageTime);
     delay(50);
     if (globalConfig.wifi.ssid[0] != '\0')
     {
@@ -56,7 +285,6 @@ void Wifi::setupWifi()
 {
     WiFi.persistent(false); // Solve possible wifi init errors (re-add at 6.2.1.16 #4044, #4083)
     WiFi.disconnect(true);  // Delete SDK wifi config
-    delay(200);
     WiFi.mode(WIFI_STA);
     WiFi.setAutoConnect(true);
     WiFi.setAutoReconnect(true);
@@ -68,7 +296,40 @@ void Wifi::setupWifi()
         {
             isDHCP = false;
         }
+        if (connectTime == 0)
+        {
+            connectTime = millis();
+            Debug.AddLog(LOG_LEVEL_INFO, PSTR("WiFi connected in %dms cache: %d%s"), connectTime, cacheFrom, cacheIp ? " ip" : "");
+        }
+        cacheSave(event);
+        linkUp();
+    });
+    STAConnected = WiFi.onStationModeConnected([](const WiFiEventStationModeConnected &event) {
+        if (linkDown && assocTime == 0)
+        {
+            assocTime = millis();
+        }
     });
+    STADisconnected = WiFi.onStationModeDisconnected([](const WiFiEventStationModeDisconnected &event) {
+        if (!linkDown)
+        {
+            // 一次断线期间 SDK 每次重试都会触发, 只记录第一次的原因
+            linkDown = true;
+            downStart = millis();
+            assocTime = 0;
+            disconnectCount++;
+            linkNow.time = millis() / 1000;
+            linkNow.reason = event.reason;
+            linkNow.retry = 0;
+            linkNow.rssi = lastRssi;
+        }
+        else if (linkNow.retry < 255)
+        {
+            linkNow.retry++;
+        }
+        assocTime = 0;
+    });
+    cacheFrom = cacheLoad();
     if (globalConfig.wifi.is_static)
     {
         isDHCP = false;
@@ -81,9 +342,369 @@ void Wifi::setupWifi()
         Debug.AddLog(LOG_LEVEL_INFO, PSTR("Custom STA IP/GW/Subnet: %s %s %s"), globalConfig.wifi.ip, globalConfig.wifi.sn, globalConfig.wifi.gw);
         WiFi.config(static_ip, static_gw, static_sn);
     }
-    WiFi.begin(globalConfig.wifi.ssid, globalConfig.wifi.pass);
+    else if (cacheFrom == 1 && cache.ip != 0)
+    {
+        // 热重启时先沿用上次 DHCP 分配的地址快速上线, 连接后由 fastConnectLoop 启动 DHCP 续约
+        cacheIp = true;
+        WiFi.config(IPAddress(cache.ip), IPAddress(cache.gw), IPAddress(cache.sn), IPAddress(cache.dns));
+    }
+
+    if (cacheFrom != 0)
+    {
+        Debug.AddLog(LOG_LEVEL_INFO, PSTR("Fast connect %02X:%02X:%02X:%02X:%02X:%02X channel %d"), cache.bssid[0], cache.bssid[1], cache.bssid[2], cache.bssid[3], cache.bssid[4], cache.bssid[5], cache.channel);
+        WiFi.begin(globalConfig.wifi.ssid, globalConfig.wifi.pass, cache.channel, cache.bssid);
+        fastConnectStart = millis();
+        directed = true;
+    }
+    else
+    {
+        WiFi.begin(globalConfig.wifi.ssid, globalConfig.wifi.pass);
+    }
+}
+
+#pragma region 快速连接缓存
+
+uint32_t Wifi::cacheCrc(const WifiCache &c)
+{
+    uint32_t crc = crc32(0, (const uint8_t *)globalConfig.wifi.ssid, strlen(globalConfig.wifi.ssid));
+    return crc32(crc, (const uint8_t *)&c + sizeof(c.crc), sizeof(c) - sizeof(c.crc));
+}
+
+/**
+ * 优先读取 RTC 内存, 上电后 RTC 内容无效时读取 flash 备份
+ */
+uint8_t Wifi::cacheLoad()
+{
+    ESP.rtcUserMemoryRead(RTC_WIFI_OFFSET, (uint32_t *)&cache, sizeof(cache));
+    if (cache.channel != 0 && cache.crc == cacheCrc(cache))
+    {
+        return 1;
+    }
+    if (globalConfig.wifi.cache.size == sizeof(cache))
+    {
+        memcpy(&cache, globalConfig.wifi.cache.bytes, sizeof(cache));
+        if (cache.channel != 0 && cache.crc == cacheCrc(cache))
+        {
+            // 断电时间未知, 租约可能已过期, 只使用 BSSID/信道
+            cache.ip = 0;
+            return 2;
+        }
+    }
+    return 0;
+}
+
+void Wifi::cacheSave(const WiFiEventStationModeGotIP &event)
+{
+    WifiCache c;
+    memcpy(c.bssid, WiFi.BSSID(), sizeof(c.bssid));
+    c.channel = WiFi.channel();
+    c.reserved = 0;
+    c.ip = isDHCP ? (uint32_t)event.ip : 0;
+    c.gw = event.gw;
+    c.sn = event.mask;
+    c.dns = WiFi.dnsIP(0);
+    c.crc = cacheCrc(c);
+    ESP.rtcUserMemoryWrite(RTC_WIFI_OFFSET, (uint32_t *)&c, sizeof(c));
+
+    // 有变化才更新 flash 备份, 由 Config::perSecondDo 统一保存
+    if (globalConfig.wifi.cache.size != sizeof(c) || memcmp(globalConfig.wifi.cache.bytes, &c, sizeof(c)) != 0)
+    {
+        memcpy(globalConfig.wifi.cache.bytes, &c, sizeof(c));
+        globalConfig.wifi.cache.size = sizeof(c);
+    }
+}
+
+void Wifi::cacheClear()
+{
+    uint32_t zero = 0;
+    ESP.rtcUserMemoryWrite(RTC_WIFI_OFFSET, &zero, sizeof(zero));
+    globalConfig.wifi.cache.size = 0;
+    cacheFrom = 0;
+}
+
+void Wifi::fastConnectLoop()
+{
+    if (cacheIp && WiFi.isConnected())
+    {
+        // 缓存地址只用于快速上线, 不会自动续约; 连上后立即切回 DHCP, 路由器通常会分配同一地址
+        cacheIp = false;
+        WiFi.config(IPAddress(), IPAddress(), IPAddress());
+        Debug.AddLog(LOG_LEVEL_INFO, PSTR("Fast connect done, DHCP started"));
+    }
+    if (fastConnectStart == 0)
+    {
+        return;
+    }
+    if (WiFi.isConnected())
+    {
+        fastConnectStart = 0;
+        return;
+    }
+    if (millis() - fastConnectStart > WIFI_FAST_TIMEOUT)
+    {
+        // AP 已更换或信道变化, 清除缓存后全信道扫描
+        fastConnectStart = 0;
+        fastFailCount++;
+        Debug.AddLog(LOG_LEVEL_INFO, PSTR("Fast connect timeout, full scan"));
+        cacheClear();
+        if (cacheIp)
+        {
+            cacheIp = false;
+            WiFi.config(IPAddress(), IPAddress(), IPAddress());
+        }
+        WiFi.disconnect();
+        WiFi.begin(globalConfig.wifi.ssid, globalConfig.wifi.pass);
+        directed = false;
+    }
+}
+
+#pragma endregion
+
+#pragma region 链路统计
+
+void Wifi::linkSample(int8_t rssi)
+{
+    lastRssi = rssi;
+    if (rssiCount == 0 || rssi < rssiMin)
+    {
+        rssiMin = rssi;
+    }
+    if (rssiCount == 0 || rssi > rssiMax)
+    {
+        rssiMax = rssi;
+    }
+    rssiSum += rssi;
+    if (rssiCount < 255)
+    {
+        rssiCount++;
+    }
+}
+
+void Wifi::linkLoop()
+{
+    uint32_t minute = millis() / 60000;
+    if (minute == rssiMinute)
+    {
+        return;
+    }
+    rssiMinute = minute;
+    WifiRssiMinute *m = &rssiHistory[rssiHead];
+    m->count = rssiCount;
+    m->min = rssiCount ? rssiMin : 0;
+    m->max = rssiCount ? rssiMax : 0;
+    m->avg = rssiCount ? rssiSum / rssiCount : 0;
+    rssiHead = (rssiHead + 1) % WIFI_RSSI_HISTORY;
+    if (rssiLen < WIFI_RSSI_HISTORY)
+    {
+        rssiLen++;
+    }
+    rssiCount = 0;
+    rssiSum = 0;
+}
+
+void Wifi::linkUp()
+{
+    if (!linkDown)
+    {
+        return;
+    }
+    unsigned long now = millis();
+    linkDown = false;
+    linkNow.outage = now - downStart;
+    linkNow.assoc = assocTime ? min(assocTime - downStart, 65535UL) : 0;
+    linkNow.dhcp = assocTime ? min(now - assocTime, 65535UL) : 0;
+    if (linkNow.reason != 0)
+    {
+        outageTime += linkNow.outage;
+    }
+    linkEvents[linkHead] = linkNow;
+    linkHead = (linkHead + 1) % WIFI_LINK_EVENTS;
+    if (linkLen < WIFI_LINK_EVENTS)
+    {
+        linkLen++;
+    }
+    Debug.AddLog(LOG_LEVEL_INFO, PSTR("Link up: reason %d retry %d outage %dms assoc %dms dhcp %dms"), linkNow.reason, linkNow.retry, linkNow.outage, linkNow.assoc, linkNow.dhcp);
+    assocTime = 0;
+}
+
+String Wifi::linkJson()
+{
+    String json = F("{\"down\":");
+    json += linkDown ? (millis() - downStart) : 0;
+    json += F(",\"disconnect\":");
+    json += disconnectCount;
+    json += F(",\"outage\":");
+    json += outageTime;
+    json += F(",\"roam\":");
+    json += roamCount;
+    json += F(",\"rssi\":[");
+    // 从旧到新 [min,avg,max,count]
+    for (uint8_t i = 0; i < rssiLen; i++)
+    {
+        WifiRssiMinute *m = &rssiHistory[(rssiHead + WIFI_RSSI_HISTORY - rssiLen + i) % WIFI_RSSI_HISTORY];
+        char buf[24];
+        snprintf_P(buf, sizeof(buf), PSTR("%s[%d,%d,%d,%d]"), i ? "," : "", m->min, m->avg, m->max, m->count);
+        json += buf;
+    }
+    json += F("],\"events\":[");
+    for (uint8_t i = 0; i < linkLen; i++)
+    {
+        WifiLinkEvent *e = &linkEvents[(linkHead + WIFI_LINK_EVENTS - linkLen + i) % WIFI_LINK_EVENTS];
+        char buf[100];
+        snprintf_P(buf, sizeof(buf), PSTR("%s{\"time\":%u,\"reason\":%d,\"retry\":%d,\"rssi\":%d,\"outage\":%u,\"assoc\":%d,\"dhcp\":%d}"),
+                   i ? "," : "", e->time, e->reason, e->retry, e->rssi, e->outage, e->assoc, e->dhcp);
+        json += buf;
+    }
+    json += F("]}");
+    return json;
+}
+
+/**
+ * 心跳用的摘要: 最近几分钟的信号范围, 断线次数和最后一次断线
+ */
+String Wifi::linkSummary()
+{
+    int8_t lo = 0, hi = 0;
+    int32_t sum = 0;
+    uint16_t count = 0;
+    uint8_t n = min(rssiLen, (uint8_t)WIFI_LINK_SUMMARY);
+    for (uint8_t i = 0; i < n; i++)
+    {
+        WifiRssiMinute *m = &rssiHistory[(rssiHead + WIFI_RSSI_HISTORY - 1 - i) % WIFI_RSSI_HISTORY];
+        if (m->count == 0)
+        {
+            continue;
+        }
+        if (count == 0 || m->min < lo)
+        {
+            lo = m->min;
+        }
+        if (count == 0 || m->max > hi)
+        {
+            hi = m->max;
+        }
+        sum += m->avg * m->count;
+        count += m->count;
+    }
+    WifiLinkEvent *e = linkLen ? &linkEvents[(linkHead + WIFI_LINK_EVENTS - 1) % WIFI_LINK_EVENTS] : NULL;
+    char buf[120];
+    snprintf_P(buf, sizeof(buf), PSTR("{\"min\":%d,\"avg\":%d,\"max\":%d,\"disconnect\":%u,\"reason\":%d,\"outage\":%u}"),
+               lo, count ? sum / count : 0, hi, disconnectCount, e ? e->reason : 0, e ? e->outage : 0);
+    return String(buf);
 }
 
+#pragma endregion
+
+#pragma region 漫游
+
+void Wifi::roamLoop()
+{
+    if (configPortalStart != 0 || fastConnectStart != 0 || globalConfig.wifi.ssid[0] == '\0')
+    {
+        return;
+    }
+    if (!WiFi.isConnected())
+    {
+        rssiAvg = 0;
+        // 指定 BSSID 后 SDK 自动重连也只连这个 AP, 断线较久时改回按 SSID 连接
+        if (directed)
+        {
+            if (lostTime == 0)
+            {
+                lostTime = millis();
+            }
+            else if (millis() - lostTime > WIFI_FAST_TIMEOUT)
+            {
+                Debug.AddLog(LOG_LEVEL_INFO, PSTR("AP lost, connect by SSID"));
+                directed = false;
+                lostTime = 0;
+                WiFi.begin(globalConfig.wifi.ssid, globalConfig.wifi.pass);
+            }
+        }
+        return;
+    }
+    lostTime = 0;
+    if (millis() - rssiTime < WIFI_RSSI_INTERVAL)
+    {
+        return;
+    }
+    rssiTime = millis();
+    int8_t rssi = WiFi.RSSI();
+    if (rssi >= 0)
+    {
+        return;
+    }
+    linkSample(rssi);
+    if (roamPending)
+    {
+        roamPending = false;
+        roamAfter = rssi;
+        rssiAvg = rssi * 16;
+        Debug.AddLog(LOG_LEVEL_INFO, PSTR("Roamed: %ddBm -> %ddBm"), roamBefore, roamAfter);
+        return;
+    }
+
+    // 指数移动平均 alpha = 1/8
+    rssiAvg = rssiAvg == 0 ? rssi * 16 : rssiAvg + (rssi * 16 - rssiAvg) / 8;
+    if (!roamArmed)
+    {
+        // 刚漫游过: 信号回升或超过扫描间隔后才允许再次漫游
+        if (rssiAvg > (WIFI_ROAM_RSSI + WIFI_ROAM_HYSTERESIS) * 16 || millis() - roamTime > WIFI_ROAM_INTERVAL)
+        {
+            roamArmed = true;
+        }
+        return;
+    }
+    // 没找到更好的 AP 时保持待命, 间隔 WIFI_ROAM_INTERVAL 后再扫描
+    if (rssiAvg < WIFI_ROAM_RSSI * 16 && !scanRunning && (roamTime == 0 || millis() - roamTime > WIFI_ROAM_INTERVAL))
+    {
+        Debug.AddLog(LOG_LEVEL_INFO, PSTR("RSSI avg %ddBm, roam scan"), rssiAvg / 16);
+        roamTime = millis();
+        roamScanCount++;
+        roamScan = true;
+        scanRunning = true;
+        WiFi.scanNetworks(true, false, 0, (uint8 *)globalConfig.wifi.ssid);
+    }
+}
+
+void Wifi::roamScanDone(int8_t n)
+{
+    int8_t current = rssiAvg / 16;
+    int8_t best = -1;
+    int8_t bestRssi = current + WIFI_ROAM_DELTA;
+    uint8_t *bssid = WiFi.BSSID();
+    for (int8_t i = 0; i < n; i++)
+    {
+        if (!WiFi.SSID(i).equals(globalConfig.wifi.ssid) || memcmp(WiFi.BSSID(i), bssid, 6) == 0)
+        {
+            continue;
+        }
+        if (WiFi.RSSI(i) >= bestRssi)
+        {
+            best = i;
+            bestRssi = WiFi.RSSI(i);
+        }
+    }
+    if (best == -1)
+    {
+        Debug.AddLog(LOG_LEVEL_INFO, PSTR("Roam scan: %d APs, none better than %ddBm"), n, current);
+        return;
+    }
+
+    bssid = WiFi.BSSID(best);
+    Debug.AddLog(LOG_LEVEL_INFO, PSTR("Roam to %02X:%02X:%02X:%02X:%02X:%02X channel %d %ddBm (now %ddBm)"), bssid[0], bssid[1], bssid[2], bssid[3], bssid[4], bssid[5], WiFi.channel(best), bestRssi, current);
+    roamCount++;
+    roamArmed = false;
+    roamBefore = current;
+    roamPending = true;
+    rssiTime = millis();
+    WiFi.begin(globalConfig.wifi.ssid, globalConfig.wifi.pass, WiFi.channel(best), bssid);
+    directed = true;
+    fastConnectStart = millis(); // 连接失败时按 SSID 重新连接
+}
+
+#pragma endregion
+
 void Wifi::setupWifiManager(bool resetSettings)
 {
     if (resetSettings)
@@ -136,6 +757,10 @@ void Wifi::tryConnect(String ssid, String pass)
 
 void Wifi::loop()
 {
+    scanLoop();
+    fastConnectLoop();
+    roamLoop();
+    linkLoop();
     if (configPortalStart == 0)
     {
         return;
@@ -202,6 +827,90 @@ void Wifi::loop()
     }
 }
 
+uint32_t Wifi::ssidHash(const char *ssid)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261UL;
+    while (*ssid)
+    {
+        hash ^= (uint8_t)*ssid++;
+        hash *= 16777619UL;
+    }
+    return hash;
+}
+
+void Wifi::scanStart()
+{
+    if (scanRunning)
+    {
+        return;
+    }
+    scanRunning = true;
+    WiFi.scanNetworks(true);
+}
+
+void Wifi::scanLoop()
+{
+    if (!scanRunning)
+    {
+        return;
+    }
+    int8_t n = WiFi.scanComplete();
+    if (n == WIFI_SCAN_RUNNING)
+    {
+        return;
+    }
+    scanRunning = false;
+    if (n < 0)
+    {
+        n = 0;
+    }
+    if (roamScan)
+    {
+        // 漫游扫描只有同名 AP, 不覆盖页面用的扫描结果
+        roamScan = false;
+        roamScanDone(n);
+        return;
+    }
+
+    // 下一次扫描 (包括漫游扫描) 会清空SDK中的结果，SSID 需要复制出来
+    scanCount = 0;
+    for (int8_t i = 0; i < n && scanCount < WIFI_SCAN_MAX; i++)
+    {
+        WifiScanResult *r = &scanResult[scanCount++];
+        strncpy(r->ssid, WiFi.SSID(i).c_str(), sizeof(r->ssid) - 1);
+        r->ssid[sizeof(r->ssid) - 1] = '\0';
+        r->hash = ssidHash(r->ssid);
+        r->rssi = WiFi.RSSI(i);
+        r->enc = WiFi.encryptionType(i);
+        r->channel = WiFi.channel(i);
+    }
+
+    // 按 SSID 分组、组内信号强的在前，去重后再按信号排序
+    std::sort(scanResult, scanResult + scanCount, [](const WifiScanResult &a, const WifiScanResult &b) {
+        return a.hash != b.hash ? a.hash < b.hash : a.rssi > b.rssi;
+    });
+    uint8_t j = 0;
+    for (uint8_t i = 0; i < scanCount; i++)
+    {
+        if (j == 0 || scanResult[j - 1].hash != scanResult[i].hash)
+        {
+            scanResult[j++] = scanResult[i];
+        }
+    }
+    scanCount = j;
+    std::sort(scanResult, scanResult + scanCount, [](const WifiScanResult &a, const WifiScanResult &b) {
+        return a.rssi > b.rssi;
+    });
+
+    scanTime = millis();
+    if (scanTime == 0)
+    {
+        scanTime = 1;
+    }
+    Debug.AddLog(LOG_LEVEL_INFO, PSTR("Scan done: %d networks, %d unique"), n, scanCount);
+}
+
 boolean Wifi::isIp(String str)
 {
     int a, b, c, d;
@@ -2,9 +2,11 @@
 
 #include "Debug.h"
 #include "Led.h"
+#include "Button.h"
 #include "XiaoAi.h"
 #include "Mqtt.h"
 #include "Wifi.h"
+#include "Watchdog.h"
 
 #pragma region 继承
 
@@ -14,6 +16,7 @@ void XiaoAi::init()
     {
         Led::init(config.pin_led > 30 ? config.pin_led - 30 : config.pin_led, config.pin_led > 30 ? LOW : HIGH);
     }
+    Button::add(config.pin_btn, BUTTON_MODE_PUSH, buttonCallback);
     Serial.println();
 }
 
@@ -35,7 +38,6 @@ bool XiaoAi::moduleLed()
 void XiaoAi::loop()
 {
     serialEvent();
-    checkButton();
 
     if (bitRead(operationFlag, 0))
     {
@@ -108,47 +110,16 @@ void XiaoAi::perSecondDo()
     }
 }
 
-void XiaoAi::checkButton()
+void XiaoAi::buttonCallback(uint8_t arg, uint8_t event, uint8_t count)
 {
-    boolean buttonState = digitalRead(config.pin_btn);
-
-    if (buttonState == 0)
-    { // 按下按钮
-        if (buttonTiming == false)
-        {
-            buttonTiming = true;
-            buttonTimingStart = millis();
-        }
-        else
-        { // buttonTiming = true
-            if (millis() >= (buttonTimingStart + buttonDebounceTime))
-            {
-                buttonAction = 1;
-            }
-
-            if (millis() >= (buttonTimingStart + buttonLongPressTime))
-            {
-                buttonAction = 2;
-            }
-        }
+    if (event == BUTTON_EVENT_CLICK) // 执行短按动作
+    {
+        Debug.AddLog(LOG_LEVEL_INFO, PSTR("buttonShortPressAction %d"), count);
     }
-    else
-    { // buttonState == 1, 释放按钮
-        buttonTiming = false;
-
-        if (buttonAction != 0)
-        {
-            if (buttonAction == 1) // 执行短按动作
-            {
-                Debug.AddLog(LOG_LEVEL_INFO, PSTR("buttonShortPressAction"));
-            }
-            else if (buttonAction == 2) // 执行长按动作
-            {
-                Debug.AddLog(LOG_LEVEL_INFO, PSTR("buttonLongPressAction"));
-                Wifi::setupWifiManager(false);
-            }
-            buttonAction = 0;
-        }
+    else if (event == BUTTON_EVENT_LONG) // 执行长按动作
+    {
+        Debug.AddLog(LOG_LEVEL_INFO, PSTR("buttonLongPressAction"));
+        Wifi::setupWifiManager(false);
     }
 }
 #pragma endregion
@@ -243,18 +214,31 @@ void XiaoAi::mqttConnected()
 
 #pragma region HTTP
 
-void XiaoAi::httpAdd(ESP8266WebServer *server)
+void XiaoAi::httpAdd(HttpServer *server)
 {
     server->on(F("/xiaoai_setting"), std::bind(&XiaoAi::httpSetting, this, server));
     server->on(F("/cmd_setting"), std::bind(&XiaoAi::httpCmd, this, server));
 }
 
-String XiaoAi::httpGetStatus(ESP8266WebServer *server)
+String XiaoAi::httpGetStatus(HttpServer *server)
 {
     return "";
 }
 
-void XiaoAi::httpHtml(ESP8266WebServer *server)
+boolean XiaoAi::batchCommand(String key, String value)
+{
+    return false;
+}
+
+void XiaoAi::batchCommit()
+{
+}
+
+void XiaoAi::scheduleDo(uint8_t target, uint8_t value)
+{
+}
+
+void XiaoAi::httpHtml(HttpServer *server)
 {
     String page = F("<form method='post' action='/xiaoai_setting' onsubmit='postform(this);return false'>");
     page += F("<table class='gridtable'><thead><tr><th colspan='2'>小爱设置</th></tr></thead><tbody>");
@@ -271,7 +255,7 @@ void XiaoAi::httpHtml(ESP8266WebServer *server)
     server->sendContent(page);
 }
 
-void XiaoAi::httpSetting(ESP8266WebServer *server)
+void XiaoAi::httpSetting(HttpServer *server)
 {
     strcpy(config.password, server->arg(F("password")).c_str());
 
@@ -279,7 +263,7 @@ void XiaoAi::httpSetting(ESP8266WebServer *server)
     server->send(200, F("text/html"), F("{\"code\":1,\"msg\":\"已经设置成功。\"}"));
 }
 
-void XiaoAi::httpCmd(ESP8266WebServer *server)
+void XiaoAi::httpCmd(HttpServer *server)
 {
     String cmd = server->arg(F("cmd")).c_str();
 
@@ -296,9 +280,10 @@ void XiaoAi::serialEvent()
 {
     while (Serial.available())
     {
+        Watchdog::mark();
         delay(10);
         String str = Serial.readString();
-        Serial1.println(str);
+        Debug.serial1Tx.writeLine(str.c_str(), "");
         //Debug.AddLog(LOG_LEVEL_INFO, PSTR("%s"), str.c_str());
         if ((str.indexOf("Please press Enter to activate this console") > 0) || (str.indexOf("crond (busybox 1.27.2) started, log level 5") > 0))
         {
@@ -313,7 +298,7 @@ void XiaoAi::serialEvent()
             Serial.print("root"); //mico login:
             delay(100);
             Serial.println();
-            Led::blinkLED(100, 10);
+            Led::play(&LED_LOGIN);
         }
         if (str.indexOf("Password: ") > 0)
         {
@@ -321,7 +306,7 @@ void XiaoAi::serialEvent()
             Serial.printf("%s", config.password); //Password:
             delay(100);
             Serial.println();
-            Led::blinkLED(100, 10);
+            Led::play(&LED_LOGIN);
         }
         if (!isLogin && (str.indexOf("root@mico:~#") > 0 || str.indexOf("root@mico:/") > 0))
         {
@@ -4,6 +4,7 @@
 #include "Zinguo.h"
 #include "Mqtt.h"
 #include "Wifi.h"
+#include "Lan.h"
 
 #pragma region 继承
 
@@ -53,7 +54,7 @@ void Zinguo::loop()
             {
                 if (millis() >= (buttonTimingStart + buttonDebounceTime))
                 {
-                    Debug.AddLog(LOG_LEVEL_INFO, "TouchKey: 0x%0X", key);
+                    Debug.AddLog(LOG_LEVEL_DEBUG, PSTR("TouchKey: 0x%0X"), key);
                     touchKey = key; //缓冲当前按键键值
                     analysisKey(touchKey);
                 }
@@ -102,7 +103,7 @@ void Zinguo::loop()
     if (bitRead(operationFlag, 3))
     {
         bitClear(operationFlag, 3);
-        Debug.AddLog(LOG_LEVEL_INFO, "Ventilation Timeout %d %d", ventilationTime, perSecond);
+        Debug.AddLog(LOG_LEVEL_INFO, PSTR("Ventilation Timeout %d %d"), ventilationTime, perSecond);
         ventilationTime = 0;
         switchVentilation(false);
     }
@@ -110,7 +111,7 @@ void Zinguo::loop()
     if (bitRead(operationFlag, 4))
     {
         bitClear(operationFlag, 4);
-        Debug.AddLog(LOG_LEVEL_INFO, "Warm Timeout %d %d", warmTime, perSecond);
+        Debug.AddLog(LOG_LEVEL_INFO, PSTR("Warm Timeout %d %d"), warmTime, perSecond);
         warmTime = 0;
         switchWarm1(false);
         switchWarm2(false);
@@ -288,13 +289,13 @@ void Zinguo::mqttDiscovery(boolean isEnable)
 
 #pragma region HTTP
 
-void Zinguo::httpAdd(ESP8266WebServer *server)
+void Zinguo::httpAdd(HttpServer *server)
 {
     server->on(F("/zinguo_setting"), std::bind(&Zinguo::httpSetting, this, server));
     server->on(F("/zinguo_do"), std::bind(&Zinguo::httpDo, this, server));
 }
 
-String Zinguo::httpGetStatus(ESP8266WebServer *server)
+String Zinguo::httpGetStatus(HttpServer *server)
 {
     String data = F("\"zinguo_light\":");
     data += bitRead(controlOut, KEY_LIGHT - 1) ? 1 : 0;
@@ -309,7 +310,7 @@ String Zinguo::httpGetStatus(ESP8266WebServer *server)
     return data;
 }
 
-void Zinguo::httpHtml(ESP8266WebServer *server)
+void Zinguo::httpHtml(HttpServer *server)
 {
     String radioJs = F("<script type='text/javascript'>");
     radioJs += F("function setDataSub(data,key){if(key.substr(0,6)=='zinguo'){id(key).setAttribute('class',data[key]==1?'btn-success':'btn-info');return true}return false}");
@@ -402,14 +403,108 @@ void Zinguo::httpHtml(ESP8266WebServer *server)
     server->sendContent(radioJs);
 }
 
-void Zinguo::httpDo(ESP8266WebServer *server)
+void Zinguo::httpDo(HttpServer *server)
 {
     analysisKey(server->arg(F("key")).toInt());
 
     server->send(200, F("text/html"), "{\"code\":1,\"msg\":\"操作成功\",\"data\":{" + httpGetStatus(server) + "}}");
 }
 
-void Zinguo::httpSetting(ESP8266WebServer *server)
+boolean Zinguo::batchCommand(String key, String value)
+{
+    uint8_t k;
+    if (key.equals(F("zinguo_light")))
+    {
+        k = KEY_LIGHT;
+    }
+    else if (key.equals(F("zinguo_ventilation")))
+    {
+        k = KEY_VENTILATION;
+    }
+    else if (key.equals(F("zinguo_close")))
+    {
+        k = KEY_CLOSE_ALL;
+    }
+    else if (key.equals(F("zinguo_warm1")))
+    {
+        k = KEY_WARM_1;
+    }
+    else if (key.equals(F("zinguo_warm2")))
+    {
+        k = KEY_WARM_2;
+    }
+    else if (key.equals(F("zinguo_blow")))
+    {
+        k = KEY_BLOW;
+    }
+    else
+    {
+        return false;
+    }
+
+    isBatch = true;
+    switchKey(k, value == "ON" ? true : (value == "OFF" ? false : !bitRead(controlOut, k - 1)), false);
+    return true;
+}
+
+void Zinguo::batchCommit()
+{
+    isBatch = false;
+    if (batchPublish == 0)
+    {
+        return;
+    }
+    for (uint8_t k = 1; k <= 8; k++)
+    {
+        if (bitRead(batchPublish, k - 1))
+        {
+            publishState(k, bitRead(controlOut, k - 1));
+        }
+    }
+    batchPublish = 0;
+    // 批量操作只响一次
+    if (config.beep)
+    {
+        beepBeep(1);
+    }
+}
+
+void Zinguo::scheduleDo(uint8_t target, uint8_t value)
+{
+    // target 为按键编号 KEY_x
+    if (target < 1 || target > 8)
+    {
+        return;
+    }
+    switchKey(target, value == 2 ? !bitRead(controlOut, target - 1) : value == 1, true);
+}
+
+void Zinguo::switchKey(uint8_t key, boolean isOn, bool isBeep)
+{
+    switch (key)
+    {
+    case KEY_LIGHT:
+        switchLight(isOn, isBeep);
+        break;
+    case KEY_VENTILATION:
+        switchVentilation(isOn, isBeep);
+        break;
+    case KEY_CLOSE_ALL:
+        switchCloseAll(isOn, isBeep);
+        break;
+    case KEY_WARM_1:
+        switchWarm1(isOn, isBeep);
+        break;
+    case KEY_WARM_2:
+        switchWarm2(isOn, isBeep);
+        break;
+    case KEY_BLOW:
+        switchBlow(isOn, isBeep);
+        break;
+    }
+}
+
+void Zinguo::httpSetting(HttpServer *server)
 {
     config.dual_motor = server->arg(F("dual_motor")) == "1" ? true : false;
     config.dual_warm = server->arg(F("dual_warm")) == "1" ? true : false;
@@ -626,6 +721,41 @@ void Zinguo::convertTemp(void)
     }
 }
 
+void Zinguo::publishState(uint8_t key, bool isOn)
+{
+    Lan::stateChanged();
+    if (isBatch)
+    {
+        bitSet(batchPublish, key - 1);
+        return;
+    }
+    const char *name;
+    switch (key)
+    {
+    case KEY_LIGHT:
+        name = "light";
+        break;
+    case KEY_VENTILATION:
+        name = "ventilation";
+        break;
+    case KEY_CLOSE_ALL:
+        name = "close";
+        break;
+    case KEY_WARM_1:
+        name = "warm1";
+        break;
+    case KEY_WARM_2:
+        name = "warm2";
+        break;
+    case KEY_BLOW:
+        name = "blow";
+        break;
+    default:
+        return;
+    }
+    mqtt->publish(mqtt->getStatTopic(name), isOn ? "ON" : "OFF", globalConfig.mqtt.retain);
+}
+
 // 照明 Key1
 void Zinguo::switchLight(boolean isOn, bool isBeep)
 {
@@ -650,7 +780,7 @@ void Zinguo::switchLight(boolean isOn, bool isBeep)
     {
         beepBeep(1);
     }
-    mqtt->publish(mqtt->getStatTopic("light"), isOn ? "ON" : "OFF", globalConfig.mqtt.retain);
+    publishState(KEY_LIGHT, isOn);
 }
 
 // 换气 Key2
@@ -674,7 +804,7 @@ void Zinguo::switchVentilation(boolean isOn, bool isBeep)
                 {
                     beepBeep(2);
                 }
-                mqtt->publish(mqtt->getStatTopic("ventilation"), bitRead(controlOut, KEY_VENTILATION - 1) ? "ON" : "OFF", globalConfig.mqtt.retain);
+                publishState(KEY_VENTILATION, bitRead(controlOut, KEY_VENTILATION - 1));
                 return;
             }
             switchBlowReal(false, false); // 单电机要关吹风
@@ -699,7 +829,7 @@ void Zinguo::switchVentilation(boolean isOn, bool isBeep)
     {
         beepBeep(1);
     }
-    mqtt->publish(mqtt->getStatTopic("ventilation"), isOn ? "ON" : "OFF", globalConfig.mqtt.retain);
+    publishState(KEY_VENTILATION, isOn);
 }
 
 // 取暖1 Key8
@@ -747,7 +877,7 @@ void Zinguo::switchWarm1(boolean isOn, bool isBeep)
     {
         beepBeep(1);
     }
-    mqtt->publish(mqtt->getStatTopic("warm1"), isOn ? "ON" : "OFF", globalConfig.mqtt.retain);
+    publishState(KEY_WARM_1, isOn);
 }
 
 // 取暖2 Key6
@@ -803,7 +933,7 @@ void Zinguo::switchWarm2(boolean isOn, bool isBeep)
         return;
     }
 
-    mqtt->publish(mqtt->getStatTopic("warm2"), isOn ? "ON" : "OFF", globalConfig.mqtt.retain);
+    publishState(KEY_WARM_2, isOn);
 }
 
 // 吹风 Key7
@@ -834,7 +964,7 @@ void Zinguo::switchBlowReal(boolean isOn, bool isBeep)
     {
         beepBeep(1);
     }
-    mqtt->publish(mqtt->getStatTopic("blow"), isOn ? "ON" : "OFF", globalConfig.mqtt.retain);
+    publishState(KEY_BLOW, isOn);
 }
 
 void Zinguo::switchBlow(boolean isOn, bool isBeep)
@@ -885,7 +1015,7 @@ void Zinguo::switchCloseAll(boolean isOn, bool isBeep)
     mqtt->publish("cmnd/rsq/POWER", isOn ? "ON" : "OFF", globalConfig.mqtt.retain);
 #else
     dispCtrl();
-    mqtt->publish(mqtt->getStatTopic("close"), isOn ? "ON" : "OFF", globalConfig.mqtt.retain);
+    publishState(KEY_CLOSE_ALL, isOn);
     switchLight(false, false);
     switchVentilation(false, false);
     switchBlow(false, false);
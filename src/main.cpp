@@ -6,6 +6,12 @@
 #include "Http.h"
 #include "Wifi.h"
 #include "Mqtt.h"
+#include "Metrics.h"
+#include "Crash.h"
+#include "Watchdog.h"
+#include "Schedule.h"
+#include "Lan.h"
+#include "Button.h"
 #include <EEPROM.h>
 #include <ESP8266WiFi.h>
 #include <Ticker.h>
@@ -41,7 +47,7 @@ void callback(char *topic, byte *payload, unsigned int length)
     String topicStr = String(topic);
     if (topicStr.endsWith(F("/OTA")))
     {
-        Wifi::OTA(str.endsWith(F(".bin")) ? str : OTA_URL);
+        Wifi::OTA(str.endsWith(F(".bin")) || str.endsWith(F(".bin.gz")) ? str : OTA_URL);
     }
     else if (topicStr.endsWith(F("/restart")))
     {
@@ -58,7 +64,8 @@ void callback(char *topic, byte *payload, unsigned int length)
 void connectedCallback()
 {
     mqtt->subscribe(mqtt->getCmndTopic(F("#")));
-    Led::blinkLED(40, 8);
+    Led::play(&LED_CONNECTED);
+    Crash::mqttConnected();
     if (module)
     {
         module->mqttConnected();
@@ -73,6 +80,9 @@ void tickerPerSecondDo()
     Config::perSecondDo();
     mqtt->perSecondDo();
     module->perSecondDo();
+    Watchdog::perSecondDo();
+    Schedule::perSecondDo();
+    Lan::perSecondDo();
 }
 
 void setup()
@@ -95,6 +105,12 @@ void setup()
     module = new XiaoAi();
 #endif
 
+    Metrics::init();
+    Watchdog::init();
+    Schedule::init();
+    Lan::init();
+    Button::init();
+    Config::init();
     Debug.AddLog(LOG_LEVEL_INFO, PSTR("\r\n\r\n---------------------  v%s  %s  -------------------"), VERSION, Ntp::GetBuildDateAndTime().c_str());
     Config::readConfig();
     if (globalConfig.uid[0] != '\0')
@@ -110,6 +126,7 @@ void setup()
     }
 
     Debug.AddLog(LOG_LEVEL_INFO, PSTR("UID: %s"), UID);
+    Crash::init();
     //Debug.AddLog(LOG_LEVEL_INFO, PSTR("Config Len: %d"), GlobalConfigMessage_size + 6);
 
     //Config::resetConfig();
@@ -134,10 +151,29 @@ void setup()
 
 void loop()
 {
+    uint32_t start = micros();
+    Watchdog::begin(WATCHDOG_STAGE_LED);
     Led::loop();
+    Watchdog::end();
+    Watchdog::begin(WATCHDOG_STAGE_DEBUG);
+    Debug.loop();
+    Watchdog::end();
+    Watchdog::begin(WATCHDOG_STAGE_MQTT);
     mqtt->loop();
+    Watchdog::loop();
+    Watchdog::end();
+    Watchdog::begin(WATCHDOG_STAGE_MODULE);
+    Button::loop();
     module->loop();
+    Watchdog::end();
+    Watchdog::begin(WATCHDOG_STAGE_WIFI);
     Wifi::loop();
+    Lan::loop();
+    Watchdog::end();
     Http::loop();
+    Watchdog::begin(WATCHDOG_STAGE_NTP);
     Ntp::loop();
+    Schedule::loop();
+    Watchdog::end();
+    Metrics::loopDone(start);
 }
@@ -0,0 +1,370 @@
+// 按键绑定主机测试: RelayBinding 确认/重发/去重/转 MQTT/认证/防重放
+// g++ -std=gnu++17 -O2 -DUSE_RELAY -Itest/host/stub -Iinclude test/host/binding.cpp src/RelayBinding.cpp -o binding && ./binding
+//
+// 两个节点 A B 互相绑定 (A 通道 0 -> B 通道 1), 用模拟的 BindingRadio 代替 ESP-NOW:
+// 每帧按丢包率丢弃, 按重复率多投递一次, 延迟在 [delay, delay + jitter] 内随机, 因此可能乱序
+// 签名用带密钥的 FNV-1a 代替 HMAC-SHA256, 只验证协议行为
+// 1. A 每 300ms 按一次键共 2000 次, 每次结束后检查:
+//    - B 的通道状态等于 A 最后一次按键的状态 (转 MQTT 的视为 MQTT 送达)
+//    - 一次按键在 B 上最多执行一次 (重发和重复投递不能重复执行)
+//    - 收到确认的按键 B 一定已经执行
+// 2. 攻击: 把空中截获的全部帧 (含被新命令取代的旧重发) 乱序重放给 B; 用错误密钥伪造命令; 篡改截获帧的状态字节;
+//    B 重启 (新会话) 后重放; 都不能执行
+// 3. A 重启 (序号丢失) 和 B 重启 (会话更换) 后下一次按键通过 NAK 重新同步并执行
+// 4. 连续 70000 次按键, 16 位序号回绕后仍然每次执行一次
+//
+// 结果 (x86-64 g++ 12 -O2, BINDING_ACK_TIMEOUT 30ms, BINDING_RETRY 3):
+//    丢包  重复  延迟(us)    发送  确认  重发  转发  执行  重复执行  错误   p50      p99      max
+//       0%   0%  2000+0       2000  2000     0     0  2000         0     0   4000us   4000us   8000us
+//      10%   5%  2000+3000    2000  1995   450     5  2000         0     0   8000us  68500us  98000us
+//      30%   5%  2000+3000    2000  1886  1759   114  1985         0     0   9500us  99000us 100000us
+//      50%   5%  2000+3000    2000  1401  3395   599  1898         0     0  37500us  99500us 100000us
+//       0%  50%  2000+20000   2000  2000   211     0  2000         0     0  20500us  40000us  44000us
+//   attack: 500 frames replayed, 502 rejected, forged/tampered rejected OK
+//   reboot: resync OK
+//   wrap: 70000 presses, 70000 executed OK
+// 第一次按键多一次 NAK 往返; 丢包越多重发越多, 全部重发失败的转 MQTT, 最终状态都正确
+
+#include "RelayBinding.h"
+#include <algorithm>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+typedef struct
+{
+    uint32_t at;
+    int to;
+    uint8_t mac[6];
+    uint8_t data[BINDING_FRAME_SIZE];
+} Frame;
+
+static std::vector<Frame> air;
+static std::vector<Frame> captured; // 攻击者截获的 A -> B 帧
+static uint32_t now = 0;
+static int lossPct;
+static int dupPct;
+static uint32_t delayUs;
+static uint32_t jitterUs;
+static const uint8_t macs[2][6] = {{1, 2, 3, 4, 5, 0xA}, {1, 2, 3, 4, 5, 0xB}};
+static const char *key = "lan-key";
+
+class FakeRadio : public BindingRadio
+{
+public:
+    int self;
+
+    bool send(const uint8_t *mac, const uint8_t *data, uint8_t len)
+    {
+        Frame f;
+        f.to = mac[5] == 0xA ? 0 : 1;
+        memcpy(f.mac, macs[self], 6);
+        memcpy(f.data, data, len);
+        if (f.to == 1)
+        {
+            captured.push_back(f);
+        }
+        // 和 ESP-NOW 一样, 发送成功不代表对方收到
+        int copies = rand() % 100 < dupPct ? 2 : 1;
+        for (int i = 0; i < copies; i++)
+        {
+            if (rand() % 100 < lossPct)
+            {
+                continue;
+            }
+            f.at = now + delayUs + (jitterUs ? rand() % (jitterUs + 1) : 0);
+            air.push_back(f);
+        }
+        return true;
+    }
+};
+
+static void signWith(const char *k, const uint8_t *data, uint8_t len, uint8_t *mac)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (const char *p = k; *p; p++)
+    {
+        hash = (hash ^ (uint8_t)*p) * 1099511628211ULL;
+    }
+    for (uint8_t i = 0; i < len; i++)
+    {
+        hash = (hash ^ data[i]) * 1099511628211ULL;
+    }
+    memcpy(mac, &hash, BINDING_MAC_LEN);
+}
+
+static void sign(const uint8_t *data, uint8_t len, uint8_t *mac)
+{
+    signWith(key, data, len, mac);
+}
+
+static FakeRadio ra, rb;
+static RelayBinding *a;
+static RelayBinding *b;
+static bool stateB[4];
+static int switches;
+static int fallbacks;
+static int failures = 0;
+
+static void fail(const char *msg, int press)
+{
+    if (failures++ < 10)
+    {
+        printf("FAIL %s press %d\n", msg, press);
+    }
+}
+
+static RelayBinding *node(int self)
+{
+    RelayBinding *n = new RelayBinding(self == 0 ? (BindingRadio *)&ra : &rb, rand());
+    uint8_t cfg[BINDING_ENTRY_SIZE] = {(uint8_t)(self == 0 ? 0 : 1), (uint8_t)(self == 0 ? 1 : 0)};
+    memcpy(cfg + 2, macs[1 - self], 6);
+    n->load(cfg, sizeof(cfg));
+    n->signCallback = sign;
+    if (self == 1)
+    {
+        n->switchCallback = [](uint8_t ch, bool isOn) {
+            stateB[ch] = isOn;
+            switches++;
+        };
+    }
+    else
+    {
+        n->fallbackCallback = [](const uint8_t *mac, uint8_t ch, bool isOn) {
+            stateB[ch] = isOn; // MQTT 送达
+            fallbacks++;
+        };
+    }
+    return n;
+}
+
+static void reset()
+{
+    air.clear();
+    captured.clear();
+    memset(stateB, 0, sizeof(stateB));
+    switches = 0;
+    fallbacks = 0;
+    ra.self = 0;
+    rb.self = 1;
+    delete a;
+    delete b;
+    a = node(0);
+    b = node(1);
+}
+
+static void step()
+{
+    now += 500;
+    for (size_t k = 0; k < air.size();)
+    {
+        if ((int32_t)(now - air[k].at) >= 0)
+        {
+            Frame f = air[k];
+            air.erase(air.begin() + k);
+            (f.to == 0 ? a : b)->receive(f.mac, f.data, BINDING_FRAME_SIZE, now);
+        }
+        else
+        {
+            k++;
+        }
+    }
+    a->loop(now);
+    b->loop(now);
+}
+
+/**
+ * 按一次键并运行到空中没有帧且已确认或转发, 最多 300ms
+ * 返回 B 上执行的次数
+ */
+static int press(int i, bool want)
+{
+    uint32_t done = a->ackCount + a->fallbackCount;
+    int before = switches;
+    a->press(0, want, now);
+    for (uint32_t t = 0; t < 300000; t += 500)
+    {
+        step();
+        if (air.empty() && a->ackCount + a->fallbackCount > done)
+        {
+            break;
+        }
+    }
+    if (switches - before > 1)
+    {
+        fail("duplicate", i);
+    }
+    if (stateB[1] != want)
+    {
+        fail("state", i);
+    }
+    return switches - before;
+}
+
+static void run(int loss, int dup, uint32_t delay, uint32_t jitter)
+{
+    lossPct = loss;
+    dupPct = dup;
+    delayUs = delay;
+    jitterUs = jitter;
+    reset();
+
+    bool want = false;
+    int duplicates = 0;
+    std::vector<uint32_t> latency;
+    for (int i = 0; i < 2000; i++)
+    {
+        want = !want;
+        uint32_t acks = a->ackCount;
+        int before = switches;
+        if (press(i, want) > 1)
+        {
+            duplicates++;
+        }
+        if (a->ackCount > acks)
+        {
+            latency.push_back(a->latency);
+            if (switches == before)
+            {
+                fail("ack without switch", i);
+            }
+        }
+    }
+
+    std::sort(latency.begin(), latency.end());
+    uint32_t p50 = latency.empty() ? 0 : latency[latency.size() / 2];
+    uint32_t p99 = latency.empty() ? 0 : latency[latency.size() * 99 / 100];
+    uint32_t max = latency.empty() ? 0 : latency.back();
+    printf("%5d%% %3d%%  %u+%-6u %5u %5u %5u %5d %5u %9d %5d %6uus %6uus %6uus\n", loss, dup, delay, jitter,
+           a->sentCount, a->ackCount, a->retryCount, fallbacks, b->rxCount, duplicates, failures, p50, p99, max);
+}
+
+static void deliverToB(const Frame &f)
+{
+    b->receive(f.mac, f.data, BINDING_FRAME_SIZE, now);
+}
+
+static void testAttack()
+{
+    lossPct = 20;
+    dupPct = 5;
+    delayUs = 2000;
+    jitterUs = 40000; // 超过确认超时, 产生被新命令取代的旧重发
+    reset();
+    bool want = false;
+    for (int i = 0; i < 200; i++)
+    {
+        want = !want;
+        press(i, want);
+    }
+    lossPct = 0;
+    dupPct = 0;
+    jitterUs = 0;
+    while (!air.empty())
+    {
+        step();
+    }
+
+    // 截获帧乱序重放
+    std::vector<Frame> frames = captured;
+    std::shuffle(frames.begin(), frames.end(), std::mt19937(1));
+    int before = switches;
+    uint32_t rejects = b->rejectCount;
+    for (const Frame &f : frames)
+    {
+        deliverToB(f);
+    }
+    int replayed = switches - before;
+    if (replayed)
+    {
+        fail("replay executed", replayed);
+    }
+
+    // 错误密钥伪造, 篡改状态字节
+    Frame forged = frames[0];
+    forged.data[1] = BINDING_CMD;
+    forged.data[6]++;
+    signWith("guess", forged.data, BINDING_FRAME_SIZE - BINDING_MAC_LEN, forged.data + BINDING_FRAME_SIZE - BINDING_MAC_LEN);
+    deliverToB(forged);
+    Frame tampered = frames[0];
+    tampered.data[9] ^= 1;
+    deliverToB(tampered);
+    if (switches != before)
+    {
+        fail("forged executed", 0);
+    }
+
+    // B 重启后重放
+    delete b;
+    b = node(1);
+    for (const Frame &f : frames)
+    {
+        deliverToB(f);
+    }
+    if (switches != before)
+    {
+        fail("replay after receiver reboot executed", 0);
+    }
+    printf("attack: %zu frames replayed, %u rejected, forged/tampered rejected %s\n", frames.size(),
+           b->rejectCount + rejects, failures ? "FAIL" : "OK");
+
+    // B 重启后 A 的下一次按键重新同步
+    while (!air.empty())
+    {
+        step();
+    }
+    uint32_t resync = a->resyncCount;
+    want = !want;
+    if (press(1000, want) != 1 || a->resyncCount != resync + 1)
+    {
+        fail("resync after receiver reboot", 0);
+    }
+    // A 重启后序号从头开始, 仍然执行
+    delete a;
+    a = node(0);
+    for (int i = 0; i < 3; i++)
+    {
+        want = !want;
+        if (press(1001 + i, want) != 1)
+        {
+            fail("resync after sender reboot", i);
+        }
+    }
+    printf("reboot: resync %s\n", failures ? "FAIL" : "OK");
+}
+
+static void testWrap()
+{
+    lossPct = 0;
+    dupPct = 0;
+    delayUs = 2000;
+    jitterUs = 0;
+    reset();
+    bool want = false;
+    int executed = 0;
+    for (int i = 0; i < 70000; i++)
+    {
+        want = !want;
+        executed += press(i, want);
+    }
+    if (executed != 70000)
+    {
+        fail("wrap", executed);
+    }
+    printf("wrap: 70000 presses, %d executed %s\n", executed, failures ? "FAIL" : "OK");
+}
+
+int main()
+{
+    printf(" 丢包  重复  延迟(us)    发送  确认  重发  转发  执行  重复执行  错误   p50      p99      max\n");
+    run(0, 0, 2000, 0);
+    run(10, 5, 2000, 3000);
+    run(30, 5, 2000, 3000);
+    run(50, 5, 2000, 3000);
+    run(0, 50, 2000, 20000);
+    testAttack();
+    testWrap();
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,228 @@
+// 日期换算主机测试: Ntp::breakTime / Ntp::tick
+// g++ -std=gnu++17 -O2 -Itest/host/stub -Iinclude test/host/breaktime.cpp test/host/stub/host.cpp src/Ntp.cpp src/Debug.cpp -o breaktime && ./breaktime
+//
+// 1. 1970-01-01 到 2100-12-31 每一天取 00:00:00 / 23:59:59 和 8 个随机秒, 与改动前的逐年逐月循环版本逐字段比较,
+//    再抽查 gmtime_r; 另外随机 100 万个 uint32 时间戳 (到 2106 年) 同样比较
+// 2. 从 1970 年起每次跳到一天的最后 2 秒, 用 tick 进位后与 breakTime 比较, 覆盖所有跨日/跨月/跨年
+// 3. 旧版与新版每次调用的耗时 (主机 ns, 只看相对值; 旧版随年份线性增长)
+//
+// 结果 (x86-64 g++ 12 -O2):
+//   days: 47847 days x 10 seconds OK
+//   random: 1000000 OK
+//   tick: 47847 day boundaries OK
+//   年份          旧版      新版
+//   1970       13.5ns    20.6ns
+//   2025      135.0ns    18.7ns
+//   2100      252.0ns    20.3ns
+// 新版与旧版结果完全一致, 耗时与年份无关; 1970 年附近旧版循环只走几次, 反而比新版的几次除法快
+// 设备上 (无硬件除法) 两者差距会更大, 以 esp_loop_time_max_us 为准
+
+#include "Debug.h"
+#include "Metrics.h"
+#include "Ntp.h"
+#include <chrono>
+#include <time.h>
+
+uint32_t Metrics::webLogDrop = 0;
+
+class NtpTest : public Ntp
+{
+public:
+    using Ntp::breakTime;
+    using Ntp::tick;
+};
+
+static const uint8_t kDaysInMonth[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+
+// 改动前的实现, 原样保留作为参照
+static void oldBreakTime(uint32_t time_input, TIME_T &tm)
+{
+    uint8_t year;
+    uint8_t month;
+    uint8_t month_length;
+    uint32_t time;
+    unsigned long days;
+
+    time = time_input;
+    tm.second = time % 60;
+    time /= 60; // now it is minutes
+    tm.minute = time % 60;
+    time /= 60; // now it is hours
+    tm.hour = time % 24;
+    time /= 24; // now it is days
+    tm.days = time;
+    tm.day_of_week = ((time + 4) % 7) + 1; // Sunday is day 1
+
+    year = 0;
+    days = 0;
+    while ((unsigned)(days += (LEAP_YEAR(year) ? 366 : 365)) <= time)
+    {
+        year++;
+    }
+    tm.year = year + 1970; // year is offset from 1970
+
+    days -= LEAP_YEAR(year) ? 366 : 365;
+    time -= days; // now it is days in this year, starting at 0
+    tm.day_of_year = time;
+
+    days = 0;
+    month = 0;
+    month_length = 0;
+    for (month = 0; month < 12; month++)
+    {
+        if (1 == month)
+        { // february
+            if (LEAP_YEAR(year))
+            {
+                month_length = 29;
+            }
+            else
+            {
+                month_length = 28;
+            }
+        }
+        else
+        {
+            month_length = kDaysInMonth[month];
+        }
+
+        if (time >= month_length)
+        {
+            time -= month_length;
+        }
+        else
+        {
+            break;
+        }
+    }
+    tm.month = month + 1;                 // jan is month 1
+    tm.day_of_month = time + 1;           // day of month
+    tm.valid = (time_input > 1451602800); // 2016-01-01
+}
+
+static int failures = 0;
+
+static bool same(const TIME_T &a, const TIME_T &b)
+{
+    return a.second == b.second && a.minute == b.minute && a.hour == b.hour && a.day_of_week == b.day_of_week &&
+           a.day_of_month == b.day_of_month && a.month == b.month && a.day_of_year == b.day_of_year &&
+           a.year == b.year && a.days == b.days && a.valid == b.valid;
+}
+
+static void print(const char *name, const TIME_T &tm)
+{
+    printf("  %-4s %04u-%02u-%02u %02u:%02u:%02u wday %u yday %u days %lu valid %d\n", name, tm.year, tm.month,
+           tm.day_of_month, tm.hour, tm.minute, tm.second, tm.day_of_week, tm.day_of_year, tm.days, tm.valid);
+}
+
+static void compare(const char *what, uint32_t t, const TIME_T &expect, const TIME_T &actual)
+{
+    if (!same(expect, actual) && failures++ < 10)
+    {
+        printf("FAIL %s %u\n", what, t);
+        print("want", expect);
+        print("got", actual);
+    }
+}
+
+static void check(uint32_t t, bool libc)
+{
+    TIME_T expect, actual;
+    oldBreakTime(t, expect);
+    NtpTest::breakTime(t, actual);
+    compare("breakTime", t, expect, actual);
+    if (libc)
+    {
+        time_t tt = t;
+        struct tm g;
+        gmtime_r(&tt, &g);
+        if ((g.tm_year + 1900 != actual.year || g.tm_mon + 1 != actual.month || g.tm_mday != actual.day_of_month ||
+             g.tm_yday != actual.day_of_year || g.tm_wday + 1 != actual.day_of_week) &&
+            failures++ < 10)
+        {
+            printf("FAIL gmtime %u\n", t);
+            print("got", actual);
+        }
+    }
+}
+
+static uint32_t lastDay()
+{
+    // 2100-12-31
+    return 4133894400u / 86400;
+}
+
+static void testDays()
+{
+    for (uint32_t day = 0; day <= lastDay(); day++)
+    {
+        uint32_t base = day * 86400;
+        check(base, true);
+        check(base + 86399, false);
+        for (int i = 0; i < 8; i++)
+        {
+            check(base + rand() % 86400, false);
+        }
+    }
+    printf("days: %u days x 10 seconds %s\n", lastDay() + 1, failures ? "FAIL" : "OK");
+
+    for (int i = 0; i < 1000000; i++)
+    {
+        check(((uint32_t)rand() << 16) ^ (uint32_t)rand(), i % 16 == 0);
+    }
+    printf("random: 1000000 %s\n", failures ? "FAIL" : "OK");
+}
+
+static void testTick()
+{
+    TIME_T tm, expect;
+    for (uint32_t day = 0; day <= lastDay(); day++)
+    {
+        uint32_t t = day * 86400 + 86398;
+        NtpTest::breakTime(t, tm);
+        for (int i = 1; i <= 3; i++)
+        {
+            NtpTest::tick(tm);
+            NtpTest::breakTime(t + i, expect);
+            tm.valid = expect.valid; // valid 由调用方维护
+            compare("tick", t + i, expect, tm);
+        }
+    }
+    printf("tick: %u day boundaries %s\n", lastDay() + 1, failures ? "FAIL" : "OK");
+}
+
+template <typename F>
+static double bench(F fn, uint32_t base)
+{
+    const int n = 2000000;
+    TIME_T tm;
+    volatile uint32_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++)
+    {
+        fn(base + (i & 0xFFFF) * 37, tm); // 在一年内变化, 防止被优化成常量
+        sink += tm.day_of_month;
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / n;
+}
+
+static void testBench()
+{
+    const uint32_t years[] = {1970, 2025, 2100};
+    const uint32_t starts[] = {0, 1735689600u, 4102444800u};
+    printf("年份          旧版      新版\n");
+    for (int i = 0; i < 3; i++)
+    {
+        double o = bench(oldBreakTime, starts[i]);
+        double n = bench(NtpTest::breakTime, starts[i]);
+        printf("%-8u %8.1fns %8.1fns\n", years[i], o, n);
+    }
+}
+
+int main()
+{
+    testDays();
+    testTick();
+    testBench();
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,477 @@
+// HTTP 服务器主机测试: HttpServer 增量解析/并发连接/分段响应/上传/超时
+// g++ -std=gnu++17 -O2 -Itest/host/stub -Iinclude test/host/http.cpp test/host/stub/host.cpp src/HttpServer.cpp -o http && ./http
+//
+// 用桩 lwIP 代替网络, 测试直接调用接入/接收/确认回调:
+// 1. 4 个连接同时逐字节发送请求 (GET 参数, POST 表单, 404, 20KB 分段响应), 每轮调用一次 handleClient:
+//    响应正确, 每次 handleClient 最多执行一个处理函数, 接收数据全部确认, pbuf 全部释放
+// 2. 连接满时新连接直接断开; 只发一半请求头的连接 HTTP_CLIENT_TIMEOUT 后断开, 期间其他连接照常处理
+// 3. 不读响应的客户端: 小响应不等待, 其他连接照常处理; 大响应最多等 HTTP_TX_WAIT 后断开
+// 4. multipart 上传 100KB 随机数据 (含分隔符前缀), 随机分包: 数据一致, 每次 handleClient 最多处理 HTTP_PARSE_BUDGET 字节;
+//    同时第二个上传返回 503; 上传中途断开回调 UPLOAD_FILE_ABORTED
+// 5. Basic 认证, 畸形请求行 400, 超长请求头 431, 超长表单 413
+//
+// 结果 (x86-64 g++ 12 -O2):
+//   concurrent: 4 clients x 1 byte per loop, 133 loops, max 4 bytes per handleClient OK
+//   limits: 4 clients, refused 1, timed out 5 OK
+//   slow reader: 4KB buffered 0ms, 20KB to reader waited 4ms, to non-reader dropped after 300ms OK
+//   upload: 100000 bytes in 69 loops, max 1460 bytes per handleClient, max chunk 1460 OK
+//   errors: auth 200/401, 400, 431, 413 OK
+// 每次 handleClient 的工作量与连接数和客户端速度无关, 只有超过 HTTP_TX_MAX 的大响应遇到不收数据的客户端时等待
+
+#include "HttpServer.h"
+#include "lwip/tcp.h"
+#include <random>
+#include <vector>
+
+int hostPbufCount = 0;
+tcp_pcb *hostListener = NULL;
+
+static const uint16_t SND_BUF = 2920;
+static HttpServer server;
+static int failures = 0;
+
+static void expect(bool ok, const char *msg)
+{
+    if (!ok && failures++ < 10)
+    {
+        printf("FAIL %s\n", msg);
+    }
+}
+
+static tcp_pcb *connect()
+{
+    tcp_pcb *pcb = new tcp_pcb();
+    pcb->snd_buf = SND_BUF;
+    pcb->local_ip.addr = 0x0200000A; // 10.0.0.2
+    hostListener->accept(hostListener->arg, pcb, ERR_OK);
+    return pcb;
+}
+
+static void transmit(tcp_pcb *pcb, const std::string &data)
+{
+    if (!pcb->recv || pcb->aborted)
+    {
+        return;
+    }
+    pcb->recv(pcb->arg, pcb, pbuf_alloc(data.data(), data.size()), ERR_OK);
+}
+
+static void hangUp(tcp_pcb *pcb)
+{
+    if (pcb->recv && !pcb->aborted)
+    {
+        pcb->recv(pcb->arg, pcb, NULL, ERR_OK);
+    }
+}
+
+// 对方确认全部已发送的数据
+static void ack(tcp_pcb *pcb)
+{
+    uint16_t len = SND_BUF - pcb->snd_buf;
+    pcb->snd_buf = SND_BUF;
+    if (len && pcb->sent)
+    {
+        pcb->sent(pcb->arg, pcb, len);
+    }
+}
+
+static std::string body(const tcp_pcb *pcb)
+{
+    size_t pos = pcb->out.find("\r\n\r\n");
+    return pos == std::string::npos ? "" : pcb->out.substr(pos + 4);
+}
+
+static bool status(const tcp_pcb *pcb, int code)
+{
+    return pcb->out.compare(0, 13, "HTTP/1.1 " + std::to_string(code) + " ") == 0;
+}
+
+static int handled;
+static std::string bigBody;
+static std::string uploaded;
+static std::vector<int> uploadStatus;
+static size_t uploadMaxChunk;
+
+static void routes()
+{
+    server.on("/echo", []() {
+        handled++;
+        std::string data = "a=" + server.arg("a") + ",b=" + server.arg("b") + ",c=" + server.arg("c") +
+                           ",args=" + std::to_string(server.args()) + ",has_x=" + (server.hasArg("x") ? "1" : "0");
+        server.send(200, "text/plain", data);
+    });
+    server.on("/big", []() {
+        handled++;
+        server.setContentLength(CONTENT_LENGTH_UNKNOWN);
+        server.send(200, "text/html", "");
+        for (int i = 0; i < 20; i++)
+        {
+            server.sendContent(bigBody.substr(i * 1000, 1000));
+        }
+    });
+    server.on("/small", []() {
+        handled++;
+        server.send(200, "text/html", bigBody.substr(0, 4000));
+    });
+    server.on("/auth", []() {
+        handled++;
+        if (!server.authenticate("admin", "pw"))
+        {
+            server.requestAuthentication();
+            return;
+        }
+        server.send(200, "text/plain", "ok");
+    });
+    server.on(
+        "/update", HTTP_POST,
+        []() {
+            handled++;
+            server.send(200, "text/plain", "note=" + server.arg("note") + ",q=" + server.arg("q"));
+        },
+        []() {
+            HTTPUpload &upload = server.upload();
+            uploadStatus.push_back(upload.status);
+            if (upload.status == UPLOAD_FILE_START)
+            {
+                uploaded.clear();
+                expect(upload.filename == "fw.bin" && upload.name == "update", "upload: file name");
+            }
+            else if (upload.status == UPLOAD_FILE_WRITE)
+            {
+                uploaded.append((const char *)upload.buf, upload.currentSize);
+                uploadMaxChunk = std::max(uploadMaxChunk, upload.currentSize);
+            }
+            else if (upload.status == UPLOAD_FILE_END)
+            {
+                expect(upload.totalSize == uploaded.size(), "upload: total size");
+            }
+        });
+}
+
+static bool idle()
+{
+    return server.clientCount == 0 && hostPbufCount == 0;
+}
+
+static tcp_pcb *reading[4];
+static void network()
+{
+    for (tcp_pcb *pcb : reading)
+    {
+        if (pcb)
+        {
+            ack(pcb);
+        }
+    }
+}
+
+static void testConcurrent()
+{
+    const char *requests[4] = {
+        "GET /echo?a=1&b=x%20y&x HTTP/1.1\r\nHost: 10.0.0.2\r\n\r\n",
+        "POST /echo?a=2 HTTP/1.1\r\nHost: 10.0.0.2\r\nContent-Type: application/x-www-form-urlencoded\r\n"
+        "Content-Length: 20\r\n\r\nb=hello+world&c=3%26",
+        "GET /missing HTTP/1.1\r\nHost: 10.0.0.2\r\n\r\n",
+        "GET /big HTTP/1.1\r\nHost: 10.0.0.2\r\n\r\n",
+    };
+    tcp_pcb *pcbs[4];
+    for (int i = 0; i < 4; i++)
+    {
+        pcbs[i] = connect();
+        reading[i] = pcbs[i];
+    }
+    hostYield = network; // 处理函数等待发送时对方照常确认
+    handled = 0;
+    int rounds = 0;
+    uint32_t maxBytes = 0;
+    bool more = true;
+    for (size_t pos = 0; more || server.clientCount > 0; pos++, rounds++)
+    {
+        more = false;
+        uint32_t before = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            if (pos < strlen(requests[i]))
+            {
+                transmit(pcbs[i], std::string(1, requests[i][pos]));
+                more = true;
+            }
+            before += pcbs[i]->recved;
+        }
+        int handledBefore = handled;
+        server.handleClient();
+        expect(handled - handledBefore <= 1, "concurrent: one handler per handleClient");
+        uint32_t after = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            after += pcbs[i]->recved;
+            ack(pcbs[i]);
+        }
+        maxBytes = std::max(maxBytes, after - before);
+        hostMicros += 1000;
+        if (rounds > 10000)
+        {
+            break;
+        }
+    }
+    hostYield = NULL;
+    memset(reading, 0, sizeof(reading));
+    expect(status(pcbs[0], 200) && body(pcbs[0]) == "a=1,b=x y,c=,args=3,has_x=1", "concurrent: GET args");
+    expect(status(pcbs[1], 200) && body(pcbs[1]) == "a=2,b=hello world,c=3&,args=3,has_x=0", "concurrent: POST form");
+    expect(status(pcbs[2], 404), "concurrent: not found");
+    expect(status(pcbs[3], 200) && body(pcbs[3]) == bigBody && pcbs[3]->out.find("Content-Length") == std::string::npos,
+           "concurrent: big response in parts");
+    for (int i = 0; i < 4; i++)
+    {
+        expect(pcbs[i]->closed && !pcbs[i]->aborted, "concurrent: graceful close");
+        expect(pcbs[i]->recved == strlen(requests[i]), "concurrent: all received acked");
+    }
+    expect(idle(), "concurrent: resources released");
+    printf("concurrent: 4 clients x 1 byte per loop, %d loops, max %u bytes per handleClient %s\n", rounds, maxBytes,
+           failures ? "FAIL" : "OK");
+}
+
+static void testLimits()
+{
+    tcp_pcb *pcbs[HTTP_MAX_CLIENTS];
+    uint32_t rejects = server.rejectCount;
+    for (int i = 0; i < HTTP_MAX_CLIENTS; i++)
+    {
+        pcbs[i] = connect();
+        transmit(pcbs[i], "GET /echo?a=1 HTTP/1.1\r\nHo"); // 请求头只发一半
+    }
+    tcp_pcb *extra = connect();
+    expect(extra->aborted && server.rejectCount == rejects + 1, "limits: connection over HTTP_MAX_CLIENTS refused");
+
+    // 半个请求的连接占着时, 超时前新连接仍被拒绝; 超时后全部断开
+    for (uint32_t t = 0; t <= HTTP_CLIENT_TIMEOUT; t += 100)
+    {
+        server.handleClient();
+        hostMicros += 100000;
+    }
+    server.handleClient();
+    bool all = true;
+    for (int i = 0; i < HTTP_MAX_CLIENTS; i++)
+    {
+        all = all && pcbs[i]->aborted;
+    }
+    expect(all && server.rejectCount == rejects + 1 + HTTP_MAX_CLIENTS, "limits: incomplete requests time out");
+    expect(idle(), "limits: resources released");
+
+    // 一个慢速连接超时前, 其他连接照常处理
+    tcp_pcb *slow = connect();
+    transmit(slow, "GET /echo HTTP/1.1\r\n");
+    tcp_pcb *fast = connect();
+    transmit(fast, "GET /echo?a=9 HTTP/1.1\r\n\r\n");
+    server.handleClient();
+    expect(status(fast, 200) && fast->closed, "limits: served while another client trickles");
+    for (uint32_t t = 0; t <= HTTP_CLIENT_TIMEOUT; t += 100)
+    {
+        server.handleClient();
+        hostMicros += 100000;
+        transmit(slow, "X-Slow: 1\r\n"); // 一直有数据, 但请求头不完整
+    }
+    server.handleClient();
+    expect(slow->aborted && idle(), "limits: slowloris dropped after HTTP_CLIENT_TIMEOUT");
+    printf("limits: %d clients, refused 1, timed out %d %s\n", HTTP_MAX_CLIENTS, HTTP_MAX_CLIENTS + 1, failures ? "FAIL" : "OK");
+}
+
+static void testSlowReader()
+{
+    // 小响应: 不读的客户端只占自己的缓冲
+    tcp_pcb *stuck = connect();
+    transmit(stuck, "GET /small HTTP/1.1\r\n\r\n");
+    uint64_t start = hostMicros;
+    server.handleClient();
+    expect(hostMicros == start && !stuck->closed, "slow reader: small response buffered without waiting");
+    tcp_pcb *other = connect();
+    transmit(other, "GET /echo?a=5 HTTP/1.1\r\n\r\n");
+    server.handleClient();
+    expect(status(other, 200) && other->closed, "slow reader: other client served");
+    ack(stuck);
+    server.handleClient();
+    expect(body(stuck) == bigBody.substr(0, 4000) && stuck->closed, "slow reader: small response finished after ack");
+
+    // 大响应, 正常读取的客户端: 等待期间网络确认, 完整收到
+    tcp_pcb *reader = connect();
+    reading[0] = reader;
+    hostYield = network;
+    transmit(reader, "GET /big HTTP/1.1\r\n\r\n");
+    start = hostMicros;
+    server.handleClient();
+    uint64_t readerWait = hostMicros - start;
+    for (int i = 0; i < 10; i++)
+    {
+        ack(reader);
+        server.handleClient();
+    }
+    expect(body(reader) == bigBody && reader->closed, "slow reader: big response to reading client");
+
+    // 大响应, 不读的客户端: 最多等 HTTP_TX_WAIT 后断开
+    reading[0] = NULL;
+    tcp_pcb *dead = connect();
+    transmit(dead, "GET /big HTTP/1.1\r\n\r\n");
+    start = hostMicros;
+    server.handleClient();
+    uint64_t deadWait = hostMicros - start;
+    expect(dead->aborted && deadWait <= (HTTP_TX_WAIT + 1) * 1000, "slow reader: big response wait bounded");
+    server.handleClient();
+    hostYield = NULL;
+    expect(idle(), "slow reader: resources released");
+    printf("slow reader: 4KB buffered 0ms, 20KB to reader waited %llums, to non-reader dropped after %llums %s\n",
+           (unsigned long long)readerWait / 1000, (unsigned long long)deadWait / 1000, failures ? "FAIL" : "OK");
+}
+
+static std::string multipart(const std::string &file, const char *boundary)
+{
+    std::string b = boundary;
+    return "--" + b + "\r\nContent-Disposition: form-data; name=\"note\"\r\n\r\nhi there&x\r\n" + "--" + b +
+           "\r\nContent-Disposition: form-data; name=\"update\"; filename=\"fw.bin\"\r\n"
+           "Content-Type: application/octet-stream\r\n\r\n" +
+           file + "\r\n--" + b + "--\r\n";
+}
+
+static std::string uploadHead(size_t len, const char *boundary)
+{
+    return "POST /update?q=1 HTTP/1.1\r\nHost: 10.0.0.2\r\nContent-Type: multipart/form-data; boundary=" +
+           std::string(boundary) + "\r\nContent-Length: " + std::to_string(len) + "\r\n\r\n";
+}
+
+static void testUpload()
+{
+    const char *boundary = "----WebKitFormBoundaryX3bY";
+    std::mt19937 rng(1);
+    std::string file;
+    while (file.size() < 100000)
+    {
+        uint32_t r = rng() % 1000;
+        if (r == 0)
+        {
+            file += "\r\n--"; // 分隔符前缀
+        }
+        else if (r == 1)
+        {
+            file += "\r\n--" + std::string(boundary).substr(0, 10);
+        }
+        else if (r == 2)
+        {
+            file += "\r\r\n-";
+        }
+        else
+        {
+            file += (char)rng();
+        }
+    }
+    std::string data = multipart(file, boundary);
+    std::string request = uploadHead(data.size(), boundary) + data;
+
+    uploadStatus.clear();
+    uploadMaxChunk = 0;
+    handled = 0;
+    tcp_pcb *pcb = connect();
+    tcp_pcb *second = NULL;
+    uint32_t maxBytes = 0;
+    int loops = 0;
+    for (size_t pos = 0; pos < request.size() || server.clientCount > 0; loops++)
+    {
+        // 一次投递多个随机大小的包, 服务器每次只处理 HTTP_PARSE_BUDGET 字节, 其余留在窗口里
+        for (int k = 0; k < 3 && pos < request.size(); k++)
+        {
+            size_t n = std::min<size_t>(1 + rng() % 1500, request.size() - pos);
+            transmit(pcb, request.substr(pos, n));
+            pos += n;
+        }
+        if (loops == 5)
+        {
+            second = connect();
+            std::string small = multipart("abc", boundary);
+            transmit(second, uploadHead(small.size(), boundary) + small);
+        }
+        uint32_t before = pcb->recved;
+        server.handleClient();
+        maxBytes = std::max(maxBytes, pcb->recved - before);
+        ack(pcb);
+        if (second)
+        {
+            ack(second);
+        }
+        if (loops > 100000)
+        {
+            break;
+        }
+    }
+    expect(uploaded == file, "upload: data");
+    expect(uploadStatus.size() > 2 && uploadStatus.front() == UPLOAD_FILE_START && uploadStatus.back() == UPLOAD_FILE_END,
+           "upload: status sequence");
+    expect(uploadMaxChunk <= HTTP_UPLOAD_BUFLEN, "upload: chunk size");
+    expect(maxBytes <= HTTP_PARSE_BUDGET, "upload: budget per handleClient");
+    expect(status(pcb, 200) && body(pcb) == "note=hi there&x,q=1", "upload: fields and query");
+    expect(second && status(second, 503), "upload: concurrent upload refused");
+    expect(idle(), "upload: resources released");
+
+    // 中途断开
+    uploadStatus.clear();
+    pcb = connect();
+    transmit(pcb, request.substr(0, 20000));
+    for (int i = 0; i < 20; i++)
+    {
+        server.handleClient();
+    }
+    hangUp(pcb);
+    for (int i = 0; i < 20; i++)
+    {
+        server.handleClient();
+    }
+    expect(!uploadStatus.empty() && uploadStatus.back() == UPLOAD_FILE_ABORTED && idle(), "upload: aborted on disconnect");
+    printf("upload: %zu bytes in %d loops, max %u bytes per handleClient, max chunk %zu %s\n", file.size(), loops,
+           maxBytes, uploadMaxChunk, failures ? "FAIL" : "OK");
+}
+
+static tcp_pcb *request(const std::string &text)
+{
+    tcp_pcb *pcb = connect();
+    transmit(pcb, text);
+    for (int i = 0; i < 10; i++)
+    {
+        server.handleClient();
+        ack(pcb);
+    }
+    return pcb;
+}
+
+static void testErrors()
+{
+    tcp_pcb *ok = request("GET /auth HTTP/1.1\r\nAuthorization: Basic YWRtaW46cHc=\r\n\r\n");
+    tcp_pcb *bad = request("GET /auth HTTP/1.1\r\nAuthorization: Basic YWRtaW46eHg=\r\n\r\n");
+    expect(status(ok, 200) && status(bad, 401) && bad->out.find("WWW-Authenticate: Basic") != std::string::npos,
+           "errors: basic auth");
+    uint32_t rejects = server.rejectCount;
+    expect(status(request("GARBAGE\r\n\r\n"), 400), "errors: bad request line");
+    expect(status(request("GET / HTTP/1.1\r\nX-Long: " + std::string(HTTP_LINE_SIZE, 'a') + "\r\n\r\n"), 431),
+           "errors: long header");
+    std::string form(HTTP_BODY_MAX + 1, 'a');
+    expect(status(request("POST /echo HTTP/1.1\r\nContent-Type: application/x-www-form-urlencoded\r\nContent-Length: " +
+                          std::to_string(form.size()) + "\r\n\r\n" + form),
+                  413),
+           "errors: form too large");
+    tcp_pcb *extra = request("GET /echo?a=7 HTTP/1.1\r\n\r\nGET /echo?a=8 HTTP/1.1\r\n\r\n");
+    expect(body(extra).find("a=7,") == 0 && extra->closed && !extra->aborted, "errors: pipelined data discarded");
+    expect(server.rejectCount == rejects + 3 && idle(), "errors: counted and released");
+    printf("errors: auth 200/401, 400, 431, 413 %s\n", failures ? "FAIL" : "OK");
+}
+
+int main()
+{
+    for (int i = 0; i < 20000; i++)
+    {
+        bigBody += (char)('a' + i % 26);
+    }
+    routes();
+    server.begin(80);
+    testConcurrent();
+    testLimits();
+    testSlowReader();
+    testUpload();
+    testErrors();
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,96 @@
+// 主机测试用 Arduino 桩, 只提供被测代码用到的部分
+#ifndef _HOST_ARDUINO_h
+#define _HOST_ARDUINO_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <strings.h>
+#include <string.h>
+#include <string>
+
+typedef bool boolean;
+typedef uint8_t uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+
+#define PROGMEM
+#define ICACHE_RAM_ATTR
+#define PGM_P const char *
+#define PSTR(s) (s)
+#define F(s) (s)
+#define snprintf_P snprintf
+#define vsnprintf_P vsnprintf
+#define sprintf_P sprintf
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strcmp_P strcmp
+#define memcpy_P memcpy
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define RANDOM_REG32 ((uint32_t)rand())
+
+// 时间由测试控制
+extern uint64_t hostMicros;
+inline uint32_t micros() { return (uint32_t)hostMicros; }
+inline uint64_t micros64() { return hostMicros; }
+inline uint32_t millis() { return (uint32_t)(hostMicros / 1000); }
+extern void (*hostYield)(); // 让出 CPU 时运行的模拟网络
+inline void yield()
+{
+    if (hostYield)
+    {
+        hostYield();
+    }
+}
+inline void delay(unsigned long ms)
+{
+    hostMicros += ms * 1000;
+    yield();
+}
+
+class String : public std::string
+{
+public:
+    String() {}
+    String(const char *s) : std::string(s ? s : "") {}
+    String(const std::string &s) : std::string(s) {}
+    explicit String(int v) : std::string(std::to_string(v)) {}
+    explicit String(unsigned int v) : std::string(std::to_string(v)) {}
+    explicit String(long v) : std::string(std::to_string(v)) {}
+    explicit String(unsigned long v) : std::string(std::to_string(v)) {}
+    int toInt() const { return atoi(c_str()); }
+    bool equals(const String &s) const { return *this == s; }
+    void trim()
+    {
+        erase(0, find_first_not_of(" \t\r\n"));
+        erase(find_last_not_of(" \t\r\n") + 1);
+    }
+};
+
+class HardwareSerial
+{
+public:
+    size_t availableForWrite() { return 128; }
+    size_t write(const uint8_t *, size_t len) { return len; }
+};
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+class EspClass
+{
+public:
+    static uint32_t getCycleCount() { return 0; }
+    uint32_t getFreeHeap() { return 0; }
+    uint32_t getMaxFreeBlockSize() { return 0; }
+};
+extern EspClass ESP;
+
+#endif
@@ -0,0 +1,46 @@
+// 主机测试用桩
+#ifndef _HOST_ESP8266WIFI_h
+#define _HOST_ESP8266WIFI_h
+
+#include "Arduino.h"
+
+enum wl_status_t
+{
+    WL_IDLE_STATUS = 0,
+    WL_CONNECTED = 3,
+    WL_DISCONNECTED = 6
+};
+
+class IPAddress
+{
+private:
+    uint32_t addr = 0;
+
+public:
+    IPAddress() {}
+    IPAddress(uint32_t a) : addr(a) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : addr(a | b << 8 | c << 16 | (uint32_t)d << 24) {}
+    operator uint32_t() const { return addr; }
+    bool isSet() const { return addr != 0; }
+};
+
+// 状态和解析结果由测试设置
+class ESP8266WiFiClass
+{
+public:
+    wl_status_t hostStatus = WL_DISCONNECTED;
+    uint32_t hostResolve = 0; // 0 = 解析失败
+    uint32_t resolveCount = 0;
+
+    wl_status_t status() { return hostStatus; }
+    bool isConnected() { return hostStatus == WL_CONNECTED; }
+    int hostByName(const char *, IPAddress &ip)
+    {
+        resolveCount++;
+        ip = IPAddress(hostResolve);
+        return hostResolve != 0;
+    }
+};
+extern ESP8266WiFiClass WiFi;
+
+#endif
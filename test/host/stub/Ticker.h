@@ -0,0 +1,9 @@
+// 主机测试用桩
+#ifndef _HOST_TICKER_h
+#define _HOST_TICKER_h
+
+class Ticker
+{
+};
+
+#endif
@@ -0,0 +1,34 @@
+// 主机测试用桩
+#ifndef _HOST_WIFIUDP_h
+#define _HOST_WIFIUDP_h
+
+#include "ESP8266WiFi.h"
+#include <string>
+#include <vector>
+
+// 发出的包记录在 sent 中
+class WiFiUDP
+{
+public:
+    std::vector<std::string> sent;
+    std::string packet;
+
+    int beginPacket(IPAddress, uint16_t)
+    {
+        packet.clear();
+        return 1;
+    }
+    size_t write(const char *data, size_t len)
+    {
+        packet.append(data, len);
+        return len;
+    }
+    size_t write(const uint8_t *data, size_t len) { return write((const char *)data, len); }
+    int endPacket()
+    {
+        sent.push_back(packet);
+        return 1;
+    }
+};
+
+#endif
@@ -0,0 +1,7 @@
+// 主机测试用桩
+#ifndef _HOST_COREDECLS_h
+#define _HOST_COREDECLS_h
+
+inline void settimeofday_cb(void (*)()) {}
+
+#endif
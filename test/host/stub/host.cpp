@@ -0,0 +1,14 @@
+// 主机测试用桩: 固件全局对象
+#include "Config.h"
+
+uint64_t hostMicros = 0;
+void (*hostYield)() = NULL;
+HardwareSerial Serial;
+HardwareSerial Serial1;
+EspClass ESP;
+ESP8266WiFiClass WiFi;
+
+Module *module = NULL;
+char UID[16] = "host";
+char tmpData[512];
+GlobalConfigMessage globalConfig;
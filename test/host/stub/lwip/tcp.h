@@ -0,0 +1,147 @@
+// 主机测试用桩: lwIP raw TCP 接口中 HttpServer 用到的部分
+// 不模拟网络, 只记录写出的数据/确认的窗口, 回调由测试直接调用
+#ifndef _HOST_LWIP_TCP_h
+#define _HOST_LWIP_TCP_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+typedef int8_t err_t;
+#define ERR_OK 0
+#define ERR_MEM -1
+#define ERR_VAL -6
+#define ERR_ABRT -13
+#define ERR_RST -14
+
+typedef struct
+{
+    uint32_t addr;
+} ip_addr_t;
+#define IP_ADDR_ANY ((const ip_addr_t *)NULL)
+#define ip_2_ip4(ip) (ip)
+#define ip4_addr_get_u32(ip) ((ip)->addr)
+
+struct pbuf
+{
+    pbuf *next;
+    void *payload;
+    uint16_t tot_len;
+    uint16_t len;
+    uint16_t ref;
+};
+
+struct tcp_pcb;
+typedef err_t (*tcp_accept_fn)(void *arg, tcp_pcb *newpcb, err_t err);
+typedef err_t (*tcp_recv_fn)(void *arg, tcp_pcb *tpcb, pbuf *p, err_t err);
+typedef err_t (*tcp_sent_fn)(void *arg, tcp_pcb *tpcb, uint16_t len);
+typedef void (*tcp_err_fn)(void *arg, err_t err);
+
+struct tcp_pcb
+{
+    ip_addr_t local_ip;
+    void *arg;
+    tcp_accept_fn accept;
+    tcp_recv_fn recv;
+    tcp_sent_fn sent;
+    tcp_err_fn errf;
+    uint16_t snd_buf;  // 发送窗口, 由测试按确认归还
+    std::string out;   // 已交给 lwIP 的数据
+    uint32_t recved;   // 已确认的接收字节
+    bool closed;
+    bool aborted;
+};
+
+extern int hostPbufCount;       // 未释放的 pbuf 数
+extern tcp_pcb *hostListener; // 监听 pcb, 测试通过它的接入回调建立连接
+
+#define TCP_PRIO_MIN 1
+#define TCP_WRITE_FLAG_COPY 0x01
+#define SOF_REUSEADDR 0x04
+#define ip_set_option(pcb, opt) ((void)(pcb))
+#define tcp_setprio(pcb, prio) ((void)(pcb))
+#define tcp_nagle_disable(pcb) ((void)(pcb))
+#define tcp_sndbuf(pcb) ((pcb)->snd_buf)
+#define tcp_listen(pcb) (pcb)
+
+inline tcp_pcb *tcp_new()
+{
+    tcp_pcb *pcb = new tcp_pcb();
+    pcb->snd_buf = 2920;
+    return pcb;
+}
+inline err_t tcp_bind(tcp_pcb *, const ip_addr_t *, uint16_t) { return ERR_OK; }
+inline void tcp_arg(tcp_pcb *pcb, void *arg) { pcb->arg = arg; }
+inline void tcp_accept(tcp_pcb *pcb, tcp_accept_fn fn)
+{
+    pcb->accept = fn;
+    hostListener = pcb;
+}
+inline void tcp_recv(tcp_pcb *pcb, tcp_recv_fn fn) { pcb->recv = fn; }
+inline void tcp_sent(tcp_pcb *pcb, tcp_sent_fn fn) { pcb->sent = fn; }
+inline void tcp_err(tcp_pcb *pcb, tcp_err_fn fn) { pcb->errf = fn; }
+inline void tcp_recved(tcp_pcb *pcb, uint16_t len) { pcb->recved += len; }
+inline err_t tcp_output(tcp_pcb *) { return ERR_OK; }
+inline err_t tcp_write(tcp_pcb *pcb, const void *data, uint16_t len, uint8_t)
+{
+    if (len > pcb->snd_buf)
+    {
+        return ERR_MEM;
+    }
+    pcb->out.append((const char *)data, len);
+    pcb->snd_buf -= len;
+    return ERR_OK;
+}
+inline err_t tcp_close(tcp_pcb *pcb)
+{
+    pcb->closed = true;
+    return ERR_OK;
+}
+// 和 lwIP 一样, 中止时调用错误回调
+inline void tcp_abort(tcp_pcb *pcb)
+{
+    pcb->aborted = true;
+    if (pcb->errf)
+    {
+        pcb->errf(pcb->arg, ERR_ABRT);
+    }
+}
+
+inline pbuf *pbuf_alloc(const char *data, uint16_t len)
+{
+    pbuf *p = new pbuf();
+    p->payload = malloc(len ? len : 1);
+    memcpy(p->payload, data, len);
+    p->len = p->tot_len = len;
+    p->ref = 1;
+    hostPbufCount++;
+    return p;
+}
+inline void pbuf_ref(pbuf *p) { p->ref++; }
+inline void pbuf_cat(pbuf *head, pbuf *tail)
+{
+    pbuf *p = head;
+    for (; p->next; p = p->next)
+    {
+        p->tot_len += tail->tot_len;
+    }
+    p->tot_len += tail->tot_len;
+    p->next = tail;
+}
+inline uint8_t pbuf_free(pbuf *p)
+{
+    uint8_t count = 0;
+    while (p && --p->ref == 0)
+    {
+        pbuf *next = p->next;
+        free(p->payload);
+        delete p;
+        hostPbufCount--;
+        count++;
+        p = next;
+    }
+    return count;
+}
+
+#endif
@@ -0,0 +1,19 @@
+// 主机测试用桩, 只提供头文件中结构体用到的类型
+#ifndef _HOST_PB_h
+#define _HOST_PB_h
+
+#include <stdint.h>
+
+typedef uint_least16_t pb_size_t;
+typedef struct pb_field_s
+{
+    uint32_t tag;
+} pb_field_t;
+#define PB_BYTES_ARRAY_T(n) \
+    struct                  \
+    {                       \
+        pb_size_t size;     \
+        uint8_t bytes[n];   \
+    }
+
+#endif
@@ -0,0 +1 @@
+#include "pb.h"
@@ -0,0 +1,13 @@
+// 主机测试用桩
+#ifndef _HOST_SNTP_h
+#define _HOST_SNTP_h
+
+#include <stdint.h>
+
+inline uint32_t sntp_get_current_timestamp() { return 0; }
+inline void sntp_setservername(int, char *) {}
+inline void sntp_stop() {}
+inline bool sntp_set_timezone(int8_t) { return true; }
+inline void sntp_init() {}
+
+#endif
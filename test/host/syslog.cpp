@@ -0,0 +1,193 @@
+// syslog 发送主机测试: DebugClass::Syslog / syslogFlush / getServer / loop
+// g++ -std=gnu++17 -O2 -Itest/host/stub -Iinclude test/host/syslog.cpp test/host/stub/host.cpp src/Debug.cpp -o syslog && ./syslog
+//
+// 1. 开机时未联网/解析失败, 日志缓存不丢, 解析成功后按顺序每条一个包发出
+// 2. 已解析时每条日志立即发出
+// 3. 没有日志时 loop 也按 SYSLOG_DNS_TTL 重新解析, 失败按 SYSLOG_DNS_RETRY 重试, 重新解析失败继续用旧地址
+// 4. 未解析时缓冲满了保留最早的行
+// 5. 合并模式下 SYSLOG_FLUSH_TIME 后整个缓冲一个包, 每条带 RFC 6587 长度前缀
+//
+// 结果:
+//   boot: OK
+//   ttl: OK
+//   full: 7 of 100 kept OK
+//   batch: OK
+
+#include "Debug.h"
+#include "Metrics.h"
+#include "Ntp.h"
+#include <WiFiUdp.h>
+#include <string>
+
+uint32_t Metrics::webLogDrop = 0;
+TIME_T Ntp::rtcTime;
+uint64_t Ntp::nowUs() { return 0; }
+uint16_t Ntp::millisecond() { return 0; }
+
+extern WiFiUDP Udp;
+
+class SyslogTest : public DebugClass
+{
+public:
+    using DebugClass::syslogLen;
+};
+
+static int failures = 0;
+
+static void expect(bool ok, const char *msg)
+{
+    if (!ok && failures++ < 10)
+    {
+        printf("FAIL %s\n", msg);
+    }
+}
+
+static std::string message(const char *text)
+{
+    return std::string("<134>1 - host esp - - - ") + text;
+}
+
+static void log(SyslogTest &d, const char *text)
+{
+    d.AddLog(LOG_LEVEL_INFO, PSTR("%s"), text);
+}
+
+static void advance(uint32_t ms)
+{
+    hostMicros += (uint64_t)ms * 1000;
+}
+
+static void setup(SyslogTest &d, uint8_t type)
+{
+    globalConfig.debug.type = type;
+    globalConfig.debug.syslog_level = LOG_LEVEL_INFO;
+    strcpy(globalConfig.debug.server, "log.lan");
+    globalConfig.debug.port = 514;
+    WiFi.hostStatus = WL_DISCONNECTED;
+    WiFi.hostResolve = 0;
+    Udp.sent.clear();
+    d.serverChanged();
+}
+
+static void testBoot()
+{
+    SyslogTest d;
+    setup(d, 2);
+    advance(1000);
+    log(d, "boot 1");
+    log(d, "boot 2");
+    d.loop();
+    expect(Udp.sent.empty(), "boot: sent before wifi");
+
+    WiFi.hostStatus = WL_CONNECTED;
+    d.loop();
+    log(d, "boot 3");
+    d.loop();
+    expect(Udp.sent.empty() && d.syslogLen > 0, "boot: lines kept while unresolved");
+
+    WiFi.hostResolve = IPAddress(10, 0, 0, 2);
+    uint32_t count = WiFi.resolveCount;
+    advance(SYSLOG_DNS_RETRY - 1000);
+    d.loop();
+    expect(WiFi.resolveCount == count && Udp.sent.empty(), "boot: retried before SYSLOG_DNS_RETRY");
+    advance(1000);
+    d.loop();
+    expect(Udp.sent.size() == 3, "boot: queued lines sent after resolve");
+    if (Udp.sent.size() == 3)
+    {
+        expect(Udp.sent[0] == message("boot 1") && Udp.sent[1] == message("boot 2") && Udp.sent[2] == message("boot 3"),
+               "boot: one message per datagram in order");
+    }
+
+    log(d, "now");
+    expect(Udp.sent.size() == 4 && Udp.sent.back() == message("now"), "resolved: sent immediately");
+    printf("boot: %s\n", failures ? "FAIL" : "OK");
+}
+
+static void testTtl()
+{
+    SyslogTest d;
+    setup(d, 2);
+    WiFi.hostStatus = WL_CONNECTED;
+    WiFi.hostResolve = IPAddress(10, 0, 0, 2);
+    d.loop();
+    expect(d.ip == IPAddress(10, 0, 0, 2), "ttl: first resolve");
+
+    uint32_t count = WiFi.resolveCount;
+    WiFi.hostResolve = IPAddress(10, 0, 0, 3);
+    for (int i = 0; i < 100; i++)
+    {
+        advance(SYSLOG_DNS_TTL / 100 - 1);
+        d.loop();
+    }
+    expect(WiFi.resolveCount == count, "ttl: resolved before SYSLOG_DNS_TTL");
+    advance(100);
+    d.loop();
+    expect(WiFi.resolveCount == count + 1 && d.ip == IPAddress(10, 0, 0, 3), "ttl: re-resolved without pending logs");
+
+    WiFi.hostResolve = 0;
+    advance(SYSLOG_DNS_TTL);
+    d.loop();
+    expect(d.ip == IPAddress(10, 0, 0, 3), "ttl: failed re-resolve keeps old address");
+    log(d, "still sent");
+    expect(!Udp.sent.empty() && Udp.sent.back() == message("still sent"), "ttl: sent with old address");
+    printf("ttl: %s\n", failures ? "FAIL" : "OK");
+}
+
+static void testFull()
+{
+    SyslogTest d;
+    setup(d, 2);
+    WiFi.hostStatus = WL_CONNECTED;
+    d.loop();
+    char text[200];
+    int n = 0;
+    for (int i = 0; i < 100; i++)
+    {
+        snprintf(text, sizeof(text), "line %03d %0150d", i, 0);
+        log(d, text);
+        if (d.syslogLen > 0)
+        {
+            n = i + 1;
+        }
+    }
+    expect(d.syslogLen <= SYSLOG_SIZE && n == 100, "full: buffer bounded");
+    WiFi.hostResolve = IPAddress(10, 0, 0, 2);
+    advance(SYSLOG_DNS_RETRY);
+    d.loop();
+    expect(Udp.sent.size() > 0 && Udp.sent.size() < 100, "full: kept some lines");
+    for (size_t i = 0; i < Udp.sent.size(); i++)
+    {
+        snprintf(text, sizeof(text), "line %03d %0150d", (int)i, 0);
+        expect(Udp.sent[i] == message(text), "full: oldest lines kept");
+    }
+    printf("full: %zu of 100 kept %s\n", Udp.sent.size(), failures ? "FAIL" : "OK");
+}
+
+static void testBatch()
+{
+    SyslogTest d;
+    setup(d, 2 | 32);
+    WiFi.hostStatus = WL_CONNECTED;
+    WiFi.hostResolve = IPAddress(10, 0, 0, 2);
+    d.loop();
+    log(d, "a");
+    log(d, "bb");
+    d.loop();
+    expect(Udp.sent.empty(), "batch: sent before SYSLOG_FLUSH_TIME");
+    advance(SYSLOG_FLUSH_TIME);
+    d.loop();
+    std::string a = message("a"), b = message("bb");
+    std::string want = std::to_string(a.size()) + " " + a + std::to_string(b.size()) + " " + b;
+    expect(Udp.sent.size() == 1 && Udp.sent[0] == want, "batch: one octet-counted datagram");
+    printf("batch: %s\n", failures ? "FAIL" : "OK");
+}
+
+int main()
+{
+    testBoot();
+    testTtl();
+    testFull();
+    testBatch();
+    return failures ? 1 : 0;
+}
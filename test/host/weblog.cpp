@@ -0,0 +1,228 @@
+// web 日志环形缓冲主机测试: DebugClass::webLogAdd / webLogEvict / GetLog
+// g++ -std=gnu++17 -O2 -Itest/host/stub -Iinclude test/host/weblog.cpp test/host/stub/host.cpp src/Debug.cpp -o weblog && ./weblog
+//
+// 1. 随机长度写入 20 万行, 每次写入后检查: 现存的行是连续的最新若干行, 内容与写入一致,
+//    各行在缓冲区内不重叠, 最新一行一定存在, 序号跳过 0
+// 2. 每行耗时与写入前缓冲区占用的关系 (主机 ns, 只看趋势; 设备上看 esp_log_text_cycles_total)
+//
+// 结果 (x86-64 g++ 12 -O2, WEB_LOG_SIZE 4000, WEB_LOG_LINES 64, 每行含 13 字节时间):
+//   check: 200000 lines OK, drop 199969
+//   行长      0-25%   25-50%   50-75%  75-100%   淘汰
+//   32       64.1ns   63.9ns        -        -   66.7ns
+//   128      69.4ns   68.6ns   69.8ns   71.3ns   66.6ns
+//   255      74.6ns   83.6ns   75.9ns        -   74.9ns
+// 每行耗时与占用无关, 满了以后淘汰旧行也只多几 ns; 32 字节的行先用完 64 个槽位, 占用到不了 50%
+
+#include "Debug.h"
+#include "Metrics.h"
+#include "Ntp.h"
+#include <chrono>
+#include <string>
+#include <vector>
+
+uint32_t Metrics::webLogDrop = 0;
+TIME_T Ntp::rtcTime;
+uint64_t Ntp::nowUs() { return 0; }
+uint16_t Ntp::millisecond() { return 0; }
+
+class WebLogTest : public DebugClass
+{
+public:
+    using DebugClass::webLogAdd;
+    using DebugClass::webLogCount;
+
+    uint16_t used()
+    {
+        uint16_t total = 0;
+        for (uint8_t i = 0; i < WEB_LOG_LINES; i++)
+        {
+            if (webLogLines[i].idx)
+            {
+                total += webLogLines[i].len;
+            }
+        }
+        return total;
+    }
+};
+
+static WebLogTest *logTest;
+static std::vector<std::string> written(256);
+static int failures = 0;
+
+static void fail(const char *msg, int idx)
+{
+    if (failures++ < 10)
+    {
+        printf("FAIL %s idx %d\n", msg, idx);
+    }
+}
+
+static void add(const char *mxtime, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        tmpData[i] = 'a' + rand() % 26;
+    }
+    tmpData[len] = '\0';
+    uint8_t idx = logTest->webLogIndex;
+    std::string line = std::string(mxtime) + tmpData;
+    written[idx] = line.substr(0, sizeof(tmpData) / 2 - 1);
+    logTest->webLogAdd(mxtime);
+}
+
+static void check(uint8_t newest)
+{
+    // 从最新一行往前, 现存的行必须连续
+    std::vector<bool> used(WEB_LOG_SIZE, false);
+    uint8_t idx = newest;
+    int count = 0;
+    while (true)
+    {
+        char *entry;
+        uint16_t len;
+        logTest->GetLog(idx, &entry, &len);
+        if (entry == NULL)
+        {
+            break;
+        }
+        if (std::string(entry, len) != written[idx])
+        {
+            fail("content", idx);
+        }
+        if (entry < logTest->webLog || entry + len > logTest->webLog + WEB_LOG_SIZE)
+        {
+            fail("bounds", idx);
+        }
+        for (uint16_t i = 0; i < len; i++)
+        {
+            if (used[entry - logTest->webLog + i])
+            {
+                fail("overlap", idx);
+                break;
+            }
+            used[entry - logTest->webLog + i] = true;
+        }
+        count++;
+        idx = idx == 1 ? 255 : idx - 1;
+        if (idx == newest)
+        {
+            break;
+        }
+    }
+    if (count == 0)
+    {
+        fail("newest missing", newest);
+    }
+    if (count != logTest->webLogCount)
+    {
+        fail("count", newest);
+    }
+    // 更早的行都已淘汰
+    for (int i = 0; i < 255 - count; i++)
+    {
+        char *entry;
+        uint16_t len;
+        logTest->GetLog(idx, &entry, &len);
+        if (entry != NULL)
+        {
+            fail("stale", idx);
+        }
+        idx = idx == 1 ? 255 : idx - 1;
+    }
+}
+
+static void testRandom()
+{
+    logTest = new WebLogTest();
+    for (int i = 0; i < 200000; i++)
+    {
+        uint8_t newest = logTest->webLogIndex;
+        add("12:00:00.000 ", rand() % 300);
+        check(newest);
+        if (logTest->webLogIndex == 0)
+        {
+            fail("index 0", i);
+        }
+    }
+    printf("check: 200000 lines %s, drop %u\n", failures ? "FAIL" : "OK", Metrics::webLogDrop);
+    delete logTest;
+}
+
+/**
+ * 从空缓冲区开始连续写入, 按写入前的占用分段统计每行耗时, 需要淘汰旧行的单独统计
+ * 先空跑一遍得到每行所属的分段, 计时时整段一起计, 避免计时器本身的开销
+ */
+static void bench()
+{
+    const size_t lens[] = {32, 128, 255};
+    const char *names[] = {"0-25%", "25-50%", "50-75%", "75-100%", "淘汰"};
+    const int lines = WEB_LOG_LINES * 4;
+    printf("行长  ");
+    for (const char *name : names)
+    {
+        printf(" %8s", name);
+    }
+    printf("\n");
+    for (size_t len : lens)
+    {
+        for (size_t j = 0; j < len - 13; j++)
+        {
+            tmpData[j] = 'a' + j % 26;
+        }
+        tmpData[len - 13] = '\0';
+
+        uint8_t bucket[lines];
+        logTest = new WebLogTest();
+        for (int i = 0; i < lines; i++)
+        {
+            bucket[i] = logTest->used() * 4 / WEB_LOG_SIZE;
+            uint32_t drop = Metrics::webLogDrop;
+            logTest->webLogAdd("12:00:00.000 ");
+            if (Metrics::webLogDrop != drop)
+            {
+                bucket[i] = 4;
+            }
+        }
+        delete logTest;
+
+        double total[5] = {0};
+        uint32_t count[5] = {0};
+        for (int r = 0; r < 20000; r++)
+        {
+            logTest = new WebLogTest();
+            int i = 0;
+            while (i < lines)
+            {
+                uint8_t b = bucket[i];
+                auto start = std::chrono::steady_clock::now();
+                for (; i < lines && bucket[i] == b; i++)
+                {
+                    logTest->webLogAdd("12:00:00.000 ");
+                    count[b]++;
+                }
+                total[b] += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            }
+            delete logTest;
+        }
+        printf("%-5zu ", len);
+        for (uint8_t i = 0; i < 5; i++)
+        {
+            if (count[i] >= 20000 * 4) // 每轮少于 4 行时计时误差太大, 不输出
+            {
+                printf(" %6.1fns", total[i] / count[i]);
+            }
+            else
+            {
+                printf(" %8s", "-");
+            }
+        }
+        printf("\n");
+    }
+}
+
+int main()
+{
+    testRandom();
+    bench();
+    return failures ? 1 : 0;
+}